@@ -10,8 +10,12 @@ in vec3 Normal;
 // Imports the color from the Vertex Shader
 in vec3 color;
 
-// Gets the position of the camera from the main function
-uniform vec3 camPos;
+//Camera data, one uniform buffer updated once per frame and shared by all the programs
+layout (std140) uniform Camera
+{
+	mat4 camMatrix;
+	vec3 camPos;
+};
 
 void main()
 {
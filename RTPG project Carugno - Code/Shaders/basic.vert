@@ -13,19 +13,20 @@ out vec3 Normal;
 out vec3 color;
 
 
-//NEW
-uniform mat4 camMatrix;
-//
+//Camera data, one uniform buffer updated once per frame and shared by all the programs
+layout (std140) uniform Camera
+{
+	mat4 camMatrix;
+	vec3 camPos;
+};
+//Model matrix already combined on the CPU (model * translation * rotation * scale)
 uniform mat4 model;
-uniform mat4 translation;
-uniform mat4 rotation;
-uniform mat4 scale;
 
 void main()
 {
 
 	// calculates current position
-	crntPos = vec3(model * translation * rotation * scale * vec4(aPos, 1.0f));
+	crntPos = vec3(model * vec4(aPos, 1.0f));
 	// Assigns the normal from the Vertex Data to "Normal"
 	Normal = aNormal;
 	// Assigns the colors from the Vertex Data to "color"
@@ -0,0 +1,37 @@
+#version 410 core
+
+//Positions/Coordinates
+layout (location = 0) in vec3 aPos;
+//Normals
+layout (location = 1) in vec3 aNormal;
+//Per instance color
+layout (location = 3) in vec3 aInstanceColor;
+//Per instance model matrix (one column per location, from 4 to 7)
+layout (location = 4) in mat4 aModel;
+
+out vec3 crntPos;
+out vec3 Normal;
+// Outputs the color for the Fragment Shader
+out vec3 color;
+
+//Camera data, one uniform buffer updated once per frame and shared by all the programs
+layout (std140) uniform Camera
+{
+	mat4 camMatrix;
+	vec3 camPos;
+};
+
+void main()
+{
+
+	// calculates current position
+	crntPos = vec3(aModel * vec4(aPos, 1.0f));
+	// Normal rotated with the instance
+	Normal = mat3(aModel) * aNormal;
+	// Every instance has its own color
+	color = aInstanceColor;
+
+	// Outputs the positions/coordinates of all vertices
+	gl_Position = camMatrix * vec4(crntPos, 1.0);
+
+}
@@ -15,6 +15,23 @@ subject to the following restrictions:
 ///btDbvt implementation by Nathanael Presson
 
 #include "btDbvt.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btCpuFeatureUtility.h"
+
+// Same condition as DBVT_WIDE_IMPL in btDbvt.h, the AVX kernel is compiled for the CPU features check
+#if !defined(BT_USE_DOUBLE_PRECISION) && \
+	(defined(BT_USE_SSE) || defined(__SSE2__) || defined(_M_X64))
+#define DBVT_WIDE_SSE 1
+#if (defined(_MSC_VER) && _MSC_VER >= 1600) || defined(__GNUC__) || defined(__clang__)
+#define DBVT_WIDE_AVX 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#define DBVT_TARGET_AVX
+#else
+#define DBVT_TARGET_AVX __attribute__((target("avx")))
+#endif
+#endif
+#endif
 
 //
 typedef btAlignedObjectArray<btDbvtNode*> tNodeArray;
@@ -414,6 +431,378 @@ static btDbvtNode* topdown(btDbvt* pdbvt,
 	return (leaves[0]);
 }
 
+// half surface area
+static DBVT_INLINE btScalar area(const btDbvtVolume& a)
+{
+	const btVector3 edges = a.Lengths();
+	return (edges.x() * edges.y() + edges.y() * edges.z() + edges.z() * edges.x());
+}
+
+//
+enum
+{
+	SAH_BINS = 16
+};
+
+// collects the leaves and the internal nodes, reused by topdownsah
+static void fetchnodes(btDbvtNode* root,
+					   tNodeArray& leaves,
+					   tNodeArray& nodes)
+{
+	if (root->isinternal())
+	{
+		fetchnodes(root->childs[0], leaves, nodes);
+		fetchnodes(root->childs[1], leaves, nodes);
+		nodes.push_back(root);
+	}
+	else
+	{
+		leaves.push_back(root);
+	}
+}
+
+//
+static btDbvtNode* topdownsah(tNodeArray& nodes,
+							  btDbvtNode** leaves,
+							  int count)
+{
+	if (count == 1) return (leaves[0]);
+	const btDbvtVolume vol = bounds(leaves, count);
+	btVector3 cmin = leaves[0]->volume.Center();
+	btVector3 cmax = cmin;
+	for (int i = 1; i < count; ++i)
+	{
+		const btVector3 c = leaves[i]->volume.Center();
+		cmin.setMin(c);
+		cmax.setMax(c);
+	}
+	/* best split over the bins of the centroids, on the three axes	*/
+	const int bins = btMin<int>(SAH_BINS, count);
+	int bestaxis = -1;
+	int bestbin = 0;
+	btScalar bestcost = SIMD_INFINITY;
+	btScalar bestscale = 0;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		const btScalar extent = cmax[axis] - cmin[axis];
+		if (extent <= 0) continue;
+		const btScalar scale = bins / extent;
+		ATTRIBUTE_ALIGNED16(btDbvtVolume)
+		binvolumes[SAH_BINS];
+		int bincounts[SAH_BINS] = {0};
+		for (int i = 0; i < count; ++i)
+		{
+			const int b = btMin<int>(bins - 1, (int)((leaves[i]->volume.Center()[axis] - cmin[axis]) * scale));
+			if (bincounts[b]++)
+				Merge(binvolumes[b], leaves[i]->volume, binvolumes[b]);
+			else
+				binvolumes[b] = leaves[i]->volume;
+		}
+		/* areas and counts right of each split	*/
+		btScalar rightareas[SAH_BINS];
+		int rightcounts[SAH_BINS];
+		ATTRIBUTE_ALIGNED16(btDbvtVolume)
+		right;
+		int n = 0;
+		for (int b = bins - 1; b > 0; --b)
+		{
+			if (bincounts[b])
+			{
+				if (n)
+					Merge(right, binvolumes[b], right);
+				else
+					right = binvolumes[b];
+				n += bincounts[b];
+			}
+			rightareas[b] = n ? area(right) : 0;
+			rightcounts[b] = n;
+		}
+		ATTRIBUTE_ALIGNED16(btDbvtVolume)
+		left;
+		n = 0;
+		for (int b = 0; b < bins - 1; ++b)
+		{
+			if (bincounts[b])
+			{
+				if (n)
+					Merge(left, binvolumes[b], left);
+				else
+					left = binvolumes[b];
+				n += bincounts[b];
+			}
+			if (n == 0 || rightcounts[b + 1] == 0) continue;
+			const btScalar cost = area(left) * n + rightareas[b + 1] * rightcounts[b + 1];
+			if (cost < bestcost)
+			{
+				bestcost = cost;
+				bestaxis = axis;
+				bestbin = b;
+				bestscale = scale;
+			}
+		}
+	}
+	int partition = count / 2;
+	if (bestaxis >= 0)
+	{
+		/* leaves in the bins up to bestbin go left	*/
+		int begin = 0;
+		int end = count;
+		while (begin < end)
+		{
+			const int b = btMin<int>(bins - 1, (int)((leaves[begin]->volume.Center()[bestaxis] - cmin[bestaxis]) * bestscale));
+			if (b <= bestbin)
+			{
+				++begin;
+			}
+			else
+			{
+				--end;
+				btSwap(leaves[begin], leaves[end]);
+			}
+		}
+		if (begin > 0 && begin < count) partition = begin;
+	}
+	btDbvtNode* node = nodes[nodes.size() - 1];
+	nodes.pop_back();
+	node->volume = vol;
+	node->childs[0] = topdownsah(nodes, &leaves[0], partition);
+	node->childs[1] = topdownsah(nodes, &leaves[partition], count - partition);
+	node->childs[0]->parent = node;
+	node->childs[1]->parent = node;
+	return (node);
+}
+
+// refits the subtree, returns the sum of the areas of its internal nodes
+static btScalar refitnode(btDbvtNode* node)
+{
+	if (node->isleaf()) return (0);
+	const btScalar cost = refitnode(node->childs[0]) + refitnode(node->childs[1]);
+	Merge(node->childs[0]->volume, node->childs[1]->volume, node->volume);
+	return (cost + area(node->volume));
+}
+
+//
+static btScalar nodesarea(const btDbvtNode* node)
+{
+	if (node->isleaf()) return (0);
+	return (nodesarea(node->childs[0]) + nodesarea(node->childs[1]) + area(node->volume));
+}
+
+//
+struct btDbvtRefitLoop : public btIParallelForBody
+{
+	btDbvtNode* const* m_subtrees;
+	btScalar* m_costs;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			m_costs[i] = refitnode(m_subtrees[i]);
+		}
+	}
+};
+
+// appends the subtree in depth first order, childs[1] first like the stacks of the btDbvt traversals
+static void linearize(btDbvtLinear& linear, const btDbvtNode* node)
+{
+	const int index = linear.m_nodes.size();
+	btDbvtLinearNode& n = linear.m_nodes.expandNonInitializing();
+	linear.m_sources.push_back(node);
+	const btVector3& mi = node->volume.Mins();
+	const btVector3& mx = node->volume.Maxs();
+	n.mi[0] = mi.x();
+	n.mi[1] = mi.y();
+	n.mi[2] = mi.z();
+	n.mx[0] = mx.x();
+	n.mx[1] = mx.y();
+	n.mx[2] = mx.z();
+	n.leaf = node->isleaf();
+	if (node->isinternal())
+	{
+		linearize(linear, node->childs[1]);
+		linearize(linear, node->childs[0]);
+	}
+	linear.m_nodes[index].escape = linear.m_nodes.size();
+}
+
+// refits the linear copy backward, the children of a node come after it, and returns the sum of the areas
+// of its internal nodes. With writeback the internal volumes are also set in the tree
+static btScalar refitlinear(btDbvtLinear& linear, bool writeback)
+{
+	btScalar cost = 0;
+	for (int i = linear.m_nodes.size() - 1; i >= 0; --i)
+	{
+		btDbvtLinearNode& n = linear.m_nodes[i];
+		if (n.leaf)
+		{
+			const btDbvtVolume& volume = linear.m_sources[i]->volume;
+			const btVector3& mi = volume.Mins();
+			const btVector3& mx = volume.Maxs();
+			n.mi[0] = mi.x();
+			n.mi[1] = mi.y();
+			n.mi[2] = mi.z();
+			n.mx[0] = mx.x();
+			n.mx[1] = mx.y();
+			n.mx[2] = mx.z();
+		}
+		else
+		{
+			const btDbvtLinearNode& a = linear.m_nodes[i + 1];
+			const btDbvtLinearNode& b = linear.m_nodes[a.escape];
+			for (int j = 0; j < 3; ++j)
+			{
+				n.mi[j] = btMin(a.mi[j], b.mi[j]);
+				n.mx[j] = btMax(a.mx[j], b.mx[j]);
+			}
+			const btDbvtVolume volume = btDbvtVolume::FromMM(btVector3(n.mi[0], n.mi[1], n.mi[2]),
+															 btVector3(n.mx[0], n.mx[1], n.mx[2]));
+			cost += area(volume);
+			if (writeback)
+			{
+				/* the nodes belong to the tree that is refit	*/
+				const_cast<btDbvtNode*>(linear.m_sources[i])->volume = volume;
+			}
+		}
+	}
+	return (cost);
+}
+
+// copies the children of node, or the root leaf, to a new node of the wide tree and returns its index.
+// The internal child with the largest volume is replaced by its children until there are four
+static int widen(btDbvtWide& wide, const btDbvtNode* node)
+{
+	const btDbvtNode* childs[4];
+	int count = 0;
+	if (node->isleaf())
+	{
+		childs[count++] = node;
+	}
+	else
+	{
+		childs[count++] = node->childs[0];
+		childs[count++] = node->childs[1];
+		while (count < 4)
+		{
+			int best = -1;
+			for (int i = 0; i < count; ++i)
+			{
+				if (childs[i]->isinternal() && (best < 0 || size(childs[i]->volume) > size(childs[best]->volume)))
+					best = i;
+			}
+			if (best < 0) break;
+			const btDbvtNode* split = childs[best];
+			for (int i = count; i > best + 1; --i) childs[i] = childs[i - 1];
+			childs[best] = split->childs[0];
+			childs[best + 1] = split->childs[1];
+			++count;
+		}
+	}
+	const int index = wide.m_nodes.size();
+	btDbvtWideNode& n = wide.m_nodes.expandNonInitializing();
+	for (int i = 0; i < 4; ++i)
+	{
+		const btVector3 mi = i < count ? childs[i]->volume.Mins() : btVector3(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+		const btVector3 mx = i < count ? childs[i]->volume.Maxs() : -btVector3(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+		for (int j = 0; j < 3; ++j)
+		{
+			n.mi[j][i] = mi[j];
+			n.mx[j][i] = mx[j];
+		}
+		n.childs[i] = 0;
+	}
+	for (int i = 0; i < count; ++i)
+	{
+		int child;
+		if (childs[i]->isleaf())
+		{
+			child = ~wide.m_leaves.size();
+			wide.m_leaves.push_back(childs[i]);
+		}
+		else
+		{
+			child = widen(wide, childs[i]);
+		}
+		/* the array may have grown	*/
+		wide.m_nodes[index].childs[i] = child;
+	}
+	return (index);
+}
+
+//
+static unsigned overlap4x4generic(const btDbvtWideNode& a, const btDbvtWideNode& b)
+{
+	unsigned mask = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		for (int j = 0; j < 4; ++j)
+		{
+			if ((a.mi[0][i] <= b.mx[0][j]) &&
+				(a.mx[0][i] >= b.mi[0][j]) &&
+				(a.mi[1][i] <= b.mx[1][j]) &&
+				(a.mx[1][i] >= b.mi[1][j]) &&
+				(a.mi[2][i] <= b.mx[2][j]) &&
+				(a.mx[2][i] >= b.mi[2][j]))
+			{
+				mask |= 1u << (i * 4 + j);
+			}
+		}
+	}
+	return (mask);
+}
+
+#ifdef DBVT_WIDE_SSE
+// one child of a against the four children of b per iteration
+static unsigned overlap4x4sse(const btDbvtWideNode& a, const btDbvtWideNode& b)
+{
+	const __m128 bmi0 = _mm_load_ps(b.mi[0]);
+	const __m128 bmi1 = _mm_load_ps(b.mi[1]);
+	const __m128 bmi2 = _mm_load_ps(b.mi[2]);
+	const __m128 bmx0 = _mm_load_ps(b.mx[0]);
+	const __m128 bmx1 = _mm_load_ps(b.mx[1]);
+	const __m128 bmx2 = _mm_load_ps(b.mx[2]);
+	unsigned mask = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		__m128 rt = _mm_and_ps(_mm_cmple_ps(_mm_set1_ps(a.mi[0][i]), bmx0), _mm_cmpge_ps(_mm_set1_ps(a.mx[0][i]), bmi0));
+		rt = _mm_and_ps(rt, _mm_and_ps(_mm_cmple_ps(_mm_set1_ps(a.mi[1][i]), bmx1), _mm_cmpge_ps(_mm_set1_ps(a.mx[1][i]), bmi1)));
+		rt = _mm_and_ps(rt, _mm_and_ps(_mm_cmple_ps(_mm_set1_ps(a.mi[2][i]), bmx2), _mm_cmpge_ps(_mm_set1_ps(a.mx[2][i]), bmi2)));
+		mask |= (unsigned)_mm_movemask_ps(rt) << (i * 4);
+	}
+	return (mask);
+}
+#endif
+
+#ifdef DBVT_WIDE_AVX
+// two children of a against the four children of b, copied in both lanes, per iteration
+static DBVT_TARGET_AVX __m256 pair8(btScalar lo, btScalar hi)
+{
+	return (_mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(lo)), _mm_set1_ps(hi), 1));
+}
+
+static DBVT_TARGET_AVX unsigned overlap4x4avx(const btDbvtWideNode& a, const btDbvtWideNode& b)
+{
+	const __m256 bmi0 = _mm256_broadcast_ps((const __m128*)b.mi[0]);
+	const __m256 bmi1 = _mm256_broadcast_ps((const __m128*)b.mi[1]);
+	const __m256 bmi2 = _mm256_broadcast_ps((const __m128*)b.mi[2]);
+	const __m256 bmx0 = _mm256_broadcast_ps((const __m128*)b.mx[0]);
+	const __m256 bmx1 = _mm256_broadcast_ps((const __m128*)b.mx[1]);
+	const __m256 bmx2 = _mm256_broadcast_ps((const __m128*)b.mx[2]);
+	unsigned mask = 0;
+	for (int i = 0; i < 4; i += 2)
+	{
+		__m256 rt = _mm256_and_ps(_mm256_cmp_ps(pair8(a.mi[0][i], a.mi[0][i + 1]), bmx0, _CMP_LE_OQ),
+								  _mm256_cmp_ps(pair8(a.mx[0][i], a.mx[0][i + 1]), bmi0, _CMP_GE_OQ));
+		rt = _mm256_and_ps(rt, _mm256_and_ps(_mm256_cmp_ps(pair8(a.mi[1][i], a.mi[1][i + 1]), bmx1, _CMP_LE_OQ),
+											 _mm256_cmp_ps(pair8(a.mx[1][i], a.mx[1][i + 1]), bmi1, _CMP_GE_OQ)));
+		rt = _mm256_and_ps(rt, _mm256_and_ps(_mm256_cmp_ps(pair8(a.mi[2][i], a.mi[2][i + 1]), bmx2, _CMP_LE_OQ),
+											 _mm256_cmp_ps(pair8(a.mx[2][i], a.mx[2][i + 1]), bmi2, _CMP_GE_OQ)));
+		mask |= (unsigned)_mm256_movemask_ps(rt) << (i * 4);
+	}
+	return (mask);
+}
+#endif
+
 //
 static DBVT_INLINE btDbvtNode* sort(btDbvtNode* n, btDbvtNode*& r)
 {
@@ -465,6 +854,9 @@ btDbvt::btDbvt()
 	m_lkhd = -1;
 	m_leaves = 0;
 	m_opath = 0;
+	m_rebuildCost = 0;
+	m_revision = 0;
+	m_topologyRevision = 0;
 }
 
 //
@@ -483,6 +875,9 @@ void btDbvt::clear()
 	m_lkhd = -1;
 	m_stkStack.clear();
 	m_opath = 0;
+	m_rebuildCost = 0;
+	++m_revision;
+	++m_topologyRevision;
 }
 
 //
@@ -495,6 +890,8 @@ void btDbvt::optimizeBottomUp()
 		fetchleaves(this, m_root, leaves);
 		bottomup(this, &leaves[0], leaves.size());
 		m_root = leaves[0];
+		++m_revision;
+		++m_topologyRevision;
 	}
 }
 
@@ -507,6 +904,8 @@ void btDbvt::optimizeTopDown(int bu_treshold)
 		leaves.reserve(m_leaves);
 		fetchleaves(this, m_root, leaves);
 		m_root = topdown(this, &leaves[0], leaves.size(), bu_treshold);
+		++m_revision;
+		++m_topologyRevision;
 	}
 }
 
@@ -531,12 +930,128 @@ void btDbvt::optimizeIncremental(int passes)
 	}
 }
 
+//
+btScalar btDbvt::refit(btDbvtLinear* linear)
+{
+	/* Trees smaller than this are refit in one recursion	*/
+	const int parallelLeaves = 1024;
+	/* Number of subtrees of the large trees, it does not depend on the threads so the costs are summed	*/
+	/* in the same order																				*/
+	const int subtreeCount = 64;
+	if (!m_root) return (0);
+	++m_revision;
+	btScalar cost;
+	if (linear && linear->m_tree == this && linear->m_topologyRevision == m_topologyRevision)
+	{
+		cost = refitlinear(*linear, true);
+		linear->m_revision = m_revision;
+	}
+	else if (m_leaves < parallelLeaves)
+	{
+		cost = refitnode(m_root);
+	}
+	else
+	{
+		/* Split the tree breadth first into subtrees, the internal nodes above them are refit last	*/
+		tNodeArray subtrees;
+		tNodeArray top;
+		subtrees.reserve(subtreeCount * 2);
+		subtrees.push_back(m_root);
+		bool expanded = true;
+		while (expanded && subtrees.size() < subtreeCount)
+		{
+			tNodeArray level;
+			level.reserve(subtrees.size() * 2);
+			expanded = false;
+			for (int i = 0; i < subtrees.size(); ++i)
+			{
+				btDbvtNode* node = subtrees[i];
+				if (node->isinternal())
+				{
+					expanded = true;
+					top.push_back(node);
+					level.push_back(node->childs[0]);
+					level.push_back(node->childs[1]);
+				}
+				else
+				{
+					level.push_back(node);
+				}
+			}
+			subtrees.copyFromArray(level);
+		}
+		btAlignedObjectArray<btScalar> costs;
+		costs.resize(subtrees.size());
+		btDbvtRefitLoop loop;
+		loop.m_subtrees = &subtrees[0];
+		loop.m_costs = &costs[0];
+#if BT_THREADSAFE
+		if (btGetTaskScheduler())
+			btParallelFor(0, subtrees.size(), 1, loop);
+		else
+#endif
+			loop.forLoop(0, subtrees.size());
+		cost = 0;
+		for (int i = 0; i < costs.size(); ++i)
+		{
+			cost += costs[i];
+		}
+		for (int i = top.size() - 1; i >= 0; --i)
+		{
+			btDbvtNode* node = top[i];
+			Merge(node->childs[0]->volume, node->childs[1]->volume, node->volume);
+			cost += area(node->volume);
+		}
+	}
+	const btScalar rootarea = area(m_root->volume);
+	return (rootarea > 0 ? cost / rootarea : 0);
+}
+
+//
+btScalar btDbvt::sahCost() const
+{
+	if (!m_root) return (0);
+	const btScalar rootarea = area(m_root->volume);
+	return (rootarea > 0 ? nodesarea(m_root) / rootarea : 0);
+}
+
+//
+void btDbvt::rebuildSah()
+{
+	if (m_root)
+	{
+		tNodeArray leaves;
+		tNodeArray nodes;
+		leaves.reserve(m_leaves);
+		nodes.reserve(m_leaves);
+		fetchnodes(m_root, leaves, nodes);
+		m_root = topdownsah(nodes, &leaves[0], leaves.size());
+		m_root->parent = 0;
+		m_opath = 0;
+		m_rebuildCost = btMax(sahCost() / m_leaves, SIMD_EPSILON);
+		++m_revision;
+		++m_topologyRevision;
+	}
+}
+
+//
+bool btDbvt::refitOrRebuild(btScalar maxCostRatio, btDbvtLinear* linear)
+{
+	if (!m_root) return (false);
+	const btScalar cost = refit(linear) / m_leaves;
+	if (m_rebuildCost > 0 && cost <= m_rebuildCost * maxCostRatio) return (false);
+	rebuildSah();
+	return (true);
+}
+
 //
 btDbvtNode* btDbvt::insert(const btDbvtVolume& volume, void* data)
 {
 	btDbvtNode* leaf = createnode(this, 0, volume, data);
 	insertleaf(this, m_root, leaf);
 	++m_leaves;
+	++m_revision;
+	++m_topologyRevision;
 	return (leaf);
 }
 
@@ -557,6 +1072,8 @@ void btDbvt::update(btDbvtNode* leaf, int lookahead)
 			root = m_root;
 	}
 	insertleaf(this, root, leaf);
+	++m_revision;
+	++m_topologyRevision;
 }
 
 //
@@ -577,6 +1094,8 @@ void btDbvt::update(btDbvtNode* leaf, btDbvtVolume& volume)
 	}
 	leaf->volume = volume;
 	insertleaf(this, root, leaf);
+	++m_revision;
+	++m_topologyRevision;
 }
 
 //
@@ -613,6 +1132,8 @@ void btDbvt::remove(btDbvtNode* leaf)
 	removeleaf(this, leaf);
 	deletenode(this, leaf);
 	--m_leaves;
+	++m_revision;
+	++m_topologyRevision;
 }
 
 //
@@ -703,6 +1224,158 @@ void btDbvt::extractLeaves(const btDbvtNode* node, btAlignedObjectArray<const bt
 	}
 }
 
+//
+void btDbvtLinear::build(const btDbvt& tree)
+{
+	m_nodes.resize(0);
+	m_sources.resize(0);
+	if (tree.m_root)
+	{
+		m_nodes.reserve(tree.m_leaves * 2 - 1);
+		m_sources.reserve(tree.m_leaves * 2 - 1);
+		linearize(*this, tree.m_root);
+	}
+	m_tree = &tree;
+	m_revision = tree.m_revision;
+	m_topologyRevision = tree.m_topologyRevision;
+}
+
+//
+void btDbvtLinear::refit()
+{
+	refitlinear(*this, false);
+	if (m_tree) m_revision = m_tree->m_revision;
+}
+
+//
+void btDbvtLinear::update(const btDbvt& tree)
+{
+	if (m_tree == &tree && m_topologyRevision == tree.m_topologyRevision)
+	{
+		if (m_revision != tree.m_revision) refit();
+	}
+	else
+	{
+		build(tree);
+	}
+}
+
+//
+void btDbvtLinear::clear()
+{
+	m_nodes.clear();
+	m_sources.clear();
+	m_tree = 0;
+	m_revision = 0;
+	m_topologyRevision = 0;
+}
+
+//
+btDbvtWide::btDbvtWide() : m_tree(0), m_revision(0), m_topologyRevision(0)
+{
+	m_overlap4x4 = getOverlap4x4(KERNEL_BEST);
+}
+
+//
+btDbvtWide::Overlap4x4 btDbvtWide::getOverlap4x4(eKernel kernel)
+{
+	switch (kernel)
+	{
+		case KERNEL_GENERIC:
+			return (overlap4x4generic);
+		case KERNEL_SSE:
+#ifdef DBVT_WIDE_SSE
+			return (overlap4x4sse);
+#else
+			return (0);
+#endif
+		case KERNEL_AVX:
+#ifdef DBVT_WIDE_AVX
+			if (btCpuFeatureUtility::getCpuFeatures() & btCpuFeatureUtility::CPU_FEATURE_AVX)
+				return (overlap4x4avx);
+#endif
+			return (0);
+		default:
+			break;
+	}
+	Overlap4x4 best = getOverlap4x4(KERNEL_AVX);
+	if (!best) best = getOverlap4x4(KERNEL_SSE);
+	if (!best) best = overlap4x4generic;
+	return (best);
+}
+
+//
+void btDbvtWide::build(const btDbvt& tree)
+{
+	m_nodes.resize(0);
+	m_leaves.resize(0);
+	if (tree.m_root)
+	{
+		m_nodes.reserve(tree.m_leaves);
+		m_leaves.reserve(tree.m_leaves);
+		widen(*this, tree.m_root);
+	}
+	m_tree = &tree;
+	m_revision = tree.m_revision;
+	m_topologyRevision = tree.m_topologyRevision;
+}
+
+//
+void btDbvtWide::refit()
+{
+	/* the children come after their node	*/
+	for (int i = m_nodes.size() - 1; i >= 0; --i)
+	{
+		btDbvtWideNode& n = m_nodes[i];
+		for (int k = 0; k < 4; ++k)
+		{
+			const int child = n.childs[k];
+			if (child < 0)
+			{
+				const btDbvtVolume& volume = m_leaves[~child]->volume;
+				for (int j = 0; j < 3; ++j)
+				{
+					n.mi[j][k] = volume.Mins()[j];
+					n.mx[j][k] = volume.Maxs()[j];
+				}
+			}
+			else if (child > 0)
+			{
+				const btDbvtWideNode& c = m_nodes[child];
+				for (int j = 0; j < 3; ++j)
+				{
+					n.mi[j][k] = btMin(btMin(c.mi[j][0], c.mi[j][1]), btMin(c.mi[j][2], c.mi[j][3]));
+					n.mx[j][k] = btMax(btMax(c.mx[j][0], c.mx[j][1]), btMax(c.mx[j][2], c.mx[j][3]));
+				}
+			}
+		}
+	}
+	if (m_tree) m_revision = m_tree->m_revision;
+}
+
+//
+void btDbvtWide::update(const btDbvt& tree)
+{
+	if (m_tree == &tree && m_topologyRevision == tree.m_topologyRevision)
+	{
+		if (m_revision != tree.m_revision) refit();
+	}
+	else
+	{
+		build(tree);
+	}
+}
+
+//
+void btDbvtWide::clear()
+{
+	m_nodes.clear();
+	m_leaves.clear();
+	m_tree = 0;
+	m_revision = 0;
+	m_topologyRevision = 0;
+}
+
 //
 #if DBVT_ENABLE_BENCHMARK
 
@@ -65,9 +65,18 @@ subject to the following restrictions:
 #define DBVT_INT0_IMPL DBVT_IMPL_GENERIC
 #endif
 
+// Kernels of btDbvtWide, SSE2 is always available on x86-64
+#if !defined(BT_USE_DOUBLE_PRECISION) && \
+	((DBVT_INT0_IMPL == DBVT_IMPL_SSE) || defined(__SSE2__) || defined(_M_X64))
+#define DBVT_WIDE_IMPL DBVT_IMPL_SSE
+#else
+#define DBVT_WIDE_IMPL DBVT_IMPL_GENERIC
+#endif
+
 #if (DBVT_SELECT_IMPL == DBVT_IMPL_SSE) || \
 	(DBVT_MERGE_IMPL == DBVT_IMPL_SSE) ||  \
-	(DBVT_INT0_IMPL == DBVT_IMPL_SSE)
+	(DBVT_INT0_IMPL == DBVT_IMPL_SSE) ||   \
+	(DBVT_WIDE_IMPL == DBVT_IMPL_SSE)
 #include <emmintrin.h>
 #endif
 
@@ -222,6 +231,8 @@ struct btDbvntNode
 
 typedef btAlignedObjectArray<const btDbvtNode*> btNodeStack;
 
+struct btDbvtLinear;
+
 ///The btDbvt class implements a fast dynamic bounding volume tree based on axis aligned bounding boxes (aabb tree).
 ///This btDbvt is used for soft body collision detection and for the btDbvtBroadphase. It has a fast insert, remove and update of nodes.
 ///Unlike the btQuantizedBvh, nodes can be dynamically moved around, which allows for change in topology of the underlying data structure.
@@ -304,6 +315,9 @@ struct btDbvt
 	int m_lkhd;
 	int m_leaves;
 	unsigned m_opath;
+	btScalar m_rebuildCost;  // sahCost per leaf after the last rebuildSah, 0 before
+	unsigned m_revision;          // Incremented by each change of the tree, see btDbvtLinear
+	unsigned m_topologyRevision;  // Incremented by each change of the hierarchy, not by refit
 
 	btAlignedObjectArray<sStkNN> m_stkStack;
 
@@ -315,6 +329,18 @@ struct btDbvt
 	void optimizeBottomUp();
 	void optimizeTopDown(int bu_treshold = 128);
 	void optimizeIncremental(int passes);
+	// Bulk refit: after the volumes of many leaves were changed in place, recomputes the internal
+	// volumes bottom-up in one pass without changing the topology, large trees are refit in parallel
+	// over subtrees. A linear copy of the tree with the same topology is refit in the same pass, which
+	// then runs over the copy. Returns sahCost
+	btScalar refit(btDbvtLinear* linear = 0);
+	// Surface area heuristic cost, the sum of the areas of the internal nodes over the area of the root
+	btScalar sahCost() const;
+	// Rebuilds the internal nodes top-down, splitting the leaves with a binned surface area heuristic
+	void rebuildSah();
+	// refit, then rebuildSah if the cost per leaf grew by more than maxCostRatio since the last rebuild,
+	// the first call always rebuilds. Returns true if the tree was rebuilt
+	bool refitOrRebuild(btScalar maxCostRatio, btDbvtLinear* linear = 0);
 	btDbvtNode* insert(const btDbvtVolume& box, void* data);
 	void update(btDbvtNode* leaf, int lookahead = -1);
 	void update(btDbvtNode* leaf, btDbvtVolume& volume);
@@ -456,6 +482,116 @@ private:
 	btDbvt(const btDbvt&) {}
 };
 
+/* btDbvtLinearNode			*/
+// 32 bytes in single precision, 64 in double precision
+ATTRIBUTE_ALIGNED16(struct)
+btDbvtLinearNode
+{
+	btScalar mi[3];
+	int escape;  // Index of the node that follows the subtree of this node
+	btScalar mx[3];
+	int leaf;  // 1 for a leaf, 0 for an internal node
+};
+
+///btDbvtLinear is a read only copy of a btDbvt laid out for the traversals.
+///The nodes are stored in one array in depth first order, each internal node followed by its subtrees, so the
+///traversals need no stack: they go to the next node when a volume overlaps and jump to its escape index otherwise.
+///The leaves are visited in the same order as btDbvt::collideTV and btDbvt::rayTest, the policies get the btDbvtNode
+///of the leaves. The copy is current until the btDbvt changes (btDbvt::m_revision), when only the volumes changed
+///update refits it from the leaves instead of copying the whole tree again, btDbvt::refit can refit both at once.
+struct btDbvtLinear
+{
+	typedef btDbvt::ICollide ICollide;
+
+	// Fields
+	btAlignedObjectArray<btDbvtLinearNode> m_nodes;
+	btAlignedObjectArray<const btDbvtNode*> m_sources;  // Node of the tree copied to each node
+	const btDbvt* m_tree;         // Tree of the last build
+	unsigned m_revision;          // m_tree->m_revision at the last build or refit
+	unsigned m_topologyRevision;  // m_tree->m_topologyRevision at the last build
+
+	// Methods
+	btDbvtLinear() : m_tree(0), m_revision(0), m_topologyRevision(0) {}
+	void build(const btDbvt& tree);
+	// Volumes of the leaves read back from the tree, internal volumes merged bottom-up
+	void refit();
+	// build, refit or nothing, whichever makes the copy current
+	void update(const btDbvt& tree);
+	void clear();
+	bool isCurrent(const btDbvt& tree) const { return (m_tree == &tree && m_revision == tree.m_revision); }
+	DBVT_PREFIX
+	void collideTV(const btDbvtVolume& volume,
+				   DBVT_IPOLICY) const;
+	// Pairs of overlapping leaves of this tree and other, reported leaf after leaf of this tree
+	DBVT_PREFIX
+	void collideTT(const btDbvtLinear& other,
+				   DBVT_IPOLICY) const;
+	DBVT_PREFIX
+	void rayTest(const btVector3& rayFrom,
+				 const btVector3& rayTo,
+				 DBVT_IPOLICY) const;
+};
+
+/* btDbvtWideNode			*/
+// Bounds of the four children of a node, axis by axis: mi[axis][child]
+ATTRIBUTE_ALIGNED16(struct)
+btDbvtWideNode
+{
+	btScalar mi[3][4];
+	btScalar mx[3][4];
+	int childs[4];  // Index of an internal node, ~index in m_leaves for a leaf, 0 for an empty slot
+};
+
+///btDbvtWide is a read only 4-ary copy of a btDbvt for the tree-tree and ray queries.
+///Each node holds the bounds of up to four children, taken from two levels of the btDbvt, so a query tests one
+///volume against four boxes (collideTV, rayTest) or the children of two nodes against each other (collideTT)
+///in a few SIMD instructions. The empty slots have inverted bounds and never overlap.
+///The 4x4 kernel of collideTT is picked at run time with btCpuFeatureUtility (AVX, SSE or generic), the leaves
+///are reported in a different order than btDbvt. Like btDbvtLinear the copy is current until the btDbvt changes.
+struct btDbvtWide
+{
+	typedef btDbvt::ICollide ICollide;
+	// Overlaps of the children of a and b, bit i*4+j set when child i of a overlaps child j of b
+	typedef unsigned (*Overlap4x4)(const btDbvtWideNode& a, const btDbvtWideNode& b);
+	enum eKernel
+	{
+		KERNEL_GENERIC,
+		KERNEL_SSE,
+		KERNEL_AVX,
+		KERNEL_BEST  // Fastest kernel of the CPU
+	};
+
+	// Fields
+	btAlignedObjectArray<btDbvtWideNode> m_nodes;  // Root first, each node before its children
+	btAlignedObjectArray<const btDbvtNode*> m_leaves;
+	const btDbvt* m_tree;         // Tree of the last build
+	unsigned m_revision;          // m_tree->m_revision at the last build or refit
+	unsigned m_topologyRevision;  // m_tree->m_topologyRevision at the last build
+	Overlap4x4 m_overlap4x4;      // Kernel of collideTT
+
+	// Methods
+	btDbvtWide();
+	void build(const btDbvt& tree);
+	// Volumes of the leaves read back from the tree, the bounds of the children merged bottom-up
+	void refit();
+	// build, refit or nothing, whichever makes the copy current
+	void update(const btDbvt& tree);
+	void clear();
+	bool isCurrent(const btDbvt& tree) const { return (m_tree == &tree && m_revision == tree.m_revision); }
+	// 0 when the kernel is not compiled in or not supported by the CPU
+	static Overlap4x4 getOverlap4x4(eKernel kernel);
+	DBVT_PREFIX
+	void collideTV(const btDbvtVolume& volume,
+				   DBVT_IPOLICY) const;
+	DBVT_PREFIX
+	void collideTT(const btDbvtWide& other,
+				   DBVT_IPOLICY) const;
+	DBVT_PREFIX
+	void rayTest(const btVector3& rayFrom,
+				 const btVector3& rayTo,
+				 DBVT_IPOLICY) const;
+};
+
 //
 // Inline's
 //
@@ -640,6 +776,52 @@ DBVT_INLINE bool Intersect(const btDbvtAabbMm& a,
 #endif
 }
 
+//
+DBVT_INLINE bool Intersect(const btDbvtLinearNode& a,
+						   const btDbvtAabbMm& b)
+{
+#if DBVT_INT0_IMPL == DBVT_IMPL_SSE
+	const __m128 rt(_mm_or_ps(_mm_cmplt_ps(_mm_load_ps(b.Maxs()), _mm_load_ps(a.mi)),
+							  _mm_cmplt_ps(_mm_load_ps(a.mx), _mm_load_ps(b.Mins()))));
+#if defined(_WIN32)
+	const __int32* pu((const __int32*)&rt);
+#else
+	const int* pu((const int*)&rt);
+#endif
+	return ((pu[0] | pu[1] | pu[2]) == 0);
+#else
+	return ((a.mi[0] <= b.Maxs().x()) &&
+			(a.mx[0] >= b.Mins().x()) &&
+			(a.mi[1] <= b.Maxs().y()) &&
+			(a.mx[1] >= b.Mins().y()) &&
+			(a.mi[2] <= b.Maxs().z()) &&
+			(a.mx[2] >= b.Mins().z()));
+#endif
+}
+
+//
+DBVT_INLINE bool Intersect(const btDbvtLinearNode& a,
+						   const btDbvtLinearNode& b)
+{
+#if DBVT_INT0_IMPL == DBVT_IMPL_SSE
+	const __m128 rt(_mm_or_ps(_mm_cmplt_ps(_mm_load_ps(b.mx), _mm_load_ps(a.mi)),
+							  _mm_cmplt_ps(_mm_load_ps(a.mx), _mm_load_ps(b.mi))));
+#if defined(_WIN32)
+	const __int32* pu((const __int32*)&rt);
+#else
+	const int* pu((const int*)&rt);
+#endif
+	return ((pu[0] | pu[1] | pu[2]) == 0);
+#else
+	return ((a.mi[0] <= b.mx[0]) &&
+			(a.mx[0] >= b.mi[0]) &&
+			(a.mi[1] <= b.mx[1]) &&
+			(a.mx[1] >= b.mi[1]) &&
+			(a.mi[2] <= b.mx[2]) &&
+			(a.mx[2] >= b.mi[2]));
+#endif
+}
+
 //
 DBVT_INLINE bool Intersect(const btDbvtAabbMm& a,
 						   const btVector3& b)
@@ -652,6 +834,79 @@ DBVT_INLINE bool Intersect(const btDbvtAabbMm& a,
 			(b.z() <= a.mx.z()));
 }
 
+// Children of n that overlap b, bit i for child i
+DBVT_INLINE unsigned Overlap4(const btDbvtWideNode& n,
+							  const btDbvtAabbMm& b)
+{
+#if DBVT_WIDE_IMPL == DBVT_IMPL_SSE
+	const btVector3& mi = b.Mins();
+	const btVector3& mx = b.Maxs();
+	__m128 rt = _mm_and_ps(_mm_cmple_ps(_mm_load_ps(n.mi[0]), _mm_set1_ps(mx.x())),
+						   _mm_cmpge_ps(_mm_load_ps(n.mx[0]), _mm_set1_ps(mi.x())));
+	rt = _mm_and_ps(rt, _mm_and_ps(_mm_cmple_ps(_mm_load_ps(n.mi[1]), _mm_set1_ps(mx.y())),
+								   _mm_cmpge_ps(_mm_load_ps(n.mx[1]), _mm_set1_ps(mi.y()))));
+	rt = _mm_and_ps(rt, _mm_and_ps(_mm_cmple_ps(_mm_load_ps(n.mi[2]), _mm_set1_ps(mx.z())),
+								   _mm_cmpge_ps(_mm_load_ps(n.mx[2]), _mm_set1_ps(mi.z()))));
+	return ((unsigned)_mm_movemask_ps(rt));
+#else
+	const btVector3& mi = b.Mins();
+	const btVector3& mx = b.Maxs();
+	unsigned mask = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		if ((n.mi[0][i] <= mx.x()) &&
+			(n.mx[0][i] >= mi.x()) &&
+			(n.mi[1][i] <= mx.y()) &&
+			(n.mx[1][i] >= mi.y()) &&
+			(n.mi[2][i] <= mx.z()) &&
+			(n.mx[2][i] >= mi.z()))
+		{
+			mask |= 1u << i;
+		}
+	}
+	return (mask);
+#endif
+}
+
+// Children of n hit by the ray, same test as btRayAabb2 with lambda_min 0
+DBVT_INLINE unsigned RayOverlap4(const btDbvtWideNode& n,
+								 const btVector3& rayFrom,
+								 const btVector3& rayInvDirection,
+								 const unsigned int raySign[3],
+								 btScalar lambda_max)
+{
+#if DBVT_WIDE_IMPL == DBVT_IMPL_SSE
+	__m128 tmin = _mm_setzero_ps();
+	__m128 tmax = _mm_set1_ps(lambda_max);
+	for (int j = 0; j < 3; ++j)
+	{
+		const __m128 from = _mm_set1_ps(rayFrom[j]);
+		const __m128 inv = _mm_set1_ps(rayInvDirection[j]);
+		const __m128 tnear = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(raySign[j] ? n.mx[j] : n.mi[j]), from), inv);
+		const __m128 tfar = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(raySign[j] ? n.mi[j] : n.mx[j]), from), inv);
+		tmin = _mm_max_ps(tmin, tnear);
+		tmax = _mm_min_ps(tmax, tfar);
+	}
+	return ((unsigned)_mm_movemask_ps(_mm_cmple_ps(tmin, tmax)));
+#else
+	unsigned mask = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		btScalar tmin = 0;
+		btScalar tmax = lambda_max;
+		for (int j = 0; j < 3; ++j)
+		{
+			const btScalar tnear = ((raySign[j] ? n.mx[j][i] : n.mi[j][i]) - rayFrom[j]) * rayInvDirection[j];
+			const btScalar tfar = ((raySign[j] ? n.mi[j][i] : n.mx[j][i]) - rayFrom[j]) * rayInvDirection[j];
+			tmin = btMax(tmin, tnear);
+			tmax = btMin(tmax, tfar);
+		}
+		if (tmin <= tmax) mask |= 1u << i;
+	}
+	return (mask);
+#endif
+}
+
 //////////////////////////////////////
 
 //
@@ -1557,6 +1812,288 @@ inline void btDbvt::collideTU(const btDbvtNode* root,
 	}
 }
 
+//
+DBVT_PREFIX
+inline void btDbvtLinear::collideTV(const btDbvtVolume& vol,
+									DBVT_IPOLICY) const
+{
+	DBVT_CHECKTYPE
+	ATTRIBUTE_ALIGNED16(btDbvtVolume)
+	volume(vol);
+	const btDbvtLinearNode* nodes = m_nodes.size() ? &m_nodes[0] : 0;
+	const int count = m_nodes.size();
+	int i = 0;
+	while (i < count)
+	{
+		const btDbvtLinearNode& n = nodes[i];
+		if (Intersect(n, volume))
+		{
+			if (n.leaf)
+			{
+				policy.Process(m_sources[i]);
+			}
+			++i;
+		}
+		else
+		{
+			i = n.escape;
+		}
+	}
+}
+
+//
+DBVT_PREFIX
+inline void btDbvtLinear::collideTT(const btDbvtLinear& other,
+									DBVT_IPOLICY) const
+{
+	DBVT_CHECKTYPE
+	if (m_nodes.size() == 0 || other.m_nodes.size() == 0) return;
+	const btDbvtLinearNode* nodes = &m_nodes[0];
+	const btDbvtLinearNode* othernodes = &other.m_nodes[0];
+	const int count = m_nodes.size();
+	const int othercount = other.m_nodes.size();
+	int i = 0;
+	while (i < count)
+	{
+		const btDbvtLinearNode& a = nodes[i];
+		if (Intersect(a, othernodes[0]))
+		{
+			if (a.leaf)
+			{
+				/* The leaf against the other tree	*/
+				int j = 0;
+				while (j < othercount)
+				{
+					const btDbvtLinearNode& b = othernodes[j];
+					if (Intersect(a, b))
+					{
+						if (b.leaf)
+						{
+							policy.Process(m_sources[i], other.m_sources[j]);
+						}
+						++j;
+					}
+					else
+					{
+						j = b.escape;
+					}
+				}
+			}
+			++i;
+		}
+		else
+		{
+			i = a.escape;
+		}
+	}
+}
+
+//
+DBVT_PREFIX
+inline void btDbvtLinear::rayTest(const btVector3& rayFrom,
+								  const btVector3& rayTo,
+								  DBVT_IPOLICY) const
+{
+	DBVT_CHECKTYPE
+	if (m_nodes.size() == 0) return;
+	btVector3 rayDir = (rayTo - rayFrom);
+	rayDir.normalize();
+
+	///what about division by zero? --> just set rayDirection[i] to INF/BT_LARGE_FLOAT
+	btVector3 rayDirectionInverse;
+	rayDirectionInverse[0] = rayDir[0] == btScalar(0.0) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.0) / rayDir[0];
+	rayDirectionInverse[1] = rayDir[1] == btScalar(0.0) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.0) / rayDir[1];
+	rayDirectionInverse[2] = rayDir[2] == btScalar(0.0) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.0) / rayDir[2];
+	unsigned int signs[3] = {rayDirectionInverse[0] < 0.0, rayDirectionInverse[1] < 0.0, rayDirectionInverse[2] < 0.0};
+
+	btScalar lambda_max = rayDir.dot(rayTo - rayFrom);
+
+	const btDbvtLinearNode* nodes = &m_nodes[0];
+	const int count = m_nodes.size();
+	btVector3 bounds[2];
+	int i = 0;
+	while (i < count)
+	{
+		const btDbvtLinearNode& n = nodes[i];
+		bounds[0].setValue(n.mi[0], n.mi[1], n.mi[2]);
+		bounds[1].setValue(n.mx[0], n.mx[1], n.mx[2]);
+		btScalar tmin = 1.f, lambda_min = 0.f;
+		if (btRayAabb2(rayFrom, rayDirectionInverse, signs, bounds, tmin, lambda_min, lambda_max))
+		{
+			if (n.leaf)
+			{
+				policy.Process(m_sources[i]);
+			}
+			++i;
+		}
+		else
+		{
+			i = n.escape;
+		}
+	}
+}
+
+//
+DBVT_PREFIX
+inline void btDbvtWide::collideTV(const btDbvtVolume& vol,
+								  DBVT_IPOLICY) const
+{
+	DBVT_CHECKTYPE
+	if (m_nodes.size() == 0) return;
+	ATTRIBUTE_ALIGNED16(btDbvtVolume)
+	volume(vol);
+	btAlignedObjectArray<int> stack;
+	stack.reserve(btDbvt::SIMPLE_STACKSIZE);
+	stack.push_back(0);
+	do
+	{
+		const btDbvtWideNode& n = m_nodes[stack[stack.size() - 1]];
+		stack.pop_back();
+		const unsigned mask = Overlap4(n, volume);
+		for (int i = 0; i < 4; ++i)
+		{
+			if (mask & (1u << i))
+			{
+				if (n.childs[i] < 0)
+					policy.Process(m_leaves[~n.childs[i]]);
+				else
+					stack.push_back(n.childs[i]);
+			}
+		}
+	} while (stack.size() > 0);
+}
+
+//
+DBVT_PREFIX
+inline void btDbvtWide::collideTT(const btDbvtWide& other,
+								  DBVT_IPOLICY) const
+{
+	DBVT_CHECKTYPE
+	if (m_nodes.size() == 0 || other.m_nodes.size() == 0) return;
+	/* pairs of references, an internal node or ~leaf	*/
+	btAlignedObjectArray<int> stack;
+	stack.reserve(btDbvt::DOUBLE_STACKSIZE * 2);
+	stack.push_back(0);
+	stack.push_back(0);
+	do
+	{
+		const int rb = stack[stack.size() - 1];
+		const int ra = stack[stack.size() - 2];
+		stack.resize(stack.size() - 2);
+		if (ra >= 0 && rb >= 0)
+		{
+			const btDbvtWideNode& a = m_nodes[ra];
+			const btDbvtWideNode& b = other.m_nodes[rb];
+			const unsigned mask = m_overlap4x4(a, b);
+			if (mask == 0) continue;
+			for (int i = 0; i < 4; ++i)
+			{
+				const unsigned row = (mask >> (i * 4)) & 15;
+				for (int j = 0; row >> j; ++j)
+				{
+					if (row & (1u << j))
+					{
+						if (a.childs[i] < 0 && b.childs[j] < 0)
+						{
+							policy.Process(m_leaves[~a.childs[i]], other.m_leaves[~b.childs[j]]);
+						}
+						else
+						{
+							stack.push_back(a.childs[i]);
+							stack.push_back(b.childs[j]);
+						}
+					}
+				}
+			}
+		}
+		else if (ra < 0)
+		{
+			/* a leaf of this tree against a node of the other	*/
+			const btDbvtNode* leaf = m_leaves[~ra];
+			const btDbvtWideNode& b = other.m_nodes[rb];
+			const unsigned mask = Overlap4(b, leaf->volume);
+			for (int j = 0; j < 4; ++j)
+			{
+				if (mask & (1u << j))
+				{
+					if (b.childs[j] < 0)
+					{
+						policy.Process(leaf, other.m_leaves[~b.childs[j]]);
+					}
+					else
+					{
+						stack.push_back(ra);
+						stack.push_back(b.childs[j]);
+					}
+				}
+			}
+		}
+		else
+		{
+			/* a node of this tree against a leaf of the other	*/
+			const btDbvtWideNode& a = m_nodes[ra];
+			const btDbvtNode* leaf = other.m_leaves[~rb];
+			const unsigned mask = Overlap4(a, leaf->volume);
+			for (int i = 0; i < 4; ++i)
+			{
+				if (mask & (1u << i))
+				{
+					if (a.childs[i] < 0)
+					{
+						policy.Process(m_leaves[~a.childs[i]], leaf);
+					}
+					else
+					{
+						stack.push_back(a.childs[i]);
+						stack.push_back(rb);
+					}
+				}
+			}
+		}
+	} while (stack.size() > 0);
+}
+
+//
+DBVT_PREFIX
+inline void btDbvtWide::rayTest(const btVector3& rayFrom,
+								const btVector3& rayTo,
+								DBVT_IPOLICY) const
+{
+	DBVT_CHECKTYPE
+	if (m_nodes.size() == 0) return;
+	btVector3 rayDir = (rayTo - rayFrom);
+	rayDir.normalize();
+
+	///what about division by zero? --> just set rayDirection[i] to INF/BT_LARGE_FLOAT
+	btVector3 rayDirectionInverse;
+	rayDirectionInverse[0] = rayDir[0] == btScalar(0.0) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.0) / rayDir[0];
+	rayDirectionInverse[1] = rayDir[1] == btScalar(0.0) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.0) / rayDir[1];
+	rayDirectionInverse[2] = rayDir[2] == btScalar(0.0) ? btScalar(BT_LARGE_FLOAT) : btScalar(1.0) / rayDir[2];
+	unsigned int signs[3] = {rayDirectionInverse[0] < 0.0, rayDirectionInverse[1] < 0.0, rayDirectionInverse[2] < 0.0};
+
+	btScalar lambda_max = rayDir.dot(rayTo - rayFrom);
+
+	btAlignedObjectArray<int> stack;
+	stack.reserve(btDbvt::SIMPLE_STACKSIZE);
+	stack.push_back(0);
+	do
+	{
+		const btDbvtWideNode& n = m_nodes[stack[stack.size() - 1]];
+		stack.pop_back();
+		const unsigned mask = RayOverlap4(n, rayFrom, rayDirectionInverse, signs, lambda_max);
+		for (int i = 0; i < 4; ++i)
+		{
+			if (mask & (1u << i))
+			{
+				if (n.childs[i] < 0)
+					policy.Process(m_leaves[~n.childs[i]]);
+				else
+					stack.push_back(n.childs[i]);
+			}
+		}
+	} while (stack.size() > 0);
+}
+
 //
 // PP Cleanup
 //
@@ -1574,5 +2111,6 @@ inline void btDbvt::collideTU(const btDbvtNode* root,
 #undef DBVT_SELECT_IMPL
 #undef DBVT_MERGE_IMPL
 #undef DBVT_INT0_IMPL
+#undef DBVT_WIDE_IMPL
 
 #endif
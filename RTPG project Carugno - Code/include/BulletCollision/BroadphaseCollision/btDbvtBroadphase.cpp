@@ -132,6 +132,8 @@ btDbvtBroadphase::btDbvtBroadphase(btOverlappingPairCache* paircache)
 {
 	m_deferedcollide = false;
 	m_needcleanup = true;
+	m_refitratio = 0;
+	m_needrefit = false;
 	m_releasepaircache = (paircache != 0) ? false : true;
 	m_prediction = 0;
 	m_stageCurrent = 0;
@@ -191,7 +193,7 @@ btBroadphaseProxy* btDbvtBroadphase::createProxy(const btVector3& aabbMin,
 	proxy->m_uniqueId = ++m_gid;
 	proxy->leaf = m_sets[0].insert(aabb, proxy);
 	listappend(proxy, m_stageRoots[m_stageCurrent]);
-	if (!m_deferedcollide)
+	if (!m_deferedcollide && m_refitratio <= 0)
 	{
 		btDbvtTreeCollider collider(this);
 		collider.proxy = proxy;
@@ -240,6 +242,8 @@ struct BroadphaseRayTester : btDbvt::ICollide
 void btDbvtBroadphase::rayTest(const btVector3& rayFrom, const btVector3& rayTo, btBroadphaseRayCallback& rayCallback, const btVector3& aabbMin, const btVector3& aabbMax)
 {
 	BroadphaseRayTester callback(rayCallback);
+	/* Moved leaves may be outside of their parents until the refit	*/
+	refitMovedLeaves();
 	btAlignedObjectArray<const btDbvtNode*>* stack = &m_rayTestStacks[0];
 #if BT_THREADSAFE
 	// for this function to be threadsafe, each thread must have a separate copy
@@ -300,6 +304,8 @@ struct BroadphaseAabbTester : btDbvt::ICollide
 void btDbvtBroadphase::aabbTest(const btVector3& aabbMin, const btVector3& aabbMax, btBroadphaseAabbCallback& aabbCallback)
 {
 	BroadphaseAabbTester callback(aabbCallback);
+	/* Moved leaves may be outside of their parents until the refit	*/
+	refitMovedLeaves();
 
 	const ATTRIBUTE_ALIGNED16(btDbvtVolume) bounds = btDbvtVolume::FromMM(aabbMin, aabbMax);
 	//process all children, that overlap with  the given AABB bounds
@@ -338,7 +344,19 @@ void btDbvtBroadphase::setAabb(btBroadphaseProxy* absproxy,
 				if (delta[0] < 0) velocity[0] = -velocity[0];
 				if (delta[1] < 0) velocity[1] = -velocity[1];
 				if (delta[2] < 0) velocity[2] = -velocity[2];
-				if (
+				if (m_refitratio > 0)
+				{ /* Moved in place		*/
+					if (!proxy->leaf->volume.Contain(aabb))
+					{
+						aabb.Expand(btVector3(gDbvtMargin, gDbvtMargin, gDbvtMargin));
+						aabb.SignedExpand(velocity);
+						proxy->leaf->volume = aabb;
+						m_needrefit = true;
+						++m_updates_done;
+						docollide = true;
+					}
+				}
+				else if (
 					m_sets[0].update(proxy->leaf, aabb, velocity, gDbvtMargin)
 
 				)
@@ -349,7 +367,15 @@ void btDbvtBroadphase::setAabb(btBroadphaseProxy* absproxy,
 			}
 			else
 			{ /* Teleporting			*/
-				m_sets[0].update(proxy->leaf, aabb);
+				if (m_refitratio > 0)
+				{
+					proxy->leaf->volume = aabb;
+					m_needrefit = true;
+				}
+				else
+				{
+					m_sets[0].update(proxy->leaf, aabb);
+				}
 				++m_updates_done;
 				docollide = true;
 			}
@@ -362,7 +388,7 @@ void btDbvtBroadphase::setAabb(btBroadphaseProxy* absproxy,
 		if (docollide)
 		{
 			m_needcleanup = true;
-			if (!m_deferedcollide)
+			if (!m_deferedcollide && m_refitratio <= 0)
 			{
 				btDbvtTreeCollider collider(this);
 				m_sets[1].collideTTpersistentStack(m_sets[1].m_root, proxy->leaf, collider);
@@ -392,7 +418,15 @@ void btDbvtBroadphase::setAabbForceUpdate(btBroadphaseProxy* absproxy,
 	{ /* dynamic set				*/
 		++m_updates_call;
 		/* Teleporting			*/
-		m_sets[0].update(proxy->leaf, aabb);
+		if (m_refitratio > 0)
+		{
+			proxy->leaf->volume = aabb;
+			m_needrefit = true;
+		}
+		else
+		{
+			m_sets[0].update(proxy->leaf, aabb);
+		}
 		++m_updates_done;
 		docollide = true;
 	}
@@ -404,7 +438,7 @@ void btDbvtBroadphase::setAabbForceUpdate(btBroadphaseProxy* absproxy,
 	if (docollide)
 	{
 		m_needcleanup = true;
-		if (!m_deferedcollide)
+		if (!m_deferedcollide && m_refitratio <= 0)
 		{
 			btDbvtTreeCollider collider(this);
 			m_sets[1].collideTTpersistentStack(m_sets[1].m_root, proxy->leaf, collider);
@@ -527,6 +561,8 @@ void btDbvtBroadphase::collide(btDispatcher* dispatcher)
 */
 
 	SPC(m_profiling.m_total);
+	/* refit				*/
+	refitMovedLeaves();
 	/* optimize				*/
 	m_sets[0].optimizeIncremental(1 + (m_sets[0].m_leaves * m_dupdates) / 100);
 	if (m_fixedleft)
@@ -567,12 +603,13 @@ void btDbvtBroadphase::collide(btDispatcher* dispatcher)
 	/* collide dynamics		*/
 	{
 		btDbvtTreeCollider collider(this);
-		if (m_deferedcollide)
+		const bool deferedcollide = m_deferedcollide || m_refitratio > 0;
+		if (deferedcollide)
 		{
 			SPC(m_profiling.m_fdcollide);
 			m_sets[0].collideTTpersistentStack(m_sets[0].m_root, m_sets[1].m_root, collider);
 		}
-		if (m_deferedcollide)
+		if (deferedcollide)
 		{
 			SPC(m_profiling.m_ddcollide);
 			m_sets[0].collideTTpersistentStack(m_sets[0].m_root, m_sets[0].m_root, collider);
@@ -623,6 +660,19 @@ void btDbvtBroadphase::collide(btDispatcher* dispatcher)
 	m_updates_call /= 2;
 }
 
+//
+void btDbvtBroadphase::refitMovedLeaves()
+{
+	if (!m_needrefit) return;
+	btMutexLock(&m_refitmutex);
+	if (m_needrefit)
+	{
+		m_sets[0].refitOrRebuild(m_refitratio);
+		m_needrefit = false;
+	}
+	btMutexUnlock(&m_refitmutex);
+}
+
 //
 void btDbvtBroadphase::optimize()
 {
@@ -673,6 +723,7 @@ void btDbvtBroadphase::resetPool(btDispatcher* dispatcher)
 
 		m_deferedcollide = false;
 		m_needcleanup = true;
+		m_needrefit = false;
 		m_stageCurrent = 0;
 		m_fixedleft = 0;
 		m_fupdates = 1;
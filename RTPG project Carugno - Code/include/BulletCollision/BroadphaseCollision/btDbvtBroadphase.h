@@ -19,6 +19,7 @@ subject to the following restrictions:
 
 #include "BulletCollision/BroadphaseCollision/btDbvt.h"
 #include "BulletCollision/BroadphaseCollision/btOverlappingPairCache.h"
+#include "LinearMath/btThreads.h"
 
 //
 // Compile time config
@@ -88,6 +89,9 @@ struct btDbvtBroadphase : btBroadphaseInterface
 	bool m_releasepaircache;                    // Release pair cache on delete
 	bool m_deferedcollide;                      // Defere dynamic/static collision to collide call
 	bool m_needcleanup;                         // Need to run cleanup?
+	btScalar m_refitratio;                      // > 0: dynamic leaves are moved in place, refit in collide (see btDbvt::refitOrRebuild), collisions are deferred
+	bool m_needrefit;                           // Dynamic leaves were moved in place
+	btSpinMutex m_refitmutex;                   // Refit of the queries that can run on several threads
 	btAlignedObjectArray<btAlignedObjectArray<const btDbvtNode*> > m_rayTestStacks;
 #if DBVT_BP_PROFILE
 	btClock m_clock;
@@ -105,6 +109,8 @@ struct btDbvtBroadphase : btBroadphaseInterface
 	~btDbvtBroadphase();
 	void collide(btDispatcher* dispatcher);
 	void optimize();
+	/* Refit the dynamic set if leaves were moved in place, called before the tree is traversed	*/
+	void refitMovedLeaves();
 
 	/* btBroadphaseInterface Implementation	*/
 	btBroadphaseProxy* createProxy(const btVector3& aabbMin, const btVector3& aabbMax, int shapeType, void* userPtr, int collisionFilterGroup, int collisionFilterMask, btDispatcher* dispatcher);
@@ -21,6 +21,12 @@ subject to the following restrictions:
 #include "BulletCollision/CollisionShapes/btCapsuleShape.h"
 #include "BulletSoftBody/btSoftBody.h"
 
+#if defined(BT_USE_DOUBLE_PRECISION) && defined(__AVX__)
+#include <immintrin.h>
+#elif defined(BT_USE_DOUBLE_PRECISION) && (defined(__SSE2__) || defined(_M_X64))
+#include <emmintrin.h>
+#endif
+
 btDefaultSoftBodySolver::btDefaultSoftBodySolver()
 {
 	// Initial we will clearly need to update solver constants
@@ -73,6 +79,30 @@ void btDefaultSoftBodySolver::solveConstraints(btScalar solverdt)
 	}
 }  // btDefaultSoftBodySolver::solveConstraints
 
+// Convert a vector to three floats of the output buffer.
+// With SIMD the components are converted together and written with a 64 bit and a 32 bit store,
+// the fourth float is never written so tightly packed layouts are not overrun.
+static SIMD_FORCE_INLINE void btStoreFloat3(float *out, const btVector3 &v)
+{
+#if defined(BT_USE_DOUBLE_PRECISION) && defined(__AVX__)
+	__m128 f = _mm256_cvtpd_ps(_mm256_loadu_pd(v.m_floats));
+	_mm_storel_pi((__m64 *)out, f);
+	_mm_store_ss(out + 2, _mm_movehl_ps(f, f));
+#elif defined(BT_USE_DOUBLE_PRECISION) && (defined(__SSE2__) || defined(_M_X64))
+	__m128 f = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(v.m_floats)), _mm_cvtpd_ps(_mm_loadu_pd(v.m_floats + 2)));
+	_mm_storel_pi((__m64 *)out, f);
+	_mm_store_ss(out + 2, _mm_movehl_ps(f, f));
+#elif defined(BT_USE_SSE) && !defined(BT_USE_DOUBLE_PRECISION)
+	__m128 f = v.get128();
+	_mm_storel_pi((__m64 *)out, f);
+	_mm_store_ss(out + 2, _mm_movehl_ps(f, f));
+#else
+	out[0] = (float)v.getX();
+	out[1] = (float)v.getY();
+	out[2] = (float)v.getZ();
+#endif
+}
+
 void btDefaultSoftBodySolver::copySoftBodyToVertexBuffer(const btSoftBody *const softBody, btVertexBufferDescriptor *vertexBuffer)
 {
 	// Currently only support CPU output buffers
@@ -88,6 +118,26 @@ void btDefaultSoftBodySolver::copySoftBodyToVertexBuffer(const btSoftBody *const
 		const btCPUVertexBufferDescriptor *cpuVertexBuffer = static_cast<btCPUVertexBufferDescriptor *>(vertexBuffer);
 		float *basePointer = cpuVertexBuffer->getBasePointer();
 
+		// Positions and normals are written in a single pass over the nodes,
+		// a node is much larger than the two vectors read from it
+		if (vertexBuffer->hasVertexPositions() && vertexBuffer->hasNormals())
+		{
+			const int vertexStride = cpuVertexBuffer->getVertexStride();
+			const int normalStride = cpuVertexBuffer->getNormalStride();
+			float *vertexPointer = basePointer + cpuVertexBuffer->getVertexOffset();
+			float *normalPointer = basePointer + cpuVertexBuffer->getNormalOffset();
+
+			for (int vertexIndex = 0; vertexIndex < numVertices; ++vertexIndex)
+			{
+				const btSoftBody::Node &node = clothVertices[vertexIndex];
+				btStoreFloat3(vertexPointer, node.m_x);
+				btStoreFloat3(normalPointer, node.m_n);
+				vertexPointer += vertexStride;
+				normalPointer += normalStride;
+			}
+			return;
+		}
+
 		if (vertexBuffer->hasVertexPositions())
 		{
 			const int vertexOffset = cpuVertexBuffer->getVertexOffset();
@@ -96,10 +146,7 @@ void btDefaultSoftBodySolver::copySoftBodyToVertexBuffer(const btSoftBody *const
 
 			for (int vertexIndex = 0; vertexIndex < numVertices; ++vertexIndex)
 			{
-				btVector3 position = clothVertices[vertexIndex].m_x;
-				*(vertexPointer + 0) = (float)position.getX();
-				*(vertexPointer + 1) = (float)position.getY();
-				*(vertexPointer + 2) = (float)position.getZ();
+				btStoreFloat3(vertexPointer, clothVertices[vertexIndex].m_x);
 				vertexPointer += vertexStride;
 			}
 		}
@@ -111,10 +158,7 @@ void btDefaultSoftBodySolver::copySoftBodyToVertexBuffer(const btSoftBody *const
 
 			for (int vertexIndex = 0; vertexIndex < numVertices; ++vertexIndex)
 			{
-				btVector3 normal = clothVertices[vertexIndex].m_n;
-				*(normalPointer + 0) = (float)normal.getX();
-				*(normalPointer + 1) = (float)normal.getY();
-				*(normalPointer + 2) = (float)normal.getZ();
+				btStoreFloat3(normalPointer, clothVertices[vertexIndex].m_n);
 				normalPointer += normalStride;
 			}
 		}
@@ -0,0 +1,368 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btDefaultSoftBodySolverMt.h"
+#include "BulletSoftBody/btSoftBody.h"
+#include "BulletCollision/BroadphaseCollision/btBroadphaseInterface.h"
+#include "BulletDynamics/Dynamics/btRigidBody.h"
+#include "LinearMath/btHashMap.h"
+#include "LinearMath/btQuickprof.h"
+
+// Without BT_THREADSAFE the solver runs the same code serially
+static void btSoftBodyParallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody& body)
+{
+#if BT_THREADSAFE
+	btParallelFor(iBegin, iEnd, grainSize, body);
+#else
+	body.forLoop(iBegin, iEnd);
+#endif
+}
+
+static int btFindGroupRoot(btAlignedObjectArray<int>& parents, int i)
+{
+	while (parents[i] != i)
+	{
+		parents[i] = parents[parents[i]];
+		i = parents[i];
+	}
+	return i;
+}
+
+static void btUniteGroups(btAlignedObjectArray<int>& parents, int a, int b)
+{
+	a = btFindGroupRoot(parents, a);
+	b = btFindGroupRoot(parents, b);
+	if (a < b)
+		parents[b] = a;
+	else if (b < a)
+		parents[a] = b;
+}
+
+// Largest cost first, ties in the order of the bodies
+struct btSoftBodyCostSortPredicate
+{
+	const int* m_costs;
+	btSoftBodyCostSortPredicate(const int* costs) : m_costs(costs) {}
+	bool operator()(int a, int b) const
+	{
+		if (m_costs[a] != m_costs[b])
+			return m_costs[a] > m_costs[b];
+		return a < b;
+	}
+};
+
+// Largest group first, the bodies of a group together and in their original order
+struct btSoftBodyGroupSortPredicate
+{
+	const int* m_roots;
+	const int* m_groupCosts;
+	btSoftBodyGroupSortPredicate(const int* roots, const int* groupCosts) : m_roots(roots), m_groupCosts(groupCosts) {}
+	bool operator()(int a, int b) const
+	{
+		const int ra = m_roots[a];
+		const int rb = m_roots[b];
+		if (m_groupCosts[ra] != m_groupCosts[rb])
+			return m_groupCosts[ra] > m_groupCosts[rb];
+		if (ra != rb)
+			return ra < rb;
+		return a < b;
+	}
+};
+
+// Range of the nodes of a body, to find the body of the faces in soft contacts
+struct btSoftBodyNodeRange
+{
+	const btSoftBody::Node* m_begin;
+	const btSoftBody::Node* m_end;
+	int m_body;
+};
+
+struct btSoftBodyNodeRangeSortPredicate
+{
+	bool operator()(const btSoftBodyNodeRange& a, const btSoftBodyNodeRange& b) const
+	{
+		return a.m_begin < b.m_begin;
+	}
+};
+
+static int btFindNodeOwner(const btAlignedObjectArray<btSoftBodyNodeRange>& ranges, const btSoftBody::Node* node)
+{
+	int lo = 0;
+	int hi = ranges.size() - 1;
+	while (lo <= hi)
+	{
+		const int mid = (lo + hi) / 2;
+		if (node < ranges[mid].m_begin)
+			hi = mid - 1;
+		else if (node >= ranges[mid].m_end)
+			lo = mid + 1;
+		else
+			return ranges[mid].m_body;
+	}
+	return -1;
+}
+
+struct btSoftBodyPredictMotionLoop : public btIParallelForBody
+{
+	btSoftBody* const* m_bodies;
+	const int* m_order;
+	btScalar m_timeStep;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			m_bodies[m_order[i]]->predictMotion(m_timeStep);
+		}
+	}
+};
+
+struct btSoftBodySolveConstraintsLoop : public btIParallelForBody
+{
+	btSoftBody* const* m_bodies;
+	const int* m_order;
+	const int* m_groups;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			for (int j = m_groups[i]; j < m_groups[i + 1]; ++j)
+			{
+				m_bodies[m_order[j]]->solveConstraints();
+			}
+		}
+	}
+};
+
+struct btSoftBodyIntegrateMotionLoop : public btIParallelForBody
+{
+	btSoftBody* const* m_bodies;
+	const int* m_order;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			m_bodies[m_order[i]]->integrateMotion();
+		}
+	}
+};
+
+btDefaultSoftBodySolverMt::btDefaultSoftBodySolverMt(int grainSize)
+	: m_grainSize(grainSize)
+{
+}
+
+btDefaultSoftBodySolverMt::~btDefaultSoftBodySolverMt()
+{
+}
+
+void btDefaultSoftBodySolverMt::gatherActiveBodies()
+{
+	const int numBodies = m_softBodySet.size();
+	m_costs.resize(numBodies);
+	m_groupBodies.resize(0);
+	for (int i = 0; i < numBodies; ++i)
+	{
+		const btSoftBody* psb = m_softBodySet[i];
+		m_costs[i] = psb->m_nodes.size() + psb->m_links.size() + psb->m_faces.size();
+		if (psb->isActive())
+		{
+			m_groupBodies.push_back(i);
+		}
+	}
+	if (m_groupBodies.size() > 1)
+	{
+		m_groupBodies.quickSort(btSoftBodyCostSortPredicate(&m_costs[0]));
+	}
+	m_groups.resize(m_groupBodies.size() + 1);
+	for (int i = 0; i < m_groups.size(); ++i)
+	{
+		m_groups[i] = i;
+	}
+}
+
+void btDefaultSoftBodySolverMt::buildConstraintGroups()
+{
+	BT_PROFILE("buildConstraintGroups");
+	const int numBodies = m_softBodySet.size();
+	const int numActive = m_groupBodies.size();
+	m_parents.resize(numBodies);
+	for (int i = 0; i < numBodies; ++i)
+	{
+		m_parents[i] = i;
+	}
+
+	btAlignedObjectArray<btSoftBodyNodeRange> ranges;
+	for (int i = 0; i < numBodies; ++i)
+	{
+		const btSoftBody* psb = m_softBodySet[i];
+		if (psb->m_nodes.size() > 0)
+		{
+			btSoftBodyNodeRange range;
+			range.m_begin = &psb->m_nodes[0];
+			range.m_end = range.m_begin + psb->m_nodes.size();
+			range.m_body = i;
+			ranges.push_back(range);
+		}
+	}
+	ranges.quickSort(btSoftBodyNodeRangeSortPredicate());
+
+	/* Bodies sharing a dynamic rigid body or a multibody push impulses into it	*/
+	btHashMap<btHashPtr, int> rigidOwners;
+	bool coupled = false;
+	for (int i = 0; i < numActive; ++i)
+	{
+		const int b = m_groupBodies[i];
+		const btSoftBody* psb = m_softBodySet[b];
+		for (int j = 0; j < psb->m_anchors.size(); ++j)
+		{
+			const void* key = psb->m_anchors[j].m_body;
+			if (const int* owner = rigidOwners.find(btHashPtr(key)))
+				btUniteGroups(m_parents, *owner, b);
+			else
+				rigidOwners.insert(btHashPtr(key), b);
+			coupled = true;
+		}
+		for (int j = 0; j < psb->m_rcontacts.size(); ++j)
+		{
+			const btCollisionObject* colObj = psb->m_rcontacts[j].m_cti.m_colObj;
+			const void* key = 0;
+			if (colObj->getInternalType() == btCollisionObject::CO_RIGID_BODY)
+			{
+				const btRigidBody* rigid = btRigidBody::upcast(colObj);
+				if (rigid && rigid->getInvMass() != 0)
+					key = rigid;
+			}
+			else if (colObj->getInternalType() == btCollisionObject::CO_FEATHERSTONE_LINK)
+			{
+				const btMultiBodyLinkCollider* link = btMultiBodyLinkCollider::upcast(colObj);
+				key = link ? (const void*)link->m_multiBody : (const void*)colObj;
+			}
+			if (!key)
+				continue;
+			if (const int* owner = rigidOwners.find(btHashPtr(key)))
+				btUniteGroups(m_parents, *owner, b);
+			else
+				rigidOwners.insert(btHashPtr(key), b);
+			coupled = true;
+		}
+		/* Soft contacts move the nodes of the faces of the other body	*/
+		const btSoftBody::Node* begin = psb->m_nodes.size() > 0 ? &psb->m_nodes[0] : 0;
+		const btSoftBody::Node* end = begin + psb->m_nodes.size();
+		for (int j = 0; j < psb->m_scontacts.size(); ++j)
+		{
+			const btSoftBody::SContact& c = psb->m_scontacts[j];
+			const btSoftBody::Node* nodes[2] = {c.m_node, c.m_face->m_n[0]};
+			for (int k = 0; k < 2; ++k)
+			{
+				if (nodes[k] >= begin && nodes[k] < end)
+					continue;
+				const int owner = btFindNodeOwner(ranges, nodes[k]);
+				if (owner >= 0)
+				{
+					btUniteGroups(m_parents, owner, b);
+					coupled = true;
+				}
+			}
+		}
+	}
+	if (!coupled)
+		return;
+
+	/* Sort by group, largest group first	*/
+	btAlignedObjectArray<int> groupCosts;
+	groupCosts.resize(numBodies, 0);
+	for (int i = 0; i < numBodies; ++i)
+	{
+		m_parents[i] = btFindGroupRoot(m_parents, i);
+	}
+	for (int i = 0; i < numActive; ++i)
+	{
+		const int b = m_groupBodies[i];
+		groupCosts[m_parents[b]] += m_costs[b];
+	}
+	m_groupBodies.quickSort(btSoftBodyGroupSortPredicate(&m_parents[0], &groupCosts[0]));
+	m_groups.resize(0);
+	for (int i = 0; i < numActive; ++i)
+	{
+		if (i == 0 || m_parents[m_groupBodies[i]] != m_parents[m_groupBodies[i - 1]])
+			m_groups.push_back(i);
+	}
+	m_groups.push_back(numActive);
+}
+
+void btDefaultSoftBodySolverMt::predictMotion(btScalar timeStep)
+{
+	gatherActiveBodies();
+	const int numActive = m_groupBodies.size();
+	if (numActive == 0)
+		return;
+
+	/* The broadphase is shared, the bodies update it afterwards in their order	*/
+	for (int i = 0; i < numActive; ++i)
+	{
+		m_softBodySet[m_groupBodies[i]]->m_deferBroadphaseUpdate = true;
+	}
+	btSoftBodyPredictMotionLoop loop;
+	loop.m_bodies = &m_softBodySet[0];
+	loop.m_order = &m_groupBodies[0];
+	loop.m_timeStep = timeStep;
+	btSoftBodyParallelFor(0, numActive, m_grainSize, loop);
+	for (int i = 0; i < m_softBodySet.size(); ++i)
+	{
+		btSoftBody* psb = m_softBodySet[i];
+		if (!psb->m_deferBroadphaseUpdate)
+			continue;
+		psb->m_deferBroadphaseUpdate = false;
+		if (psb->m_nodes.size() > 0 && psb->getBroadphaseHandle())
+		{
+			btSoftBodyWorldInfo* worldInfo = psb->getWorldInfo();
+			worldInfo->m_broadphase->setAabb(psb->getBroadphaseHandle(),
+											 psb->m_bounds[0],
+											 psb->m_bounds[1],
+											 worldInfo->m_dispatcher);
+		}
+	}
+}
+
+void btDefaultSoftBodySolverMt::solveConstraints(btScalar solverdt)
+{
+	gatherActiveBodies();
+	const int numActive = m_groupBodies.size();
+	if (numActive == 0)
+		return;
+	buildConstraintGroups();
+
+	btSoftBodySolveConstraintsLoop loop;
+	loop.m_bodies = &m_softBodySet[0];
+	loop.m_order = &m_groupBodies[0];
+	loop.m_groups = &m_groups[0];
+	btSoftBodyParallelFor(0, m_groups.size() - 1, m_grainSize, loop);
+}
+
+void btDefaultSoftBodySolverMt::updateSoftBodies()
+{
+	gatherActiveBodies();
+	const int numActive = m_groupBodies.size();
+	if (numActive == 0)
+		return;
+
+	btSoftBodyIntegrateMotionLoop loop;
+	loop.m_bodies = &m_softBodySet[0];
+	loop.m_order = &m_groupBodies[0];
+	btSoftBodyParallelFor(0, numActive, m_grainSize, loop);
+}
@@ -0,0 +1,54 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_SOFT_BODY_DEFAULT_SOLVER_MT_H
+#define BT_SOFT_BODY_DEFAULT_SOLVER_MT_H
+
+#include "btDefaultSoftBodySolver.h"
+#include "LinearMath/btThreads.h"
+
+///btDefaultSoftBodySolverMt runs the per-body work of btDefaultSoftBodySolver through btParallelFor.
+///Bodies are dispatched one per task, largest first, so a large body doesn't start after the small ones.
+///How much it gains over btDefaultSoftBodySolver depends on the number and the size of the active bodies,
+///it hasn't been measured on a multi-core machine yet.
+///Soft bodies that touch each other or the same dynamic rigid body are solved together, in their original order,
+///so the results are the same as the ones of btDefaultSoftBodySolver.
+class btDefaultSoftBodySolverMt : public btDefaultSoftBodySolver
+{
+public:
+	btDefaultSoftBodySolverMt(int grainSize = 1);
+
+	virtual ~btDefaultSoftBodySolverMt();
+
+	virtual void updateSoftBodies() BT_OVERRIDE;
+
+	virtual void solveConstraints(btScalar solverdt) BT_OVERRIDE;
+
+	virtual void predictMotion(btScalar solverdt) BT_OVERRIDE;
+
+protected:
+	/** Sort the active bodies by cost, largest first, into m_groupBodies with one group per body */
+	void gatherActiveBodies();
+	/** Merge the groups of the active bodies that share nodes or dynamic rigid bodies during solveConstraints */
+	void buildConstraintGroups();
+
+	btAlignedObjectArray<int> m_groupBodies;  // Indices in m_softBodySet of the active bodies, group after group
+	btAlignedObjectArray<int> m_groups;       // First entry in m_groupBodies of each group, plus the total
+	btAlignedObjectArray<int> m_parents;      // Union-find forest over m_softBodySet
+	btAlignedObjectArray<int> m_costs;        // Cost of each entry of m_softBodySet
+	int m_grainSize;
+};
+
+#endif  // #ifndef BT_SOFT_BODY_DEFAULT_SOLVER_MT_H
@@ -75,6 +75,9 @@ btDeformableMultiBodyDynamicsWorld::~btDeformableMultiBodyDynamicsWorld()
 void btDeformableMultiBodyDynamicsWorld::internalSingleStepSimulation(btScalar timeStep)
 {
 	BT_PROFILE("internalSingleStepSimulation");
+	// Free the sdf cells evicted during the last step, no collision is running
+	m_sbi.m_sparsesdf.BeginStep();
+
 	if (0 != m_internalPreTickCallback)
 	{
 		(*m_internalPreTickCallback)(this, timeStep);
@@ -24,7 +24,12 @@ subject to the following restrictions:
 #include "BulletDynamics/Featherstone/btMultiBodyConstraint.h"
 #include "BulletCollision/NarrowPhaseCollision/btGjkEpa2.h"
 #include "BulletCollision/CollisionShapes/btTriangleShape.h"
+#include "LinearMath/btThreads.h"
 #include <iostream>
+#if !defined(BT_USE_DOUBLE_PRECISION) && (defined(BT_USE_SSE) || defined(__SSE2__) || defined(_M_X64))
+#define BT_SOFTBODY_SSE_NORMALS
+#include <emmintrin.h>
+#endif
 //
 static inline btDbvtNode* buildTreeBottomUp(btAlignedObjectArray<btDbvtNode*>& leafNodes, btAlignedObjectArray<btAlignedObjectArray<int> >& adj)
 {
@@ -197,6 +202,12 @@ void btSoftBody::initDefaults()
 	m_cfg.citerations = 4;
 	m_cfg.drag = 0;
 	m_cfg.m_maxStress = 0;
+	m_cfg.m_useNodeSoA = false;
+	m_cfg.m_batchLinks = false;
+	m_cfg.m_fusedIntegrate = false;
+	m_cfg.m_treeRebuildRatio = 0;
+	m_cfg.m_linearTrees = false;
+	m_cfg.m_wideTrees = false;
 	m_cfg.collisions = fCollision::Default;
 	m_pose.m_bvolume = false;
 	m_pose.m_bframe = false;
@@ -207,6 +218,7 @@ void btSoftBody::initDefaults()
 	m_tag = 0;
 	m_timeacc = 0;
 	m_bUpdateRtCst = true;
+	m_deferBroadphaseUpdate = false;
 	m_bounds[0] = btVector3(0, 0, 0);
 	m_bounds[1] = btVector3(0, 0, 0);
 	m_worldTransform.setIdentity();
@@ -227,6 +239,8 @@ void btSoftBody::initDefaults()
 	m_collisionFlags = 0;
 	m_softSoftCollision = false;
 	m_maxSpeedSquared = 0;
+	m_sleepingEnergyThreshold = .0002;
+	m_kineticEnergy = 0;
 	m_repulsionStiffness = 0.5;
 	m_gravityFactor = 1;
 	m_cacheBarycenter = false;
@@ -400,6 +414,7 @@ void btSoftBody::appendLink(int model, Material* mat)
 		l.m_material = mat ? mat : m_materials[0];
 	}
 	m_links.push_back(l);
+	m_nodeSoA.m_updateLinks = true;
 }
 
 //
@@ -703,6 +718,8 @@ void btSoftBody::addForce(const btVector3& force, int node)
 	{
 		n.m_f += force;
 	}
+	if (getActivationState() == ISLAND_SLEEPING)
+		activate();
 }
 
 void btSoftBody::addAeroForceToNode(const btVector3& windVelocity, int nodeIndex)
@@ -907,6 +924,8 @@ void btSoftBody::setVelocity(const btVector3& velocity)
 			n.m_vn = velocity;
 		}
 	}
+	if (getActivationState() == ISLAND_SLEEPING)
+		activate();
 }
 
 //
@@ -917,6 +936,8 @@ void btSoftBody::addVelocity(const btVector3& velocity, int node)
 	{
 		n.m_v += velocity;
 	}
+	if (getActivationState() == ISLAND_SLEEPING)
+		activate();
 }
 
 //
@@ -1050,6 +1071,8 @@ void btSoftBody::setLinearVelocity(const btVector3& linVel)
 	btVector3 diff = linVel - old_vel;
 	for (int i = 0; i < m_nodes.size(); ++i)
 		m_nodes[i].m_v += diff;
+	if (getActivationState() == ISLAND_SLEEPING)
+		activate();
 }
 
 //
@@ -1061,6 +1084,8 @@ void btSoftBody::setAngularVelocity(const btVector3& angVel)
 	{
 		m_nodes[i].m_v = angVel.cross(m_nodes[i].m_x - com) + old_vel;
 	}
+	if (getActivationState() == ISLAND_SLEEPING)
+		activate();
 }
 
 //
@@ -1119,6 +1144,8 @@ void btSoftBody::transform(const btTransform& trs)
 	updateNormals();
 	updateBounds();
 	updateConstants();
+	if (getActivationState() == ISLAND_SLEEPING)
+		activate();
 }
 
 //
@@ -1158,6 +1185,8 @@ void btSoftBody::scale(const btVector3& scl)
 	updateBounds();
 	updateConstants();
 	initializeDmInverse();
+	if (getActivationState() == ISLAND_SLEEPING)
+		activate();
 }
 
 //
@@ -1175,6 +1204,7 @@ void btSoftBody::setRestLengthScale(btScalar restLengthScale)
 		l.m_rl = l.m_rl / m_restLengthScale * restLengthScale;
 		l.m_c1 = l.m_rl * l.m_rl;
 	}
+	m_nodeSoA.m_updateLinks = true;
 	m_restLengthScale = restLengthScale;
 
 	if (getActivationState() == ISLAND_SLEEPING)
@@ -1238,6 +1268,7 @@ void btSoftBody::resetLinkRestLengths()
 		l.m_rl = (l.m_n[0]->m_x - l.m_n[1]->m_x).length();
 		l.m_c1 = l.m_rl * l.m_rl;
 	}
+	m_nodeSoA.m_updateLinks = true;
 }
 
 //
@@ -1479,6 +1510,7 @@ void btSoftBody::randomizeConstraints()
 	{
 		btSwap(m_links[i], m_links[NEXTRAND % ni]);
 	}
+	m_nodeSoA.m_updateLinks = true;
 	for (i = 0, ni = m_faces.size(); i < ni; ++i)
 	{
 		btSwap(m_faces[i], m_faces[NEXTRAND % ni]);
@@ -2121,50 +2153,64 @@ void btSoftBody::predictMotion(btScalar dt)
 	/* Forces                */
 	addVelocity(m_worldInfo->m_gravity * m_sst.sdt);
 	applyForces();
-	/* Integrate            */
-	for (i = 0, ni = m_nodes.size(); i < ni; ++i)
+	const bool fused = m_cfg.m_fusedIntegrate && m_nodes.size() > 0;
+	ATTRIBUTE_ALIGNED16(btDbvtVolume)
+	vol;
+	if (fused)
 	{
-		Node& n = m_nodes[i];
-		n.m_q = n.m_x;
-		btVector3 deltaV = n.m_f * n.m_im * m_sst.sdt;
+		/* Integrate, bounds and nodes	*/
+		integrateFused();
+		/* Clusters                */
+		updateClusters();
+	}
+	else
+	{
+		/* Integrate            */
+		for (i = 0, ni = m_nodes.size(); i < ni; ++i)
 		{
-			btScalar maxDisplacement = m_worldInfo->m_maxDisplacement;
-			btScalar clampDeltaV = maxDisplacement / m_sst.sdt;
-			for (int c = 0; c < 3; c++)
+			Node& n = m_nodes[i];
+			n.m_q = n.m_x;
+			btVector3 deltaV = n.m_f * n.m_im * m_sst.sdt;
 			{
-				if (deltaV[c] > clampDeltaV)
-				{
-					deltaV[c] = clampDeltaV;
-				}
-				if (deltaV[c] < -clampDeltaV)
+				btScalar maxDisplacement = m_worldInfo->m_maxDisplacement;
+				btScalar clampDeltaV = maxDisplacement / m_sst.sdt;
+				for (int c = 0; c < 3; c++)
 				{
-					deltaV[c] = -clampDeltaV;
+					if (deltaV[c] > clampDeltaV)
+					{
+						deltaV[c] = clampDeltaV;
+					}
+					if (deltaV[c] < -clampDeltaV)
+					{
+						deltaV[c] = -clampDeltaV;
+					}
 				}
 			}
+			n.m_v += deltaV;
+			n.m_x += n.m_v * m_sst.sdt;
+			n.m_f = btVector3(0, 0, 0);
+		}
+		/* Clusters                */
+		updateClusters();
+		/* Bounds                */
+		updateBounds();
+		/* Nodes                */
+		for (i = 0, ni = m_nodes.size(); i < ni; ++i)
+		{
+			Node& n = m_nodes[i];
+			vol = btDbvtVolume::FromCR(n.m_x, m_sst.radmrg);
+			m_ndbvt.update(n.m_leaf,
+						   vol,
+						   n.m_v * m_sst.velmrg,
+						   m_sst.updmrg);
 		}
-		n.m_v += deltaV;
-		n.m_x += n.m_v * m_sst.sdt;
-		n.m_f = btVector3(0, 0, 0);
-	}
-	/* Clusters                */
-	updateClusters();
-	/* Bounds                */
-	updateBounds();
-	/* Nodes                */
-	ATTRIBUTE_ALIGNED16(btDbvtVolume)
-	vol;
-	for (i = 0, ni = m_nodes.size(); i < ni; ++i)
-	{
-		Node& n = m_nodes[i];
-		vol = btDbvtVolume::FromCR(n.m_x, m_sst.radmrg);
-		m_ndbvt.update(n.m_leaf,
-					   vol,
-					   n.m_v * m_sst.velmrg,
-					   m_sst.updmrg);
 	}
 	/* Faces                */
 	if (!m_fdbvt.empty())
 	{
+		const btVector3 updmrg(m_sst.updmrg, m_sst.updmrg, m_sst.updmrg);
+		m_movedLeaves.resize(0);
+		m_movedVolumes.resize(0);
 		for (int i = 0; i < m_faces.size(); ++i)
 		{
 			Face& f = m_faces[i];
@@ -2173,10 +2219,24 @@ void btSoftBody::predictMotion(btScalar dt)
 								 f.m_n[2]->m_v) /
 								3;
 			vol = VolumeOf(f, m_sst.radmrg);
-			m_fdbvt.update(f.m_leaf,
-						   vol,
-						   v * m_sst.velmrg,
-						   m_sst.updmrg);
+			if (!fused)
+			{
+				m_fdbvt.update(f.m_leaf,
+							   vol,
+							   v * m_sst.velmrg,
+							   m_sst.updmrg);
+			}
+			else if (!f.m_leaf->volume.Contain(vol))
+			{
+				vol.Expand(updmrg);
+				vol.SignedExpand(v * m_sst.velmrg);
+				m_movedLeaves.push_back(f.m_leaf);
+				m_movedVolumes.push_back(vol);
+			}
+		}
+		if (fused)
+		{
+			updateMovedLeaves(m_fdbvt, m_fdbvtLinear);
 		}
 	}
 	/* Pose                    */
@@ -2199,9 +2259,18 @@ void btSoftBody::predictMotion(btScalar dt)
 	m_rcontacts.resize(0);
 	m_scontacts.resize(0);
 	/* Optimize dbvt's        */
-	m_ndbvt.optimizeIncremental(1);
-	m_fdbvt.optimizeIncremental(1);
+	if (!fused || !(m_cfg.m_linearTrees || m_cfg.m_wideTrees))
+	{
+		m_ndbvt.optimizeIncremental(1);
+		m_fdbvt.optimizeIncremental(1);
+	}
 	m_cdbvt.optimizeIncremental(1);
+	/* Linear trees            */
+	if (m_cfg.m_linearTrees)
+	{
+		m_ndbvtLinear.update(m_ndbvt);
+		m_fdbvtLinear.update(m_fdbvt);
+	}
 }
 
 //
@@ -2233,6 +2302,14 @@ void btSoftBody::solveConstraints()
 		a.m_c2 = m_sst.sdt * a.m_node->m_im;
 		a.m_body->activate();
 	}
+	/* Prepare link batches	*/
+	const bool soa = m_cfg.m_useNodeSoA && m_nodes.size() > 0;
+	if (soa && (m_nodeSoA.m_updateLinks ||
+				m_nodeSoA.m_linksBatched != m_cfg.m_batchLinks ||
+				m_nodeSoA.m_lc0.size() != m_links.size()))
+	{
+		updateLinksSoA();
+	}
 	/* Solve velocities		*/
 	if (m_cfg.viterations > 0)
 	{
@@ -2241,7 +2318,10 @@ void btSoftBody::solveConstraints()
 		{
 			for (int iseq = 0; iseq < m_cfg.m_vsequence.size(); ++iseq)
 			{
-				getSolver(m_cfg.m_vsequence[iseq])(this, 1);
+				if (soa && m_cfg.m_vsequence[iseq] == eVSolver::Linear)
+					VSolve_LinksSoA(this, 1);
+				else
+					getSolver(m_cfg.m_vsequence[iseq])(this, 1);
 			}
 		}
 		/* Update			*/
@@ -2252,7 +2332,11 @@ void btSoftBody::solveConstraints()
 		}
 	}
 	/* Solve positions		*/
-	if (m_cfg.piterations > 0)
+	if (m_cfg.piterations > 0 && soa)
+	{
+		solvePositionsSoA();
+	}
+	else if (m_cfg.piterations > 0)
 	{
 		for (int isolve = 0; isolve < m_cfg.piterations; ++isolve)
 		{
@@ -2349,6 +2433,29 @@ void btSoftBody::integrateMotion()
 {
 	/* Update			*/
 	updateNormals();
+	/* Deactivation		*/
+	btScalar maxSpeed2 = 0;
+	btScalar energy = 0;
+	btScalar mass = 0;
+	for (int i = 0, ni = m_nodes.size(); i < ni; ++i)
+	{
+		const Node& n = m_nodes[i];
+		if (n.m_im > 0)
+		{
+			const btScalar v2 = n.m_v.length2();
+			maxSpeed2 = btMax(maxSpeed2, v2);
+			energy += v2 / n.m_im;
+			mass += 1 / n.m_im;
+		}
+	}
+	/* The nodes of a body at rest on something gain gravity*sdt at each step before the contacts	*/
+	/* push them back, a few nodes keep up to four times that after the solver and the body as a	*/
+	/* whole about half of it. Only the motion beyond it is kept, so the sleeping thresholds do not	*/
+	/* depend on the time step.																		*/
+	const btScalar kick = m_worldInfo ? m_worldInfo->m_gravity.length() * m_gravityFactor * m_sst.sdt : btScalar(0);
+	const btScalar maxSpeed = btMax(btSqrt(maxSpeed2) - 4 * kick, btScalar(0));
+	m_maxSpeedSquared = maxSpeed * maxSpeed;
+	m_kineticEnergy = mass > 0 ? btMax(btScalar(0.5) * energy / mass - btScalar(0.125) * kick * kick, btScalar(0)) : btScalar(0);
 }
 
 //
@@ -2474,6 +2581,7 @@ void btSoftBody::indicesToPointers(const int* map)
 		m_links[i].m_n[0] = IDX2PTR(m_links[i].m_n[0], base);
 		m_links[i].m_n[1] = IDX2PTR(m_links[i].m_n[1], base);
 	}
+	m_nodeSoA.m_updateLinks = true;
 	for (i = 0, ni = m_faces.size(); i < ni; ++i)
 	{
 		m_faces[i].m_n[0] = IDX2PTR(m_faces[i].m_n[0], base);
@@ -2533,7 +2641,10 @@ int btSoftBody::rayTest(const btVector3& rayFrom, const btVector3& rayTo,
 	{ /* Use dbvt	*/
 		RayFromToCaster collider(rayFrom, rayTo, mint);
 
-		btDbvt::rayTest(m_fdbvt.m_root, rayFrom, rayTo, collider);
+		if (m_fdbvtLinear.isCurrent(m_fdbvt))
+			m_fdbvtLinear.rayTest(rayFrom, rayTo, collider);
+		else
+			btDbvt::rayTest(m_fdbvt.m_root, rayFrom, rayTo, collider);
 		if (collider.m_face)
 		{
 			mint = collider.m_mint;
@@ -2581,7 +2692,10 @@ int btSoftBody::rayFaceTest(const btVector3& rayFrom, const btVector3& rayTo,
 	{ /* Use dbvt	*/
 		RayFromToCaster collider(rayFrom, rayTo, mint);
 
-		btDbvt::rayTest(m_fdbvt.m_root, rayFrom, rayTo, collider);
+		if (m_fdbvtLinear.isCurrent(m_fdbvt))
+			m_fdbvtLinear.rayTest(rayFrom, rayTo, collider);
+		else
+			btDbvt::rayTest(m_fdbvt.m_root, rayFrom, rayTo, collider);
 		if (collider.m_face)
 		{
 			mint = collider.m_mint;
@@ -2945,6 +3059,11 @@ bool btSoftBody::checkDeformableFaceContact(const btCollisionObjectWrapper* colO
 
 void btSoftBody::updateNormals()
 {
+	if (m_cfg.m_useNodeSoA && m_nodes.size() > 0)
+	{
+		updateNormalsSoA();
+		return;
+	}
 	const btVector3 zv(0, 0, 0);
 	int i, ni;
 
@@ -2971,6 +3090,300 @@ void btSoftBody::updateNormals()
 	}
 }
 
+#ifdef BT_SOFTBODY_SSE_NORMALS
+// Four vectors are normalized with one square root and one division per component group,
+// in the same order of operations as btVector3 so the results do not change
+static SIMD_FORCE_INLINE __m128 btSelect4(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// btVector3::safeNormalize on four vectors
+static SIMD_FORCE_INLINE void btSafeNormalize4(btVector3* v)
+{
+	__m128 x = _mm_load_ps(v[0].m_floats);
+	__m128 y = _mm_load_ps(v[1].m_floats);
+	__m128 z = _mm_load_ps(v[2].m_floats);
+	__m128 w = _mm_load_ps(v[3].m_floats);
+	_MM_TRANSPOSE4_PS(x, y, z, w);
+	const __m128 l2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+	const __m128 inv = _mm_div_ps(_mm_set1_ps(1), _mm_sqrt_ps(l2));
+	const __m128 valid = _mm_cmpge_ps(l2, _mm_set1_ps(SIMD_EPSILON * SIMD_EPSILON));
+	x = btSelect4(valid, _mm_mul_ps(x, inv), _mm_set1_ps(1));
+	y = btSelect4(valid, _mm_mul_ps(y, inv), _mm_setzero_ps());
+	z = btSelect4(valid, _mm_mul_ps(z, inv), _mm_setzero_ps());
+	w = btSelect4(valid, _mm_mul_ps(w, inv), _mm_setzero_ps());
+	_MM_TRANSPOSE4_PS(x, y, z, w);
+	_mm_store_ps(v[0].m_floats, x);
+	_mm_store_ps(v[1].m_floats, y);
+	_mm_store_ps(v[2].m_floats, z);
+	_mm_store_ps(v[3].m_floats, w);
+}
+
+// The node normals loop of updateNormals on four dense normals, written to the nodes
+static SIMD_FORCE_INLINE void btNormalizeNodeNormals4(const btVector3* v, btSoftBody::Node* nodes)
+{
+	__m128 x = _mm_load_ps(v[0].m_floats);
+	__m128 y = _mm_load_ps(v[1].m_floats);
+	__m128 z = _mm_load_ps(v[2].m_floats);
+	__m128 w = _mm_load_ps(v[3].m_floats);
+	_MM_TRANSPOSE4_PS(x, y, z, w);
+	const __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+	const __m128 inv = _mm_div_ps(_mm_set1_ps(1), len);
+	const __m128 valid = _mm_cmpgt_ps(len, _mm_set1_ps(SIMD_EPSILON));
+	x = btSelect4(valid, _mm_mul_ps(x, inv), x);
+	y = btSelect4(valid, _mm_mul_ps(y, inv), y);
+	z = btSelect4(valid, _mm_mul_ps(z, inv), z);
+	w = btSelect4(valid, _mm_mul_ps(w, inv), w);
+	_MM_TRANSPOSE4_PS(x, y, z, w);
+	_mm_store_ps(nodes[0].m_n.m_floats, x);
+	_mm_store_ps(nodes[1].m_n.m_floats, y);
+	_mm_store_ps(nodes[2].m_n.m_floats, z);
+	_mm_store_ps(nodes[3].m_n.m_floats, w);
+}
+#endif
+
+//
+void btSoftBody::updateNormalsSoA()
+{
+	/* Normals are summed in a dense array, the node positions are read in place	*/
+	NodeSoA& s = m_nodeSoA;
+	const int nn = m_nodes.size();
+	s.m_n.resize(nn);
+	btVector3* vn = &s.m_n[0];
+	for (int i = 0; i < nn; ++i)
+	{
+		vn[i].setZero();
+	}
+	/* Same order as updateNormals, the sums are identical	*/
+	const Node* base = &m_nodes[0];
+	int i = 0, ni = m_faces.size();
+#ifdef BT_SOFTBODY_SSE_NORMALS
+	for (; i + 4 <= ni; i += 4)
+	{
+		ATTRIBUTE_ALIGNED16(btVector3)
+		n[4];
+		for (int j = 0; j < 4; ++j)
+		{
+			const btSoftBody::Face& f = m_faces[i + j];
+			n[j] = btCross(f.m_n[1]->m_x - f.m_n[0]->m_x,
+						   f.m_n[2]->m_x - f.m_n[0]->m_x);
+			vn[f.m_n[0] - base] += n[j];
+			vn[f.m_n[1] - base] += n[j];
+			vn[f.m_n[2] - base] += n[j];
+		}
+		btSafeNormalize4(n);
+		for (int j = 0; j < 4; ++j)
+		{
+			m_faces[i + j].m_normal = n[j];
+		}
+	}
+#endif
+	for (; i < ni; ++i)
+	{
+		btSoftBody::Face& f = m_faces[i];
+		const btVector3 n = btCross(f.m_n[1]->m_x - f.m_n[0]->m_x,
+									f.m_n[2]->m_x - f.m_n[0]->m_x);
+		f.m_normal = n;
+		f.m_normal.safeNormalize();
+		vn[f.m_n[0] - base] += n;
+		vn[f.m_n[1] - base] += n;
+		vn[f.m_n[2] - base] += n;
+	}
+	i = 0;
+#ifdef BT_SOFTBODY_SSE_NORMALS
+	for (; i + 4 <= nn; i += 4)
+	{
+		btNormalizeNodeNormals4(&vn[i], &m_nodes[i]);
+	}
+#endif
+	for (; i < nn; ++i)
+	{
+		btVector3 n = vn[i];
+		const btScalar len = n.length();
+		if (len > SIMD_EPSILON)
+			n /= len;
+		m_nodes[i].m_n = n;
+	}
+}
+
+//
+void btSoftBody::gatherNodeSoA()
+{
+	NodeSoA& s = m_nodeSoA;
+	const int nn = m_nodes.size();
+	s.m_x.resize(nn);
+	s.m_q.resize(nn);
+	s.m_im.resize(nn);
+	for (int i = 0; i < nn; ++i)
+	{
+		const Node& n = m_nodes[i];
+		s.m_x[i] = n.m_x;
+		s.m_q[i] = n.m_q;
+		s.m_im[i] = n.m_im;
+	}
+	/* Anchors and rigid contacts are few, they are solved through m_nodes	*/
+	const Node* begin = &m_nodes[0];
+	s.m_anchors.resize(m_anchors.size());
+	for (int i = 0, ni = m_anchors.size(); i < ni; ++i)
+	{
+		s.m_anchors[i] = int(m_anchors[i].m_node - begin);
+	}
+	s.m_rcontacts.resize(m_rcontacts.size());
+	for (int i = 0, ni = m_rcontacts.size(); i < ni; ++i)
+	{
+		s.m_rcontacts[i] = int(m_rcontacts[i].m_node - begin);
+	}
+}
+
+//
+void btSoftBody::updateLinksSoA()
+{
+	NodeSoA& s = m_nodeSoA;
+	const int nl = m_links.size();
+	s.m_linkOrder.resize(nl);
+	s.m_linkBatches.resize(0);
+	if (m_cfg.m_batchLinks)
+	{
+		/* Greedy coloring, each link takes the first color not used by its nodes.
+		   Links of the same color share no node and can be solved in any order.
+		   Links left without a color are solved serially after the batches	*/
+		enum
+		{
+			MAX_COLORS = 64
+		};
+		btAlignedObjectArray<unsigned long long> nodeColors;
+		btAlignedObjectArray<int> linkColors;
+		btAlignedObjectArray<int> batchSizes;
+		nodeColors.resize(m_nodes.size(), 0);
+		linkColors.resize(nl);
+		batchSizes.resize(MAX_COLORS + 1, 0);
+		const Node* begin = &m_nodes[0];
+		int numColors = 0;
+		for (int i = 0; i < nl; ++i)
+		{
+			const int a = int(m_links[i].m_n[0] - begin);
+			const int b = int(m_links[i].m_n[1] - begin);
+			const unsigned long long used = nodeColors[a] | nodeColors[b];
+			int color = 0;
+			while (color < MAX_COLORS && (used & (1ULL << color)))
+				++color;
+			if (color < MAX_COLORS)
+			{
+				nodeColors[a] |= 1ULL << color;
+				nodeColors[b] |= 1ULL << color;
+				numColors = btMax(numColors, color + 1);
+			}
+			linkColors[i] = color;
+			++batchSizes[color];
+		}
+		/* Stable counting sort by color, the order does not depend on the threads	*/
+		btAlignedObjectArray<int> offsets;
+		offsets.resize(MAX_COLORS + 1);
+		int offset = 0;
+		for (int color = 0; color <= MAX_COLORS; ++color)
+		{
+			offsets[color] = offset;
+			if (color < numColors)
+				s.m_linkBatches.push_back(offset);
+			offset += batchSizes[color];
+		}
+		s.m_linkBatches.push_back(offsets[MAX_COLORS]);
+		for (int i = 0; i < nl; ++i)
+		{
+			s.m_linkOrder[offsets[linkColors[i]]++] = i;
+		}
+	}
+	else
+	{
+		/* A single serial range in the order of m_links	*/
+		for (int i = 0; i < nl; ++i)
+		{
+			s.m_linkOrder[i] = i;
+		}
+		s.m_linkBatches.push_back(0);
+	}
+	const Node* begin = &m_nodes[0];
+	s.m_links.resize(nl * 2);
+	s.m_lc0.resize(nl);
+	s.m_lc1.resize(nl);
+	for (int i = 0; i < nl; ++i)
+	{
+		const Link& l = m_links[s.m_linkOrder[i]];
+		s.m_links[i * 2] = int(l.m_n[0] - begin);
+		s.m_links[i * 2 + 1] = int(l.m_n[1] - begin);
+		s.m_lc0[i] = l.m_c0;
+		s.m_lc1[i] = l.m_c1;
+	}
+	s.m_updateLinks = false;
+	s.m_linksBatched = m_cfg.m_batchLinks;
+}
+
+//
+void btSoftBody::syncNodeSoA(const btAlignedObjectArray<int>& nodes, bool toNodes)
+{
+	NodeSoA& s = m_nodeSoA;
+	for (int i = 0, ni = nodes.size(); i < ni; ++i)
+	{
+		const int j = nodes[i];
+		if (toNodes)
+			m_nodes[j].m_x = s.m_x[j];
+		else
+			s.m_x[j] = m_nodes[j].m_x;
+	}
+}
+
+//
+void btSoftBody::solvePositionsSoA()
+{
+	gatherNodeSoA();
+	NodeSoA& s = m_nodeSoA;
+	for (int isolve = 0; isolve < m_cfg.piterations; ++isolve)
+	{
+		const btScalar ti = isolve / (btScalar)m_cfg.piterations;
+		for (int iseq = 0; iseq < m_cfg.m_psequence.size(); ++iseq)
+		{
+			switch (m_cfg.m_psequence[iseq])
+			{
+				case ePSolver::Linear:
+					PSolve_LinksSoA(this, 1, ti);
+					break;
+				case ePSolver::SContacts:
+					PSolve_SContactsSoA(this, 1, ti);
+					break;
+				case ePSolver::Anchors:
+					if (s.m_anchors.size() > 0)
+					{
+						syncNodeSoA(s.m_anchors, true);
+						PSolve_Anchors(this, 1, ti);
+						syncNodeSoA(s.m_anchors, false);
+					}
+					break;
+				case ePSolver::RContacts:
+					if (s.m_rcontacts.size() > 0)
+					{
+						syncNodeSoA(s.m_rcontacts, true);
+						PSolve_RContacts(this, 1, ti);
+						syncNodeSoA(s.m_rcontacts, false);
+					}
+					break;
+				default:
+				{
+				}
+			}
+		}
+	}
+	/* Velocities from the solved positions, written back with them	*/
+	const btScalar vc = m_sst.isdt * (1 - m_cfg.kDP);
+	for (int i = 0, ni = m_nodes.size(); i < ni; ++i)
+	{
+		Node& n = m_nodes[i];
+		n.m_x = s.m_x[i];
+		n.m_v = (s.m_x[i] - s.m_q[i]) * vc;
+		n.m_f = btVector3(0, 0, 0);
+	}
+}
+
 //
 void btSoftBody::updateBounds()
 {
@@ -3024,19 +3437,7 @@ void btSoftBody::updateBounds()
 					mins[d] = m_nodes[i].m_x[d];
 			}
 		}
-		const btScalar csm = getCollisionShape()->getMargin();
-		const btVector3 mrg = btVector3(csm,
-										csm,
-										csm);
-		m_bounds[0] = mins - mrg;
-		m_bounds[1] = maxs + mrg;
-		if (0 != getBroadphaseHandle())
-		{
-			m_worldInfo->m_broadphase->setAabb(getBroadphaseHandle(),
-											   m_bounds[0],
-											   m_bounds[1],
-											   m_worldInfo->m_dispatcher);
-		}
+		setBounds(mins, maxs);
 	}
 	else
 	{
@@ -3045,6 +3446,105 @@ void btSoftBody::updateBounds()
 	}
 }
 
+//
+void btSoftBody::setBounds(const btVector3& mins, const btVector3& maxs)
+{
+	const btScalar csm = getCollisionShape()->getMargin();
+	const btVector3 mrg = btVector3(csm,
+									csm,
+									csm);
+	m_bounds[0] = mins - mrg;
+	m_bounds[1] = maxs + mrg;
+	if (0 != getBroadphaseHandle() && !m_deferBroadphaseUpdate)
+	{
+		m_worldInfo->m_broadphase->setAabb(getBroadphaseHandle(),
+										   m_bounds[0],
+										   m_bounds[1],
+										   m_worldInfo->m_dispatcher);
+	}
+}
+
+//
+void btSoftBody::integrateFused()
+{
+	/* The integration, updateBounds and the node leaves of predictMotion in one pass over the nodes	*/
+	const btScalar clampDeltaV = m_worldInfo->m_maxDisplacement / m_sst.sdt;
+	const btVector3 clamp(clampDeltaV, clampDeltaV, clampDeltaV);
+	const btVector3 updmrg(m_sst.updmrg, m_sst.updmrg, m_sst.updmrg);
+	ATTRIBUTE_ALIGNED16(btDbvtVolume)
+	vol;
+	btVector3 mins(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+	btVector3 maxs(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+	m_movedLeaves.resize(0);
+	m_movedVolumes.resize(0);
+	for (int i = 0, ni = m_nodes.size(); i < ni; ++i)
+	{
+		Node& n = m_nodes[i];
+		n.m_q = n.m_x;
+		btVector3 deltaV = n.m_f * n.m_im * m_sst.sdt;
+		deltaV.setMin(clamp);
+		deltaV.setMax(-clamp);
+		n.m_v += deltaV;
+		n.m_x += n.m_v * m_sst.sdt;
+		n.m_f = btVector3(0, 0, 0);
+		mins.setMin(n.m_x);
+		maxs.setMax(n.m_x);
+		vol = btDbvtVolume::FromCR(n.m_x, m_sst.radmrg);
+		if (!n.m_leaf->volume.Contain(vol))
+		{
+			vol.Expand(updmrg);
+			vol.SignedExpand(n.m_v * m_sst.velmrg);
+			m_movedLeaves.push_back(n.m_leaf);
+			m_movedVolumes.push_back(vol);
+		}
+	}
+	setBounds(mins, maxs);
+	updateMovedLeaves(m_ndbvt, m_ndbvtLinear);
+}
+
+//
+bool btSoftBody::updateWideTrees()
+{
+	if (!m_cfg.m_wideTrees) return (false);
+	/* Most bodies never touch another one, the copies are only updated for the soft-soft pairs.	*/
+	/* The pairs run in parallel, the first one of the step refits or builds them.				*/
+	m_wideTreesMutex.lock();
+	m_ndbvtWide.update(m_ndbvt);
+	m_fdbvtWide.update(m_fdbvt);
+	m_wideTreesMutex.unlock();
+	return (true);
+}
+
+//
+void btSoftBody::updateMovedLeaves(btDbvt& tree, btDbvtLinear& linear)
+{
+	/* A few moved leaves are reinserted one by one like btDbvt::update does. When many of them moved,	*/
+	/* as for bodies in motion, the volumes are set in place and the tree is refit bottom-up in one	*/
+	/* pass, its topology does not change. With m_linearTrees the trees are always refit, in the same	*/
+	/* pass as their linear copies, and predictMotion does not optimize them. Same for m_wideTrees, the	*/
+	/* wide copies are refit from the leaves by updateWideTrees.										*/
+	const int moved = m_movedLeaves.size();
+	if (moved * 16 > tree.m_leaves || ((m_cfg.m_linearTrees || m_cfg.m_wideTrees) && moved > 0))
+	{
+		for (int i = 0; i < moved; ++i)
+		{
+			m_movedLeaves[i]->volume = m_movedVolumes[i];
+		}
+		btDbvtLinear* refitLinear = m_cfg.m_linearTrees ? &linear : 0;
+		if (m_cfg.m_treeRebuildRatio > 0)
+			tree.refitOrRebuild(m_cfg.m_treeRebuildRatio, refitLinear);
+		else
+			tree.refit(refitLinear);
+	}
+	else
+	{
+		for (int i = 0; i < moved; ++i)
+		{
+			tree.update(m_movedLeaves[i], m_movedVolumes[i]);
+		}
+	}
+}
+
 //
 void btSoftBody::updatePose()
 {
@@ -3158,6 +3658,7 @@ void btSoftBody::updateLinkConstants()
 		Material& m = *l.m_material;
 		l.m_c0 = (l.m_n[0]->m_im + l.m_n[1]->m_im) / m.m_kLST;
 	}
+	m_nodeSoA.m_updateLinks = true;
 }
 
 void btSoftBody::updateConstants()
@@ -4000,6 +4501,45 @@ void btSoftBody::PSolve_SContacts(btSoftBody* psb, btScalar, btScalar ti)
 	}
 }
 
+//
+void btSoftBody::PSolve_SContactsSoA(btSoftBody* psb, btScalar, btScalar ti)
+{
+	BT_PROFILE("PSolve_SContacts");
+	NodeSoA& s = psb->m_nodeSoA;
+	Node* begin = &psb->m_nodes[0];
+	Node* end = begin + psb->m_nodes.size();
+	for (int i = 0, ni = psb->m_scontacts.size(); i < ni; ++i)
+	{
+		const SContact& c = psb->m_scontacts[i];
+		const btVector3& nr = c.m_normal;
+		/* Faces of other bodies are read and written in their m_nodes	*/
+		btVector3* x[4];
+		const btVector3* q[4];
+		Node* nodes[] = {c.m_node, c.m_face->m_n[0], c.m_face->m_n[1], c.m_face->m_n[2]};
+		for (int j = 0; j < 4; ++j)
+		{
+			const bool own = nodes[j] >= begin && nodes[j] < end;
+			x[j] = own ? &s.m_x[int(nodes[j] - begin)] : &nodes[j]->m_x;
+			q[j] = own ? &s.m_q[int(nodes[j] - begin)] : &nodes[j]->m_q;
+		}
+		const btVector3 p = BaryEval(*x[1], *x[2], *x[3], c.m_weights);
+		const btVector3 pq = BaryEval(*q[1], *q[2], *q[3], c.m_weights);
+		const btVector3 vr = (*x[0] - *q[0]) - (p - pq);
+		btVector3 corr(0, 0, 0);
+		btScalar dot = btDot(vr, nr);
+		if (dot < 0)
+		{
+			const btScalar j = c.m_margin - (btDot(nr, *x[0]) - btDot(nr, p));
+			corr += c.m_normal * j;
+		}
+		corr -= ProjectOnPlane(vr, nr) * c.m_friction;
+		*x[0] += corr * c.m_cfm[0];
+		*x[1] -= corr * (c.m_cfm[1] * c.m_weights.x());
+		*x[2] -= corr * (c.m_cfm[1] * c.m_weights.y());
+		*x[3] -= corr * (c.m_cfm[1] * c.m_weights.z());
+	}
+}
+
 //
 void btSoftBody::PSolve_Links(btSoftBody* psb, btScalar kst, btScalar ti)
 {
@@ -4023,6 +4563,98 @@ void btSoftBody::PSolve_Links(btSoftBody* psb, btScalar kst, btScalar ti)
 	}
 }
 
+// Links of a batch share no node, so ranges of a batch can be solved by different threads
+struct btSoftBodyLinksPositionSolver : public btIParallelForBody
+{
+	btVector3* m_x;
+	const btScalar* m_im;
+	const int* m_nodes;
+	const btScalar* m_c0;
+	const btScalar* m_c1;
+	btScalar m_kst;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		btVector3* x = m_x;
+		const btScalar* im = m_im;
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			if (m_c0[i] > 0)
+			{
+				const int a = m_nodes[2 * i];
+				const int b = m_nodes[2 * i + 1];
+				const btVector3 del = x[b] - x[a];
+				const btScalar len = del.length2();
+				if (m_c1[i] + len > SIMD_EPSILON)
+				{
+					const btScalar k = ((m_c1[i] - len) / (m_c0[i] * (m_c1[i] + len))) * m_kst;
+					x[a] -= del * (k * im[a]);
+					x[b] += del * (k * im[b]);
+				}
+			}
+		}
+	}
+};
+
+struct btSoftBodyLinksVelocitySolver : public btIParallelForBody
+{
+	btSoftBody* m_psb;
+	const int* m_order;
+	btScalar m_kst;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		for (int i = iBegin; i < iEnd; ++i)
+		{
+			btSoftBody::Link& l = m_psb->m_links[m_order[i]];
+			btSoftBody::Node** n = l.m_n;
+			const btScalar j = -btDot(l.m_c3, n[0]->m_v - n[1]->m_v) * l.m_c2 * m_kst;
+			n[0]->m_v += l.m_c3 * (j * n[0]->m_im);
+			n[1]->m_v -= l.m_c3 * (j * n[1]->m_im);
+		}
+	}
+};
+
+// Batches larger than the grain are split between the threads, the others are solved on the calling thread
+// The grain is a guess, the break-even size of a parallel batch hasn't been measured on several cores
+static void btSolveLinkBatches(const btAlignedObjectArray<int>& batches, int numLinks, const btIParallelForBody& body)
+{
+	const int grainSize = 256;
+	const int numBatches = batches.size() - 1;
+	for (int i = 0; i < numBatches; ++i)
+	{
+#if BT_THREADSAFE
+		if (batches[i + 1] - batches[i] > grainSize)
+		{
+			btParallelFor(batches[i], batches[i + 1], grainSize, body);
+			continue;
+		}
+#endif
+		body.forLoop(batches[i], batches[i + 1]);
+	}
+	/* Links without a batch	*/
+	if (batches.size() > 0)
+		body.forLoop(batches[numBatches], numLinks);
+}
+
+//
+void btSoftBody::PSolve_LinksSoA(btSoftBody* psb, btScalar kst, btScalar ti)
+{
+	BT_PROFILE("PSolve_Links");
+	NodeSoA& s = psb->m_nodeSoA;
+	const int ni = s.m_lc0.size();
+	if (ni == 0)
+		return;
+	btSoftBodyLinksPositionSolver solver;
+	solver.m_x = &s.m_x[0];
+	solver.m_im = &s.m_im[0];
+	solver.m_nodes = &s.m_links[0];
+	solver.m_c0 = &s.m_lc0[0];
+	solver.m_c1 = &s.m_lc1[0];
+	solver.m_kst = kst;
+	btSolveLinkBatches(s.m_linkBatches, ni, solver);
+}
+
 //
 void btSoftBody::VSolve_Links(btSoftBody* psb, btScalar kst)
 {
@@ -4037,6 +4669,21 @@ void btSoftBody::VSolve_Links(btSoftBody* psb, btScalar kst)
 	}
 }
 
+//
+void btSoftBody::VSolve_LinksSoA(btSoftBody* psb, btScalar kst)
+{
+	BT_PROFILE("VSolve_Links");
+	NodeSoA& s = psb->m_nodeSoA;
+	const int ni = s.m_linkOrder.size();
+	if (ni == 0)
+		return;
+	btSoftBodyLinksVelocitySolver solver;
+	solver.m_psb = psb;
+	solver.m_order = &s.m_linkOrder[0];
+	solver.m_kst = kst;
+	btSolveLinkBatches(s.m_linkBatches, ni, solver);
+}
+
 //
 btSoftBody::psolver_t btSoftBody::getSolver(ePSolver::_ solver)
 {
@@ -4081,6 +4728,69 @@ bool btSoftBody::useSelfCollision()
 	return m_useSelfCollision;
 }
 
+//
+static void btCollideSDF_RS(btSoftBody* psb, const btCollisionObjectWrapper* pcoWrap, btSoftBody::tRContactArray* rcontacts)
+{
+	btSoftColliders::CollideSDF_RS docollide;
+	btRigidBody* prb1 = (btRigidBody*)btRigidBody::upcast(pcoWrap->getCollisionObject());
+	btTransform wtr = pcoWrap->getWorldTransform();
+
+	const btTransform ctr = pcoWrap->getWorldTransform();
+	const btScalar timemargin = (wtr.getOrigin() - ctr.getOrigin()).length();
+	const btScalar basemargin = psb->getCollisionShape()->getMargin();
+	btVector3 mins;
+	btVector3 maxs;
+	ATTRIBUTE_ALIGNED16(btDbvtVolume)
+	volume;
+	pcoWrap->getCollisionShape()->getAabb(pcoWrap->getWorldTransform(),
+										  mins,
+										  maxs);
+	volume = btDbvtVolume::FromMM(mins, maxs);
+	volume.Expand(btVector3(basemargin, basemargin, basemargin));
+	docollide.psb = psb;
+	docollide.m_colObj1Wrap = pcoWrap;
+	docollide.m_rigidBody = prb1;
+	docollide.m_rcontacts = rcontacts;
+
+	docollide.dynmargin = basemargin + timemargin;
+	docollide.stamargin = basemargin;
+	if (psb->m_ndbvtLinear.isCurrent(psb->m_ndbvt))
+		psb->m_ndbvtLinear.collideTV(volume, docollide);
+	else
+		psb->m_ndbvt.collideTV(psb->m_ndbvt.m_root, volume, docollide);
+}
+
+//
+template <class T>
+static void btCollideNodesFaces(btSoftBody* psb0, btSoftBody* psb1, T& docollide)
+{
+	if (psb0->updateWideTrees() && psb1->updateWideTrees())
+		psb0->m_ndbvtWide.collideTT(psb1->m_fdbvtWide, docollide);
+	else if (psb0->m_ndbvtLinear.isCurrent(psb0->m_ndbvt) && psb1->m_fdbvtLinear.isCurrent(psb1->m_fdbvt))
+		psb0->m_ndbvtLinear.collideTT(psb1->m_fdbvtLinear, docollide);
+	else
+		psb0->m_ndbvt.collideTT(psb0->m_ndbvt.m_root, psb1->m_fdbvt.m_root, docollide);
+}
+
+//
+static void btCollideVF_SS(btSoftBody* psb0, btSoftBody* psb1, btSoftBody::tSContactArray* scontacts0, btSoftBody::tSContactArray* scontacts1)
+{
+	btSoftColliders::CollideVF_SS docollide;
+	/* common					*/
+	docollide.mrg = psb0->getCollisionShape()->getMargin() +
+					psb1->getCollisionShape()->getMargin();
+	/* psb0 nodes vs psb1 faces	*/
+	docollide.psb[0] = psb0;
+	docollide.psb[1] = psb1;
+	docollide.m_scontacts = scontacts0;
+	btCollideNodesFaces(psb0, psb1, docollide);
+	/* psb1 nodes vs psb0 faces	*/
+	docollide.psb[0] = psb1;
+	docollide.psb[1] = psb0;
+	docollide.m_scontacts = scontacts1;
+	btCollideNodesFaces(psb1, psb0, docollide);
+}
+
 //
 void btSoftBody::defaultCollisionHandler(const btCollisionObjectWrapper* pcoWrap)
 {
@@ -4088,29 +4798,7 @@ void btSoftBody::defaultCollisionHandler(const btCollisionObjectWrapper* pcoWrap
 	{
 		case fCollision::SDF_RS:
 		{
-			btSoftColliders::CollideSDF_RS docollide;
-			btRigidBody* prb1 = (btRigidBody*)btRigidBody::upcast(pcoWrap->getCollisionObject());
-			btTransform wtr = pcoWrap->getWorldTransform();
-
-			const btTransform ctr = pcoWrap->getWorldTransform();
-			const btScalar timemargin = (wtr.getOrigin() - ctr.getOrigin()).length();
-			const btScalar basemargin = getCollisionShape()->getMargin();
-			btVector3 mins;
-			btVector3 maxs;
-			ATTRIBUTE_ALIGNED16(btDbvtVolume)
-			volume;
-			pcoWrap->getCollisionShape()->getAabb(pcoWrap->getWorldTransform(),
-												  mins,
-												  maxs);
-			volume = btDbvtVolume::FromMM(mins, maxs);
-			volume.Expand(btVector3(basemargin, basemargin, basemargin));
-			docollide.psb = this;
-			docollide.m_colObj1Wrap = pcoWrap;
-			docollide.m_rigidBody = prb1;
-
-			docollide.dynmargin = basemargin + timemargin;
-			docollide.stamargin = basemargin;
-			m_ndbvt.collideTV(m_ndbvt.m_root, volume, docollide);
+			btCollideSDF_RS(this, pcoWrap, 0);
 		}
 		break;
 		case fCollision::CL_RS:
@@ -4144,7 +4832,10 @@ void btSoftBody::defaultCollisionHandler(const btCollisionObjectWrapper* pcoWrap
 					docollideNode.m_rigidBody = prb1;
 					docollideNode.dynmargin = basemargin + timemargin;
 					docollideNode.stamargin = basemargin;
-					m_ndbvt.collideTV(m_ndbvt.m_root, volume, docollideNode);
+					if (m_ndbvtLinear.isCurrent(m_ndbvt))
+						m_ndbvtLinear.collideTV(volume, docollideNode);
+					else
+						m_ndbvt.collideTV(m_ndbvt.m_root, volume, docollideNode);
 				}
 
 				if (((pcoWrap->getCollisionObject()->getInternalType() == CO_RIGID_BODY) && (m_cfg.collisions & fCollision::SDF_RDF)) || ((pcoWrap->getCollisionObject()->getInternalType() == CO_FEATHERSTONE_LINK) && (m_cfg.collisions & fCollision::SDF_MDF)))
@@ -4155,7 +4846,10 @@ void btSoftBody::defaultCollisionHandler(const btCollisionObjectWrapper* pcoWrap
 					docollideFace.m_rigidBody = prb1;
 					docollideFace.dynmargin = basemargin + timemargin;
 					docollideFace.stamargin = basemargin;
-					m_fdbvt.collideTV(m_fdbvt.m_root, volume, docollideFace);
+					if (m_fdbvtLinear.isCurrent(m_fdbvt))
+						m_fdbvtLinear.collideTV(volume, docollideFace);
+					else
+						m_fdbvt.collideTV(m_fdbvt.m_root, volume, docollideFace);
 				}
 			}
 		}
@@ -4185,22 +4879,7 @@ void btSoftBody::defaultCollisionHandler(btSoftBody* psb)
 			//only self-collision for Cluster, not Vertex-Face yet
 			if (this != psb)
 			{
-				btSoftColliders::CollideVF_SS docollide;
-				/* common					*/
-				docollide.mrg = getCollisionShape()->getMargin() +
-								psb->getCollisionShape()->getMargin();
-				/* psb0 nodes vs psb1 faces	*/
-				docollide.psb[0] = this;
-				docollide.psb[1] = psb;
-				docollide.psb[0]->m_ndbvt.collideTT(docollide.psb[0]->m_ndbvt.m_root,
-													docollide.psb[1]->m_fdbvt.m_root,
-													docollide);
-				/* psb1 nodes vs psb0 faces	*/
-				docollide.psb[0] = psb;
-				docollide.psb[1] = this;
-				docollide.psb[0]->m_ndbvt.collideTT(docollide.psb[0]->m_ndbvt.m_root,
-													docollide.psb[1]->m_fdbvt.m_root,
-													docollide);
+				btCollideVF_SS(this, psb, 0, 0);
 			}
 		}
 		break;
@@ -4264,6 +4943,32 @@ void btSoftBody::defaultCollisionHandler(btSoftBody* psb)
 	}
 }
 
+//
+bool btSoftBody::gatherCollisions(const btCollisionObjectWrapper* pcoWrap, tRContactArray& rcontacts)
+{
+	if ((m_cfg.collisions & fCollision::RVSmask) != fCollision::SDF_RS)
+	{
+		return false;
+	}
+	btCollideSDF_RS(this, pcoWrap, &rcontacts);
+	return true;
+}
+
+//
+bool btSoftBody::gatherCollisions(btSoftBody* psb, tSContactArray& scontacts, tSContactArray& pscontacts)
+{
+	const int cf = m_cfg.collisions & psb->m_cfg.collisions;
+	if ((cf & fCollision::SVSmask) != fCollision::VF_SS)
+	{
+		return false;
+	}
+	if (this != psb)
+	{
+		btCollideVF_SS(this, psb, &scontacts, &pscontacts);
+	}
+	return true;
+}
+
 void btSoftBody::geometricCollisionHandler(btSoftBody* psb)
 {
 	if (psb->isActive() || this->isActive())
@@ -4718,7 +5423,8 @@ void btSoftBody::updateDeactivation(btScalar timeStep)
 	if ((getActivationState() == ISLAND_SLEEPING) || (getActivationState() == DISABLE_DEACTIVATION))
 		return;
 
-	if (m_maxSpeedSquared < m_sleepingThreshold * m_sleepingThreshold)
+	if ((m_maxSpeedSquared < m_sleepingThreshold * m_sleepingThreshold) &&
+		(m_kineticEnergy < m_sleepingEnergyThreshold))
 	{
 		m_deactivationTime += timeStep;
 	}
@@ -21,6 +21,7 @@ subject to the following restrictions:
 #include "LinearMath/btTransform.h"
 #include "LinearMath/btIDebugDraw.h"
 #include "LinearMath/btVector3.h"
+#include "LinearMath/btThreads.h"
 #include "BulletDynamics/Dynamics/btRigidBody.h"
 
 #include "BulletCollision/CollisionShapes/btConcaveShape.h"
@@ -738,6 +739,12 @@ public:
 		tPSolverArray m_dsequence;  // Drift solvers sequence
 		btScalar drag;              // deformable air drag
 		btScalar m_maxStress;       // Maximum principle first Piola stress
+		bool m_useNodeSoA;          // Solve positions and update normals on m_nodeSoA
+		bool m_batchLinks;          // Solve the links in independent batches, in parallel (with m_useNodeSoA)
+		bool m_fusedIntegrate;      // Integrate the nodes, bounds and tree leaves in one pass, refit the trees in bulk
+		btScalar m_treeRebuildRatio;  // Rebuild the refit trees when their SAH cost grows by this ratio, 0 never (btDbvt::refitOrRebuild)
+		bool m_linearTrees;         // Copy the node and face trees to btDbvtLinear in predictMotion for the collisions and ray tests, with m_fusedIntegrate the trees are only refit
+		bool m_wideTrees;           // Copy the node and face trees to btDbvtWide for the soft-soft collisions (VF_SS), updated by the first pair of the step
 	};
 	/* SolverState	*/
 	struct SolverState
@@ -757,6 +764,28 @@ public:
 		btScalar radmrg;  // radial margin
 		btScalar updmrg;  // Update margin
 	};
+	/* NodeSoA		*/
+	// Dense copies of the node fields read by the position solver and the normals update,
+	// m_nodes stays the reference outside of solveConstraints and updateNormals.
+	// The link arrays are kept between steps, code changing m_links or the link constants
+	// outside of btSoftBody must set m_updateLinks
+	struct NodeSoA
+	{
+		btAlignedObjectArray<btVector3> m_x;   // Positions
+		btAlignedObjectArray<btVector3> m_q;   // Previous step positions
+		btAlignedObjectArray<btVector3> m_n;   // Normals
+		btAlignedObjectArray<btScalar> m_im;   // 1/mass
+		btAlignedObjectArray<int> m_links;     // Node indices of the links in batch order, two per link
+		btAlignedObjectArray<btScalar> m_lc0;  // m_c0 of the links in batch order
+		btAlignedObjectArray<btScalar> m_lc1;  // m_c1 of the links in batch order
+		btAlignedObjectArray<int> m_linkOrder; // Indices in m_links of the links in batch order
+		btAlignedObjectArray<int> m_linkBatches;  // First link of each batch, the links from the last entry on are solved serially
+		bool m_linksBatched;                   // m_batchLinks when the link arrays were built
+		btAlignedObjectArray<int> m_anchors;   // Nodes of the anchors, copied to m_nodes around PSolve_Anchors
+		btAlignedObjectArray<int> m_rcontacts; // Nodes of the rigid contacts, copied around PSolve_RContacts
+		bool m_updateLinks;                    // Rebuild the link arrays before the next solve
+		NodeSoA() : m_linksBatched(false), m_updateLinks(true) {}
+	};
 	/// RayFromToCaster takes a ray from, ray to (instead of direction!)
 	struct RayFromToCaster : btDbvt::ICollide
 	{
@@ -807,6 +836,7 @@ public:
 
 	Config m_cfg;                      // Configuration
 	SolverState m_sst;                 // Solver state
+	NodeSoA m_nodeSoA;                 // Dense node arrays (m_cfg.m_useNodeSoA)
 	Pose m_pose;                       // Pose
 	void* m_tag;                       // User data
 	btSoftBodyWorldInfo* m_worldInfo;  // World info
@@ -832,14 +862,24 @@ public:
 	btScalar m_timeacc;             // Time accumulator
 	btVector3 m_bounds[2];          // Spatial bounds
 	bool m_bUpdateRtCst;            // Update runtime constants
+	bool m_deferBroadphaseUpdate;   // updateBounds leaves the broadphase update to the solver
 	btDbvt m_ndbvt;                 // Nodes tree
 	btDbvt m_fdbvt;                 // Faces tree
 	btDbvntNode* m_fdbvnt;          // Faces tree with normals
 	btDbvt m_cdbvt;                 // Clusters tree
+	btDbvtLinear m_ndbvtLinear;     // Copy of m_ndbvt (m_cfg.m_linearTrees)
+	btDbvtLinear m_fdbvtLinear;     // Copy of m_fdbvt (m_cfg.m_linearTrees)
+	btDbvtWide m_ndbvtWide;         // Copy of m_ndbvt (m_cfg.m_wideTrees)
+	btDbvtWide m_fdbvtWide;         // Copy of m_fdbvt (m_cfg.m_wideTrees)
+	btSpinMutex m_wideTreesMutex;   // Guards the update of the wide trees, the pairs are collided in parallel
+	tLeafArray m_movedLeaves;       // Leaves that left their volume in predictMotion (m_cfg.m_fusedIntegrate)
+	btAlignedObjectArray<btDbvtVolume> m_movedVolumes;  // New volumes of m_movedLeaves
 	tClusterArray m_clusters;       // Clusters
 	btScalar m_dampingCoefficient;  // Damping Coefficient
-	btScalar m_sleepingThreshold;
-	btScalar m_maxSpeedSquared;
+	btScalar m_sleepingThreshold;        // Node speed below which the body can sleep
+	btScalar m_maxSpeedSquared;          // Largest squared node speed, without the jitter of a body at rest for integrateMotion
+	btScalar m_sleepingEnergyThreshold;  // Kinetic energy per unit of mass below which the body can sleep
+	btScalar m_kineticEnergy;            // Kinetic energy of the nodes per unit of mass, set like m_maxSpeedSquared
 	btAlignedObjectArray<btVector3> m_quads;  // quadrature points for collision detection
 	btScalar m_repulsionStiffness;
 	btScalar m_gravityFactor;
@@ -1098,6 +1138,11 @@ public:
 	/* defaultCollisionHandlers												*/
 	void defaultCollisionHandler(const btCollisionObjectWrapper* pcoWrap);
 	void defaultCollisionHandler(btSoftBody* psb);
+	/* gatherCollisions: same contacts as defaultCollisionHandler, appended to the given arrays	*/
+	/* instead of the bodies, so pairs can be processed on several threads. Returns false,		*/
+	/* without looking for contacts, if the collision flags need defaultCollisionHandler.		*/
+	bool gatherCollisions(const btCollisionObjectWrapper* pcoWrap, tRContactArray& rcontacts);
+	bool gatherCollisions(btSoftBody* psb, tSContactArray& scontacts, tSContactArray& pscontacts);
 	void setSelfCollision(bool useSelfCollision);
 	bool useSelfCollision();
 	void updateDeactivation(btScalar timeStep);
@@ -1191,7 +1236,16 @@ public:
 	bool checkDeformableFaceContact(const btCollisionObjectWrapper* colObjWrap, Face& f, btVector3& contact_point, btVector3& bary, btScalar margin, btSoftBody::sCti& cti, bool predict = false) const;
 	bool checkContact(const btCollisionObjectWrapper* colObjWrap, const btVector3& x, btScalar margin, btSoftBody::sCti& cti) const;
 	void updateNormals();
+	void updateNormalsSoA();
+	void gatherNodeSoA();
+	void updateLinksSoA();
+	void syncNodeSoA(const btAlignedObjectArray<int>& nodes, bool toNodes);
+	void solvePositionsSoA();
 	void updateBounds();
+	void setBounds(const btVector3& mins, const btVector3& maxs);
+	void integrateFused();
+	void updateMovedLeaves(btDbvt& tree, btDbvtLinear& linear);
+	bool updateWideTrees();
 	void updatePose();
 	void updateConstants();
 	void updateLinkConstants();
@@ -1216,8 +1270,11 @@ public:
 	static void PSolve_Anchors(btSoftBody* psb, btScalar kst, btScalar ti);
 	static void PSolve_RContacts(btSoftBody* psb, btScalar kst, btScalar ti);
 	static void PSolve_SContacts(btSoftBody* psb, btScalar, btScalar ti);
+	static void PSolve_SContactsSoA(btSoftBody* psb, btScalar, btScalar ti);
 	static void PSolve_Links(btSoftBody* psb, btScalar kst, btScalar ti);
+	static void PSolve_LinksSoA(btSoftBody* psb, btScalar kst, btScalar ti);
 	static void VSolve_Links(btSoftBody* psb, btScalar kst);
+	static void VSolve_LinksSoA(btSoftBody* psb, btScalar kst);
 	static psolver_t getSolver(ePSolver::_ solver);
 	static vsolver_t getSolver(eVSolver::_ solver);
 	void geometricCollisionHandler(btSoftBody* psb);
@@ -1258,6 +1315,7 @@ public:
 	{
 		if (m_ndbvt.m_root)
 			updateNode(m_ndbvt.m_root, use_velocity, margin);
+		++m_ndbvt.m_revision;
 	}
 
 	template <class DBVTNODE>  // btDbvtNode or btDbvntNode
@@ -1301,6 +1359,7 @@ public:
 	{
 		if (m_fdbvt.m_root)
 			updateFace(m_fdbvt.m_root, use_velocity, margin);
+		++m_fdbvt.m_revision;
 		if (m_fdbvnt)
 			updateFace(m_fdbvnt, use_velocity, margin);
 	}
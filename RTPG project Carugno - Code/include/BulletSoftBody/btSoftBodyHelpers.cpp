@@ -661,6 +661,9 @@ void btSoftBodyHelpers::ReoptimizeLinkOrder(btSoftBody* psb /* This can be repla
 	delete[] linkDepFreeList;
 	delete[] linkDepListStarts;
 	delete[] linkBuffer;
+
+	// The links have been reordered
+	psb->m_nodeSoA.m_updateLinks = true;
 }
 
 //
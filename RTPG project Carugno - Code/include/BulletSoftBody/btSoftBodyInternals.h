@@ -1605,6 +1605,7 @@ struct btSoftColliders
 	//
 	struct CollideSDF_RS : btDbvt::ICollide
 	{
+		CollideSDF_RS() : m_rcontacts(0) {}
 		void Process(const btDbvtNode* leaf)
 		{
 			btSoftBody::Node* node = (btSoftBody::Node*)leaf->data;
@@ -1639,9 +1640,17 @@ struct btSoftColliders
 					c.m_c2 = ima * psb->m_sst.sdt;
 					c.m_c3 = fv.length2() < (dn * fc * dn * fc) ? 0 : 1 - fc;
 					c.m_c4 = m_colObj1Wrap->getCollisionObject()->isStaticOrKinematicObject() ? psb->m_cfg.kKHR : psb->m_cfg.kCHR;
-					psb->m_rcontacts.push_back(c);
-					if (m_rigidBody)
-						m_rigidBody->activate();
+					if (m_rcontacts)
+					{
+						// gathered contact, the rigid body is activated when it is merged into psb
+						m_rcontacts->push_back(c);
+					}
+					else
+					{
+						psb->m_rcontacts.push_back(c);
+						if (m_rigidBody)
+							m_rigidBody->activate();
+					}
 				}
 			}
 		}
@@ -1650,6 +1659,7 @@ struct btSoftColliders
 		btRigidBody* m_rigidBody;
 		btScalar dynmargin;
 		btScalar stamargin;
+		btSoftBody::tRContactArray* m_rcontacts;  // if set, contacts go here instead of psb->m_rcontacts
 	};
 
 	//
@@ -1870,6 +1880,7 @@ struct btSoftColliders
 	//
 	struct CollideVF_SS : btDbvt::ICollide
 	{
+		CollideVF_SS() : m_scontacts(0) {}
 		void Process(const btDbvtNode* lnode,
 					 const btDbvtNode* lface)
 		{
@@ -1913,12 +1924,16 @@ struct btSoftColliders
 					c.m_friction = btMax(psb[0]->m_cfg.kDF, psb[1]->m_cfg.kDF);
 					c.m_cfm[0] = ma / ms * psb[0]->m_cfg.kSHR;
 					c.m_cfm[1] = mb / ms * psb[1]->m_cfg.kSHR;
-					psb[0]->m_scontacts.push_back(c);
+					if (m_scontacts)
+						m_scontacts->push_back(c);
+					else
+						psb[0]->m_scontacts.push_back(c);
 				}
 			}
 		}
 		btSoftBody* psb[2];
 		btScalar mrg;
+		btSoftBody::tSContactArray* m_scontacts;  // if set, contacts go here instead of psb[0]->m_scontacts
 	};
 
 	//
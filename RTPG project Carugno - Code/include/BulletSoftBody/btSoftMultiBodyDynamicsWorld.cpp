@@ -77,6 +77,9 @@ void btSoftMultiBodyDynamicsWorld::predictUnconstraintMotion(btScalar timeStep)
 
 void btSoftMultiBodyDynamicsWorld::internalSingleStepSimulation(btScalar timeStep)
 {
+	// Free the sdf cells evicted during the last step, no collision is running
+	m_sbi.m_sparsesdf.BeginStep();
+
 	// Let the solver grab the soft bodies and if necessary optimize for it
 	m_softBodySolver->optimize(getSoftBodyArray());
 
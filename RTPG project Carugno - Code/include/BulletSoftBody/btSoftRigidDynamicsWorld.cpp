@@ -30,7 +30,8 @@ btSoftRigidDynamicsWorld::btSoftRigidDynamicsWorld(
 	btCollisionConfiguration* collisionConfiguration,
 	btSoftBodySolver* softBodySolver) : btDiscreteDynamicsWorld(dispatcher, pairCache, constraintSolver, collisionConfiguration),
 										m_softBodySolver(softBodySolver),
-										m_ownsSolver(false)
+										m_ownsSolver(false),
+										m_softBodyDeactivation(false)
 {
 	if (!m_softBodySolver)
 	{
@@ -77,6 +78,9 @@ void btSoftRigidDynamicsWorld::predictUnconstraintMotion(btScalar timeStep)
 
 void btSoftRigidDynamicsWorld::internalSingleStepSimulation(btScalar timeStep)
 {
+	// Free the sdf cells evicted during the last step, no collision is running
+	m_sbi.m_sparsesdf.BeginStep();
+
 	// Let the solver grab the soft bodies and if necessary optimize for it
 	m_softBodySolver->optimize(getSoftBodyArray());
 
@@ -91,19 +95,78 @@ void btSoftRigidDynamicsWorld::internalSingleStepSimulation(btScalar timeStep)
 	solveSoftBodiesConstraints(timeStep);
 
 	//self collisions
-	for (int i = 0; i < m_softBodies.size(); i++)
 	{
-		btSoftBody* psb = (btSoftBody*)m_softBodies[i];
-		psb->defaultCollisionHandler(psb);
+		BT_PROFILE("softBodySelfCollision");
+		for (int i = 0; i < m_softBodies.size(); i++)
+		{
+			btSoftBody* psb = (btSoftBody*)m_softBodies[i];
+			if (psb->isActive())
+			{
+				psb->defaultCollisionHandler(psb);
+			}
+		}
 	}
 
 	///update soft bodies
-	m_softBodySolver->updateSoftBodies();
+	{
+		BT_PROFILE("updateSoftBodies");
+		m_softBodySolver->updateSoftBodies();
+	}
 
 	// End solver-wise simulation step
 	// ///////////////////////////////
 }
 
+void btSoftRigidDynamicsWorld::updateActivationState(btScalar timeStep)
+{
+	if (m_softBodyDeactivation)
+	{
+		BT_PROFILE("updateSoftBodyActivationState");
+		for (int i = 0; i < m_softBodies.size(); i++)
+		{
+			btSoftBody* psb = m_softBodies[i];
+			psb->updateDeactivation(timeStep);
+			if (psb->wantsSleeping())
+			{
+				if (psb->getActivationState() == ACTIVE_TAG)
+					psb->setActivationState(WANTS_DEACTIVATION);
+				if (psb->getActivationState() == ISLAND_SLEEPING)
+				{
+					// the island fell asleep after predictMotion and before the soft body solver,
+					// go back to the positions of the last solve and drop the contacts
+					for (int j = 0; j < psb->m_nodes.size(); ++j)
+					{
+						btSoftBody::Node& n = psb->m_nodes[j];
+						n.m_x = n.m_q;
+						n.m_v.setZero();
+					}
+					psb->m_rcontacts.resize(0);
+					psb->m_scontacts.resize(0);
+				}
+			}
+			else
+			{
+				if (psb->getActivationState() != DISABLE_DEACTIVATION)
+					psb->setActivationState(ACTIVE_TAG);
+			}
+		}
+	}
+	btDiscreteDynamicsWorld::updateActivationState(timeStep);
+}
+
+void btSoftRigidDynamicsWorld::setSoftBodyDeactivation(bool enable)
+{
+	m_softBodyDeactivation = enable;
+	if (!enable)
+	{
+		for (int i = 0; i < m_softBodies.size(); i++)
+		{
+			if (m_softBodies[i]->getActivationState() == ISLAND_SLEEPING)
+				m_softBodies[i]->activate();
+		}
+	}
+}
+
 void btSoftRigidDynamicsWorld::solveSoftBodiesConstraints(btScalar timeStep)
 {
 	BT_PROFILE("solveSoftConstraints");
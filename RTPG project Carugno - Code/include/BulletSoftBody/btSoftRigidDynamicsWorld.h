@@ -34,10 +34,13 @@ class btSoftRigidDynamicsWorld : public btDiscreteDynamicsWorld
 	///Solver classes that encapsulate multiple soft bodies for solving
 	btSoftBodySolver* m_softBodySolver;
 	bool m_ownsSolver;
+	bool m_softBodyDeactivation;
 
 protected:
 	virtual void predictUnconstraintMotion(btScalar timeStep);
 
+	virtual void updateActivationState(btScalar timeStep);
+
 	virtual void internalSingleStepSimulation(btScalar timeStep);
 
 	void solveSoftBodiesConstraints(btScalar timeStep);
@@ -61,6 +64,13 @@ public:
 	int getDrawFlags() const { return (m_drawFlags); }
 	void setDrawFlags(int f) { m_drawFlags = f; }
 
+	///Soft bodies at rest are deactivated together with their simulation island, like rigid bodies.
+	///A body is at rest when its node speeds stay below m_sleepingThreshold and its kinetic energy below
+	///m_sleepingEnergyThreshold for gDeactivationTime. Sleeping bodies skip the solver and collisions with
+	///static or sleeping objects, they wake up when their island does or when a force is applied. Off by default.
+	void setSoftBodyDeactivation(bool enable);
+	bool getSoftBodyDeactivation() const { return m_softBodyDeactivation; }
+
 	btSoftBodyWorldInfo& getWorldInfo()
 	{
 		return m_sbi;
@@ -70,6 +80,11 @@ public:
 		return m_sbi;
 	}
 
+	btSoftBodySolver* getSoftBodySolver()
+	{
+		return m_softBodySolver;
+	}
+
 	virtual btDynamicsWorldType getWorldType() const
 	{
 		return BT_SOFT_RIGID_DYNAMICS_WORLD;
@@ -0,0 +1,356 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "btSoftRigidDynamicsWorldMt.h"
+#include "btSoftBodySolvers.h"
+#include "BulletCollision/BroadphaseCollision/btOverlappingPairCache.h"
+#include "BulletCollision/CollisionDispatch/btCollisionObjectWrapper.h"
+#include "BulletDynamics/Dynamics/btSimulationIslandManagerMt.h"
+#include "LinearMath/btQuickprof.h"
+
+///
+/// btSoftRigidCollisionDispatcherMt
+///
+
+btSoftRigidCollisionDispatcherMt::btSoftRigidCollisionDispatcherMt(btCollisionConfiguration* config, int grainSize)
+	: btCollisionDispatcherMt(config, grainSize),
+	  m_pairNearCallback(0)
+{
+	// the world can be stepped by a thread other than the one that set the task scheduler,
+	// so its thread index can be past the number of threads of the scheduler
+	m_batchManifoldsPtr.resize(BT_MAX_THREAD_COUNT);
+	m_batchReleasePtr.resize(BT_MAX_THREAD_COUNT);
+	m_threadContacts.resize(BT_MAX_THREAD_COUNT);
+}
+
+static bool btIsSoftBodyPair(const btBroadphasePair& pair)
+{
+	const btCollisionObject* colObj0 = static_cast<const btCollisionObject*>(pair.m_pProxy0->m_clientObject);
+	const btCollisionObject* colObj1 = static_cast<const btCollisionObject*>(pair.m_pProxy1->m_clientObject);
+	return colObj0->getInternalType() == btCollisionObject::CO_SOFT_BODY ||
+		   colObj1->getInternalType() == btCollisionObject::CO_SOFT_BODY;
+}
+
+void btSoftRigidCollisionDispatcherMt::rigidNearCallback(btBroadphasePair& collisionPair, btCollisionDispatcher& dispatcher, const btDispatcherInfo& dispatchInfo)
+{
+	if (btIsSoftBodyPair(collisionPair))
+	{
+		return;
+	}
+	static_cast<btSoftRigidCollisionDispatcherMt&>(dispatcher).m_pairNearCallback(collisionPair, dispatcher, dispatchInfo);
+}
+
+struct SoftBodyPairGatherer : public btIParallelForBody
+{
+	btSoftRigidCollisionDispatcherMt* m_dispatcher;
+	const btDispatcherInfo* m_info;
+
+	void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+	{
+		m_dispatcher->gatherSoftBodyPairs(iBegin, iEnd, *m_info);
+	}
+};
+
+void btSoftRigidCollisionDispatcherMt::dispatchAllCollisionPairs(btOverlappingPairCache* pairCache, const btDispatcherInfo& info, btDispatcher* dispatcher)
+{
+	const int pairCount = pairCache->getNumOverlappingPairs();
+	if (pairCount == 0)
+	{
+		return;
+	}
+
+	// rigid pairs in parallel
+	m_pairNearCallback = getNearCallback();
+	setNearCallback(rigidNearCallback);
+	btCollisionDispatcherMt::dispatchAllCollisionPairs(pairCache, info, dispatcher);
+	setNearCallback(m_pairNearCallback);
+	sortManifoldsByPair(pairCache);
+
+	// soft body pairs, gathered in parallel and merged in the order of the pair cache
+	BT_PROFILE("dispatchSoftBodyPairs");
+	btBroadphasePair* pairs = pairCache->getOverlappingPairArrayPtr();
+	m_softPairs.resize(0);
+	for (int i = 0; i < pairCount; ++i)
+	{
+		if (btIsSoftBodyPair(pairs[i]))
+		{
+			SoftPairContacts& softPair = m_softPairs.expandNonInitializing();
+			softPair.m_pair = &pairs[i];
+		}
+	}
+	if (m_softPairs.size() > 0)
+	{
+		SoftBodyPairGatherer gatherer;
+		gatherer.m_dispatcher = this;
+		gatherer.m_info = &info;
+		// the cost of a pair is the traversal of two trees, one pair per task
+		btParallelFor(0, m_softPairs.size(), 1, gatherer);
+		mergeSoftBodyPairs(info);
+	}
+}
+
+void btSoftRigidCollisionDispatcherMt::sortManifoldsByPair(btOverlappingPairCache* pairCache)
+{
+	// the threads append their new manifolds and release the old ones in the order they run,
+	// so the order of m_manifoldsPtr, and the solver results, would change from one run to the next
+	BT_PROFILE("sortManifoldsByPair");
+	for (int i = 0; i < m_manifoldsPtr.size(); ++i)
+	{
+		m_manifoldsPtr[i]->m_index1a = -1;
+	}
+
+	m_sortedManifolds.resize(0);
+	const int pairCount = pairCache->getNumOverlappingPairs();
+	btBroadphasePair* pairs = pairCache->getOverlappingPairArrayPtr();
+	for (int i = 0; i < pairCount; ++i)
+	{
+		if (!pairs[i].m_algorithm)
+		{
+			continue;
+		}
+		m_pairManifolds.resize(0);
+		pairs[i].m_algorithm->getAllContactManifolds(m_pairManifolds);
+		for (int j = 0; j < m_pairManifolds.size(); ++j)
+		{
+			// -1 means in m_manifoldsPtr and not placed yet
+			btPersistentManifold* manifold = m_pairManifolds[j];
+			if (manifold->m_index1a == -1)
+			{
+				manifold->m_index1a = m_sortedManifolds.size();
+				m_sortedManifolds.push_back(manifold);
+			}
+		}
+	}
+
+	// manifolds that no algorithm of the pair cache owns keep their order, after the others
+	for (int i = 0; i < m_manifoldsPtr.size(); ++i)
+	{
+		if (m_manifoldsPtr[i]->m_index1a == -1)
+		{
+			m_manifoldsPtr[i]->m_index1a = m_sortedManifolds.size();
+			m_sortedManifolds.push_back(m_manifoldsPtr[i]);
+		}
+	}
+
+	btAssert(m_sortedManifolds.size() == m_manifoldsPtr.size());
+	m_manifoldsPtr.copyFromArray(m_sortedManifolds);
+}
+
+void btSoftRigidCollisionDispatcherMt::gatherSoftBodyPairs(int iBegin, int iEnd, const btDispatcherInfo& info)
+{
+	const int threadIndex = btGetCurrentThreadIndex();
+	btAssert(threadIndex < m_threadContacts.size());
+	ThreadContacts& contacts = m_threadContacts[threadIndex];
+	const bool gatherable = (m_pairNearCallback == defaultNearCallback) && (info.m_dispatchFunc == btDispatcherInfo::DISPATCH_DISCRETE);
+
+	for (int i = iBegin; i < iEnd; ++i)
+	{
+		SoftPairContacts& softPair = m_softPairs[i];
+		btCollisionObject* colObj0 = static_cast<btCollisionObject*>(softPair.m_pair->m_pProxy0->m_clientObject);
+		btCollisionObject* colObj1 = static_cast<btCollisionObject*>(softPair.m_pair->m_pProxy1->m_clientObject);
+		btSoftBody* softBody0 = btSoftBody::upcast(colObj0);
+		btSoftBody* softBody1 = btSoftBody::upcast(colObj1);
+
+		softPair.m_softBody = softBody0 ? softBody0 : softBody1;
+		softPair.m_otherSoftBody = softBody0 ? softBody1 : 0;
+		softPair.m_rigidBody = 0;
+		softPair.m_thread = threadIndex;
+		softPair.m_rcontacts[0] = softPair.m_rcontacts[1] = contacts.m_rcontacts.size();
+		softPair.m_scontacts[0] = softPair.m_scontacts[1] = contacts.m_scontacts.size();
+		softPair.m_otherScontacts[0] = softPair.m_otherScontacts[1] = contacts.m_otherScontacts.size();
+		// the rigid body of a soft pair is activated during the merge, so the pairs that don't need collision
+		// now go through the near callback, which checks them again at their place in the pair cache
+		softPair.m_gathered = gatherable && needsCollision(colObj0, colObj1) &&
+							  softPair.m_softBody->getSoftBodySolver() &&
+							  softPair.m_softBody->getSoftBodySolver()->getSolverType() == btSoftBodySolver::DEFAULT_SOLVER;
+		if (!softPair.m_gathered)
+		{
+			continue;
+		}
+
+		if (softPair.m_otherSoftBody)
+		{
+			// same as btSoftSoftCollisionAlgorithm
+			softPair.m_gathered = softBody0->gatherCollisions(softBody1, contacts.m_scontacts, contacts.m_otherScontacts);
+		}
+		else
+		{
+			// same as btSoftRigidCollisionAlgorithm, concave shapes have their own algorithm
+			btCollisionObject* rigidObj = softBody0 ? colObj1 : colObj0;
+			if (!btBroadphaseProxy::isConvex(rigidObj->getCollisionShape()->getShapeType()))
+			{
+				softPair.m_gathered = false;
+				continue;
+			}
+			if (softPair.m_softBody->m_collisionDisabledObjects.findLinearSearch(rigidObj) == softPair.m_softBody->m_collisionDisabledObjects.size())
+			{
+				btCollisionObjectWrapper rigidWrap(0, rigidObj->getCollisionShape(), rigidObj, rigidObj->getWorldTransform(), -1, -1);
+				softPair.m_rigidBody = btRigidBody::upcast(rigidObj);
+				softPair.m_gathered = softPair.m_softBody->gatherCollisions(&rigidWrap, contacts.m_rcontacts);
+			}
+		}
+
+		softPair.m_rcontacts[1] = contacts.m_rcontacts.size();
+		softPair.m_scontacts[1] = contacts.m_scontacts.size();
+		softPair.m_otherScontacts[1] = contacts.m_otherScontacts.size();
+	}
+}
+
+void btSoftRigidCollisionDispatcherMt::mergeSoftBodyPairs(const btDispatcherInfo& info)
+{
+	BT_PROFILE("mergeSoftBodyPairs");
+	for (int i = 0; i < m_softPairs.size(); ++i)
+	{
+		const SoftPairContacts& softPair = m_softPairs[i];
+		if (!softPair.m_gathered)
+		{
+			m_pairNearCallback(*softPair.m_pair, *this, info);
+			continue;
+		}
+
+		const ThreadContacts& contacts = m_threadContacts[softPair.m_thread];
+		for (int j = softPair.m_rcontacts[0]; j < softPair.m_rcontacts[1]; ++j)
+		{
+			softPair.m_softBody->m_rcontacts.push_back(contacts.m_rcontacts[j]);
+		}
+		if (softPair.m_rigidBody && softPair.m_rcontacts[1] > softPair.m_rcontacts[0])
+		{
+			softPair.m_rigidBody->activate();
+		}
+		for (int j = softPair.m_scontacts[0]; j < softPair.m_scontacts[1]; ++j)
+		{
+			softPair.m_softBody->m_scontacts.push_back(contacts.m_scontacts[j]);
+		}
+		for (int j = softPair.m_otherScontacts[0]; j < softPair.m_otherScontacts[1]; ++j)
+		{
+			softPair.m_otherSoftBody->m_scontacts.push_back(contacts.m_otherScontacts[j]);
+		}
+	}
+
+	for (int i = 0; i < m_threadContacts.size(); ++i)
+	{
+		m_threadContacts[i].m_rcontacts.resize(0);
+		m_threadContacts[i].m_scontacts.resize(0);
+		m_threadContacts[i].m_otherScontacts.resize(0);
+	}
+}
+
+///
+/// btSoftRigidDynamicsWorldMt
+///
+
+btSoftRigidDynamicsWorldMt::btSoftRigidDynamicsWorldMt(btDispatcher* dispatcher,
+													   btBroadphaseInterface* pairCache,
+													   btConstraintSolverPoolMt* solverPool,
+													   btConstraintSolver* constraintSolverMt,
+													   btCollisionConfiguration* collisionConfiguration,
+													   btSoftBodySolver* softBodySolver)
+	: btSoftRigidDynamicsWorld(dispatcher, pairCache, solverPool, collisionConfiguration, softBodySolver)
+{
+	if (m_ownsIslandManager)
+	{
+		m_islandManager->~btSimulationIslandManager();
+		btAlignedFree(m_islandManager);
+	}
+	{
+		void* mem = btAlignedAlloc(sizeof(btSimulationIslandManagerMt), 16);
+		btSimulationIslandManagerMt* im = new (mem) btSimulationIslandManagerMt();
+		im->setMinimumSolverBatchSize(m_solverInfo.m_minimumSolverBatchSize);
+		m_islandManager = im;
+	}
+	m_constraintSolverMt = constraintSolverMt;
+}
+
+btSoftRigidDynamicsWorldMt::~btSoftRigidDynamicsWorldMt()
+{
+}
+
+void btSoftRigidDynamicsWorldMt::solveConstraints(btContactSolverInfo& solverInfo)
+{
+	BT_PROFILE("solveConstraints");
+
+	m_constraintSolver->prepareSolve(getCollisionWorld()->getNumCollisionObjects(), getCollisionWorld()->getDispatcher()->getNumManifolds());
+
+	/// solve all the constraints for this island
+	btSimulationIslandManagerMt* im = static_cast<btSimulationIslandManagerMt*>(m_islandManager);
+	btSimulationIslandManagerMt::SolverParams solverParams;
+	solverParams.m_solverPool = m_constraintSolver;
+	solverParams.m_solverMt = m_constraintSolverMt;
+	solverParams.m_solverInfo = &solverInfo;
+	solverParams.m_debugDrawer = m_debugDrawer;
+	solverParams.m_dispatcher = getCollisionWorld()->getDispatcher();
+	im->buildAndProcessIslands(getCollisionWorld()->getDispatcher(), getCollisionWorld(), m_constraints, solverParams);
+
+	m_constraintSolver->allSolved(solverInfo, m_debugDrawer);
+}
+
+void btSoftRigidDynamicsWorldMt::predictUnconstraintMotion(btScalar timeStep)
+{
+	{
+		BT_PROFILE("predictUnconstraintMotion");
+		if (m_nonStaticRigidBodies.size() > 0)
+		{
+			UpdaterUnconstrainedMotion update;
+			update.timeStep = timeStep;
+			update.rigidBodies = &m_nonStaticRigidBodies[0];
+			int grainSize = 50;  // num of iterations per task for task scheduler
+			btParallelFor(0, m_nonStaticRigidBodies.size(), grainSize, update);
+		}
+	}
+	{
+		BT_PROFILE("predictUnconstraintMotionSoftBody");
+		getSoftBodySolver()->predictMotion(float(timeStep));
+	}
+}
+
+void btSoftRigidDynamicsWorldMt::createPredictiveContacts(btScalar timeStep)
+{
+	BT_PROFILE("createPredictiveContacts");
+	releasePredictiveContacts();
+	if (m_nonStaticRigidBodies.size() > 0)
+	{
+		UpdaterCreatePredictiveContacts update;
+		update.world = this;
+		update.timeStep = timeStep;
+		update.rigidBodies = &m_nonStaticRigidBodies[0];
+		int grainSize = 50;  // num of iterations per task for task scheduler
+		btParallelFor(0, m_nonStaticRigidBodies.size(), grainSize, update);
+	}
+}
+
+void btSoftRigidDynamicsWorldMt::integrateTransforms(btScalar timeStep)
+{
+	BT_PROFILE("integrateTransforms");
+	if (m_nonStaticRigidBodies.size() > 0)
+	{
+		UpdaterIntegrateTransforms update;
+		update.world = this;
+		update.timeStep = timeStep;
+		update.rigidBodies = &m_nonStaticRigidBodies[0];
+		int grainSize = 50;  // num of iterations per task for task scheduler
+		btParallelFor(0, m_nonStaticRigidBodies.size(), grainSize, update);
+	}
+}
+
+int btSoftRigidDynamicsWorldMt::stepSimulation(btScalar timeStep, int maxSubSteps, btScalar fixedTimeStep)
+{
+	int numSubSteps = btSoftRigidDynamicsWorld::stepSimulation(timeStep, maxSubSteps, fixedTimeStep);
+	if (btITaskScheduler* scheduler = btGetTaskScheduler())
+	{
+		// tell Bullet's threads to sleep, so other threads can run
+		scheduler->sleepWorkerThreadsHint();
+	}
+	return numSubSteps;
+}
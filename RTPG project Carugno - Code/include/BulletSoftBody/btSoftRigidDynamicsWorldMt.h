@@ -0,0 +1,161 @@
+/*
+Bullet Continuous Collision Detection and Physics Library
+Copyright (c) 2003-2006 Erwin Coumans  https://bulletphysics.org
+
+This software is provided 'as-is', without any express or implied warranty.
+In no event will the authors be held liable for any damages arising from the use of this software.
+Permission is granted to anyone to use this software for any purpose,
+including commercial applications, and to alter it and redistribute it freely,
+subject to the following restrictions:
+
+1. The origin of this software must not be misrepresented; you must not claim that you wrote the original software. If you use this software in a product, an acknowledgment in the product documentation would be appreciated but is not required.
+2. Altered source versions must be plainly marked as such, and must not be misrepresented as being the original software.
+3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef BT_SOFT_RIGID_DYNAMICS_WORLD_MT_H
+#define BT_SOFT_RIGID_DYNAMICS_WORLD_MT_H
+
+#include "btSoftRigidDynamicsWorld.h"
+#include "btSoftBody.h"
+#include "BulletCollision/BroadphaseCollision/btCollisionAlgorithm.h"
+#include "BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h"
+#include "BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h"
+
+///
+/// btSoftRigidCollisionDispatcherMt -- btCollisionDispatcherMt for worlds with soft bodies.
+///
+///  The pairs of rigid bodies are processed in parallel first, then the manifolds are put back in the order of
+///  the pair cache, so the solver doesn't see them in the order the threads created them. A soft body collects
+///  the contacts of all its pairs in its own arrays, so the pairs with a soft body are processed in two steps:
+///  the contacts of each pair are gathered in parallel into per-thread arrays (btSoftBody::gatherCollisions),
+///  then merged into the soft bodies on the calling thread, in the order of the pair cache. The soft bodies get
+///  the same contacts in the same order as with btCollisionDispatcher, whatever the number of threads.
+///  Pairs that can't be gathered (custom near callback, cluster or deformable collisions, concave shapes...)
+///  go through the near callback during the merge.
+///
+class btSoftRigidCollisionDispatcherMt : public btCollisionDispatcherMt
+{
+public:
+	btSoftRigidCollisionDispatcherMt(btCollisionConfiguration* config, int grainSize = 40);
+
+	virtual void dispatchAllCollisionPairs(btOverlappingPairCache* pairCache, const btDispatcherInfo& info, btDispatcher* dispatcher) BT_OVERRIDE;
+
+	/** Gather the contacts of the soft body pairs m_softPairs[iBegin..iEnd), called by the parallel loop */
+	void gatherSoftBodyPairs(int iBegin, int iEnd, const btDispatcherInfo& info);
+
+protected:
+	static void rigidNearCallback(btBroadphasePair& collisionPair, btCollisionDispatcher& dispatcher, const btDispatcherInfo& dispatchInfo);
+
+	void mergeSoftBodyPairs(const btDispatcherInfo& info);
+
+	/** Reorder m_manifoldsPtr by the pair cache, the manifolds of a pair in the order of its algorithm */
+	void sortManifoldsByPair(btOverlappingPairCache* pairCache);
+
+	struct SoftPairContacts
+	{
+		btBroadphasePair* m_pair;
+		btSoftBody* m_softBody;       // soft body of the pair, first one for two soft bodies
+		btSoftBody* m_otherSoftBody;  // second soft body, or 0
+		btRigidBody* m_rigidBody;     // rigid body to activate if there are contacts
+		bool m_gathered;              // false if the pair must go through the near callback
+		int m_thread;                 // index in m_threadContacts of the gathered contacts
+		int m_rcontacts[2];           // ranges of the contacts in the arrays of m_thread
+		int m_scontacts[2];
+		int m_otherScontacts[2];
+	};
+
+	struct ThreadContacts
+	{
+		btSoftBody::tRContactArray m_rcontacts;
+		btSoftBody::tSContactArray m_scontacts;
+		btSoftBody::tSContactArray m_otherScontacts;
+	};
+
+	btNearCallback m_pairNearCallback;  // near callback of the dispatcher, called for the pairs of both passes
+	btAlignedObjectArray<SoftPairContacts> m_softPairs;
+	btAlignedObjectArray<ThreadContacts> m_threadContacts;  // one per thread index
+	btManifoldArray m_pairManifolds;                        // manifolds of one pair, used by sortManifoldsByPair
+	btAlignedObjectArray<btPersistentManifold*> m_sortedManifolds;
+};
+
+///
+/// btSoftRigidDynamicsWorldMt -- a version of btSoftRigidDynamicsWorld with the changes of btDiscreteDynamicsWorldMt.
+///
+///  Islands are solved on multiple threads, and predictUnconstraintMotion, integrateTransforms and
+///  createPredictiveContacts iterate over the rigid bodies in parallel.
+///  Use it with btSoftRigidCollisionDispatcherMt, and with btDefaultSoftBodySolverMt to step the soft bodies in parallel.
+///  No scaling numbers have been recorded for it, compare it with btSoftRigidDynamicsWorld with physicsBench
+///  --world parallel|serial and --threads before relying on a speed-up.
+///
+ATTRIBUTE_ALIGNED16(class)
+btSoftRigidDynamicsWorldMt : public btSoftRigidDynamicsWorld
+{
+protected:
+	btConstraintSolver* m_constraintSolverMt;
+
+	virtual void solveConstraints(btContactSolverInfo & solverInfo) BT_OVERRIDE;
+
+	struct UpdaterUnconstrainedMotion : public btIParallelForBody
+	{
+		btScalar timeStep;
+		btRigidBody** rigidBodies;
+
+		void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+		{
+			for (int i = iBegin; i < iEnd; ++i)
+			{
+				btRigidBody* body = rigidBodies[i];
+				if (!body->isStaticOrKinematicObject())
+				{
+					//don't integrate/update velocities here, it happens in the constraint solver
+					body->applyDamping(timeStep);
+					body->predictIntegratedTransform(timeStep, body->getInterpolationWorldTransform());
+				}
+			}
+		}
+	};
+	virtual void predictUnconstraintMotion(btScalar timeStep) BT_OVERRIDE;
+
+	struct UpdaterCreatePredictiveContacts : public btIParallelForBody
+	{
+		btScalar timeStep;
+		btRigidBody** rigidBodies;
+		btSoftRigidDynamicsWorldMt* world;
+
+		void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+		{
+			world->createPredictiveContactsInternal(&rigidBodies[iBegin], iEnd - iBegin, timeStep);
+		}
+	};
+	virtual void createPredictiveContacts(btScalar timeStep) BT_OVERRIDE;
+
+	struct UpdaterIntegrateTransforms : public btIParallelForBody
+	{
+		btScalar timeStep;
+		btRigidBody** rigidBodies;
+		btSoftRigidDynamicsWorldMt* world;
+
+		void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+		{
+			world->integrateTransformsInternal(&rigidBodies[iBegin], iEnd - iBegin, timeStep);
+		}
+	};
+	virtual void integrateTransforms(btScalar timeStep) BT_OVERRIDE;
+
+public:
+	BT_DECLARE_ALIGNED_ALLOCATOR();
+
+	btSoftRigidDynamicsWorldMt(btDispatcher * dispatcher,
+							   btBroadphaseInterface * pairCache,
+							   btConstraintSolverPoolMt * solverPool,    // Note this should be a solver-pool for multi-threading
+							   btConstraintSolver * constraintSolverMt,  // single multi-threaded solver for large islands (or NULL)
+							   btCollisionConfiguration * collisionConfiguration,
+							   btSoftBodySolver * softBodySolver = 0);
+
+	virtual ~btSoftRigidDynamicsWorldMt();
+
+	virtual int stepSimulation(btScalar timeStep, int maxSubSteps, btScalar fixedTimeStep) BT_OVERRIDE;
+};
+
+#endif  //BT_SOFT_RIGID_DYNAMICS_WORLD_MT_H
@@ -19,6 +19,9 @@ subject to the following restrictions:
 
 #include "BulletCollision/CollisionDispatch/btCollisionObject.h"
 #include "BulletCollision/NarrowPhaseCollision/btGjkEpa2.h"
+#include "LinearMath/btThreads.h"
+#include "LinearMath/btHashMap.h"
+#include <atomic>
 
 // Fast Hash
 
@@ -54,6 +57,12 @@ inline unsigned int HsiehHash(const char* data, int len)
 	return hash;
 }
 
+///btSparseSdf caches the signed distances to the convex shapes in cells of CELLSIZE^3 voxels, in shape space.
+///Evaluate reads the cells without locking: a missing cell is built outside of the lock, then inserted at the head
+///of its bucket under m_mutex. Each shape has a budget of cells, past it the least recently used cell of the shape
+///is evicted (a clock over the steps of BeginStep, the cells used in this step get a second chance). The evicted
+///cells stay readable until BeginStep, GarbageCollect or Reset frees them, none of them can run during Evaluate.
+///Precompute builds the cells of a static shape ahead of the queries, they are never evicted.
 template <const int CELLSIZE>
 struct btSparseSdf
 {
@@ -70,24 +79,49 @@ struct btSparseSdf
 	{
 		btScalar d[CELLSIZE + 1][CELLSIZE + 1][CELLSIZE + 1];
 		int c[3];
-		int puid;
+		int puid;  // Step of the last use, written by Evaluate without the lock
 		unsigned hash;
 		const btCollisionShape* pclient;
-		Cell* next;
+		Cell* next;     // Next cell of the bucket, read by Evaluate without the lock
+		Cell* lruPrev;  // Cells of the same shape, least recently used first, under the lock
+		Cell* lruNext;  // Also links the retired cells
+	};
+	// Cells of one shape
+	struct ShapeCache
+	{
+		const btCollisionShape* shape;
+		int ncells;
+		int budget;     // Maximum number of cells, 0 for m_defaultBudget
+		bool isStatic;  // Precomputed, its cells are never evicted
+		long long evictions;
+		Cell* lruHead;
+		Cell* lruTail;
 	};
 	//
 	// Fields
 	//
 
-	btAlignedObjectArray<Cell*> cells;
+	btAlignedObjectArray<Cell*> cells;  // Buckets
 	btScalar voxelsz;
 	btScalar m_defaultVoxelsz;
 	int puid;
 	int ncells;
 	int m_clampCells;
-	int nprobes;
-	int nqueries;
+	int m_defaultBudget;  // Cells of a shape without budget, 0 only clamps the total
+	btAlignedObjectArray<ShapeCache> m_shapes;
+	btHashMap<btHashPtr, int> m_shapeIndices;  // Index in m_shapes of each shape
+	Cell* m_retired;                           // Evicted cells that can still be read, freed by BeginStep
+	int m_nretired;
+	// Counters since the last ResetCounters, the hits are m_queries - m_misses
+	long long m_queries;
+	long long m_misses;
+	long long m_evictions;
+	btSpinMutex m_mutex;  // Guards the insertions and evictions, Evaluate reads the cells without it
 
+	btSparseSdf() : m_clampCells(256 * 1024), m_defaultBudget(0), m_retired(0), m_nretired(0)
+	{
+		ResetCounters();
+	}
 	~btSparseSdf()
 	{
 		Reset();
@@ -100,11 +134,12 @@ struct btSparseSdf
 	void Initialize(int hashsize = 2383, int clampCells = 256 * 1024)
 	{
 		//avoid a crash due to running out of memory, so clamp the maximum number of cells allocated
-		//if this limit is reached, the SDF is reset (at the cost of some performance during the reset)
+		//if this limit is reached, the least recently used cells of the largest shape are evicted
 		m_clampCells = clampCells;
+		Reset();
 		cells.resize(hashsize, 0);
 		m_defaultVoxelsz = 0.25;
-		Reset();
+		voxelsz = m_defaultVoxelsz;
 	}
 	//
 
@@ -113,6 +148,41 @@ struct btSparseSdf
 		m_defaultVoxelsz = sz;
 	}
 
+	// Budget of the shapes without their own, 0 only clamps the total number of cells
+	void setDefaultBudget(int maxCells)
+	{
+		m_defaultBudget = maxCells;
+	}
+
+	// Maximum number of cells of shape, 0 for the default budget
+	void setShapeBudget(const btCollisionShape* shape, int maxCells)
+	{
+		btMutexLock(&m_mutex);
+		GetShapeCache(shape).budget = maxCells;
+		btMutexUnlock(&m_mutex);
+	}
+
+	// Cells and evictions of shape, 0 if it has no cells
+	const ShapeCache* FindShapeCache(const btCollisionShape* shape) const
+	{
+		const int* index = m_shapeIndices.find(btHashPtr(shape));
+		return (index ? &m_shapes[*index] : 0);
+	}
+
+	// Fraction of the Evaluate calls that found their cell since the last ResetCounters
+	btScalar GetHitRate() const
+	{
+		return (m_queries > 0 ? btScalar(m_queries - m_misses) / btScalar(m_queries) : btScalar(0));
+	}
+
+	void ResetCounters()
+	{
+		m_queries = 0;
+		m_misses = 0;
+		m_evictions = 0;
+	}
+
+	// Frees the cells, the budgets of the shapes are kept
 	void Reset()
 	{
 		for (int i = 0, ni = cells.size(); i < ni; ++i)
@@ -126,71 +196,105 @@ struct btSparseSdf
 				pc = pn;
 			}
 		}
+		FreeRetired();
+		for (int i = 0; i < m_shapes.size(); ++i)
+		{
+			m_shapes[i].ncells = 0;
+			m_shapes[i].isStatic = false;
+			m_shapes[i].lruHead = 0;
+			m_shapes[i].lruTail = 0;
+		}
 		voxelsz = m_defaultVoxelsz;
 		puid = 0;
 		ncells = 0;
-		nprobes = 1;
-		nqueries = 1;
+	}
+	// Called before the collisions of a step, when no thread is in Evaluate
+	void BeginStep()
+	{
+		FreeRetired();
+		++puid;
 	}
 	//
 	void GarbageCollect(int lifetime = 256)
 	{
 		const int life = puid - lifetime;
-		for (int i = 0; i < cells.size(); ++i)
+		for (int i = 0; i < m_shapes.size(); ++i)
 		{
-			Cell*& root = cells[i];
-			Cell* pp = 0;
-			Cell* pc = root;
+			ShapeCache& sc = m_shapes[i];
+			if (sc.isStatic) continue;
+			Cell* pc = sc.lruHead;
 			while (pc)
 			{
-				Cell* pn = pc->next;
+				Cell* pn = pc->lruNext;
 				if (pc->puid < life)
 				{
-					if (pp)
-						pp->next = pn;
-					else
-						root = pn;
-					delete pc;
-					pc = pp;
-					--ncells;
+					Retire(sc, pc);
 				}
-				pp = pc;
 				pc = pn;
 			}
 		}
-		//printf("GC[%d]: %d cells, PpQ: %f\r\n",puid,ncells,nprobes/(btScalar)nqueries);
-		nqueries = 1;
-		nprobes = 1;
-		++puid;  ///@todo: Reset puid's when int range limit is reached	*/
-		/* else setup a priority list...						*/
+		BeginStep();  ///@todo: Reset puid's when int range limit is reached	*/
 	}
 	//
 	int RemoveReferences(btCollisionShape* pcs)
 	{
 		int refcount = 0;
-		for (int i = 0; i < cells.size(); ++i)
+		btMutexLock(&m_mutex);
+		const int* index = m_shapeIndices.find(btHashPtr(pcs));
+		if (index)
 		{
-			Cell*& root = cells[i];
-			Cell* pp = 0;
-			Cell* pc = root;
-			while (pc)
+			ShapeCache& sc = m_shapes[*index];
+			while (sc.lruHead)
 			{
-				Cell* pn = pc->next;
-				if (pc->pclient == pcs)
+				Retire(sc, sc.lruHead);
+				++refcount;
+			}
+		}
+		btMutexUnlock(&m_mutex);
+		return (refcount);
+	}
+	// Builds the cells of shape between mins and maxs, in shape space, they are never evicted.
+	// The cells are built in parallel when there is a task scheduler, returns the number of new cells
+	int Precompute(const btCollisionShape* shape, const btVector3& mins, const btVector3& maxs)
+	{
+		const IntFrac lo[] = {Decompose(mins.x() / voxelsz), Decompose(mins.y() / voxelsz), Decompose(mins.z() / voxelsz)};
+		const IntFrac hi[] = {Decompose(maxs.x() / voxelsz), Decompose(maxs.y() / voxelsz), Decompose(maxs.z() / voxelsz)};
+		btAlignedObjectArray<Cell*> built;
+		for (int z = lo[2].b; z <= hi[2].b; ++z)
+		{
+			for (int y = lo[1].b; y <= hi[1].b; ++y)
+			{
+				for (int x = lo[0].b; x <= hi[0].b; ++x)
 				{
-					if (pp)
-						pp->next = pn;
-					else
-						root = pn;
-					delete pc;
-					pc = pp;
-					++refcount;
+					if (!Find(x, y, z, shape, Hash(x, y, z, shape)))
+						built.push_back(NewCell(x, y, z, shape));
 				}
-				pp = pc;
-				pc = pn;
 			}
 		}
-		return (refcount);
+		struct CellBuilder : public btIParallelForBody
+		{
+			btSparseSdf* sdf;
+			Cell** cells;
+			void forLoop(int iBegin, int iEnd) const BT_OVERRIDE
+			{
+				for (int i = iBegin; i < iEnd; ++i) sdf->BuildCell(*cells[i]);
+			}
+		} builder;
+		builder.sdf = this;
+		builder.cells = built.size() ? &built[0] : 0;
+		if (btGetTaskScheduler())
+			btParallelFor(0, built.size(), 16, builder);
+		else
+			builder.forLoop(0, built.size());
+		btMutexLock(&m_mutex);
+		ShapeCache& sc = GetShapeCache(shape);
+		sc.isStatic = true;
+		for (int i = 0; i < built.size(); ++i)
+		{
+			Insert(sc, built[i]);
+		}
+		btMutexUnlock(&m_mutex);
+		return (built.size());
 	}
 	//
 	btScalar Evaluate(const btVector3& x,
@@ -204,52 +308,46 @@ struct btSparseSdf
 		const IntFrac iy = Decompose(scx.y());
 		const IntFrac iz = Decompose(scx.z());
 		const unsigned h = Hash(ix.b, iy.b, iz.b, shape);
-		Cell*& root = cells[static_cast<int>(h % cells.size())];
-		Cell* c = root;
-		++nqueries;
-		while (c)
+		AtomicAdd(m_queries);
+		Cell* c = Find(ix.b, iy.b, iz.b, shape, h);
+		if (!c)
 		{
-			++nprobes;
-			if ((c->hash == h) &&
-				(c->c[0] == ix.b) &&
-				(c->c[1] == iy.b) &&
-				(c->c[2] == iz.b) &&
-				(c->pclient == shape))
+			/* Build the cell outside of the lock, several threads can build cells at once	*/
+			AtomicAdd(m_misses);
+			Cell* nc = NewCell(ix.b, iy.b, iz.b, shape);
+			BuildCell(*nc);
+			btMutexLock(&m_mutex);
+			/* Another thread may have inserted the same cell meanwhile	*/
+			c = Find(ix.b, iy.b, iz.b, shape, h);
+			if (c)
 			{
-				break;
+				delete nc;
 			}
 			else
 			{
-				// printf("c->hash/c[0][1][2]=%d,%d,%d,%d\n", c->hash, c->c[0], c->c[1],c->c[2]);
-				//printf("h,ixb,iyb,izb=%d,%d,%d,%d\n", h,ix.b, iy.b, iz.b);
-
-				c = c->next;
-			}
-		}
-		if (!c)
-		{
-			++nprobes;
-			++ncells;
-			//int sz = sizeof(Cell);
-			if (ncells > m_clampCells)
-			{
-				//static int numResets = 0;
-				//numResets++;
-				//printf("numResets=%d\n",numResets);
-				Reset();
+				ShapeCache& sc = GetShapeCache(shape);
+				const int budget = sc.budget > 0 ? sc.budget : m_defaultBudget;
+				if (!sc.isStatic)
+				{
+					while (budget > 0 && sc.ncells >= budget && sc.lruHead) Evict(sc);
+				}
+				if (ncells >= m_clampCells)
+				{
+					ShapeCache* largest = 0;
+					for (int i = 0; i < m_shapes.size(); ++i)
+					{
+						if (!m_shapes[i].isStatic && m_shapes[i].lruHead && (!largest || m_shapes[i].ncells > largest->ncells))
+							largest = &m_shapes[i];
+					}
+					if (largest) Evict(*largest);
+				}
+				Insert(sc, nc);
+				c = nc;
 			}
-
-			c = new Cell();
-			c->next = root;
-			root = c;
-			c->pclient = shape;
-			c->hash = h;
-			c->c[0] = ix.b;
-			c->c[1] = iy.b;
-			c->c[2] = iz.b;
-			BuildCell(*c);
+			btMutexUnlock(&m_mutex);
 		}
-		c->puid = puid;
+		/* Relaxed store, the readers of the same cell write the same value	*/
+		if (AtomicLoad(c->puid) != puid) AtomicStore(c->puid, puid);
 		/* Extract infos		*/
 		const int o[] = {ix.i, iy.i, iz.i};
 		const btScalar d[] = {c->d[o[0] + 0][o[1] + 0][o[2] + 0],
@@ -285,6 +383,140 @@ struct btSparseSdf
 								 Lerp(d[7], d[6], ix.f), iy.f);
 		return (Lerp(d0, d1, iz.f) - margin);
 	}
+	// Lock free lookup, the cells are inserted at the head of the buckets with a release store
+	Cell* Find(int x, int y, int z, const btCollisionShape* shape, unsigned h) const
+	{
+		Cell* c = AtomicLoad(cells[static_cast<int>(h % cells.size())]);
+		while (c)
+		{
+			if ((c->hash == h) &&
+				(c->c[0] == x) &&
+				(c->c[1] == y) &&
+				(c->c[2] == z) &&
+				(c->pclient == shape))
+			{
+				break;
+			}
+			c = AtomicLoad(c->next);
+		}
+		return (c);
+	}
+	//
+	Cell* NewCell(int x, int y, int z, const btCollisionShape* shape) const
+	{
+		Cell* c = new Cell();
+		c->pclient = shape;
+		c->hash = Hash(x, y, z, shape);
+		c->c[0] = x;
+		c->c[1] = y;
+		c->c[2] = z;
+		c->puid = puid;
+		return (c);
+	}
+	// Under the lock
+	ShapeCache& GetShapeCache(const btCollisionShape* shape)
+	{
+		const int* index = m_shapeIndices.find(btHashPtr(shape));
+		if (index) return (m_shapes[*index]);
+		m_shapeIndices.insert(btHashPtr(shape), m_shapes.size());
+		ShapeCache& sc = m_shapes.expandNonInitializing();
+		sc.shape = shape;
+		sc.ncells = 0;
+		sc.budget = 0;
+		sc.isStatic = false;
+		sc.evictions = 0;
+		sc.lruHead = 0;
+		sc.lruTail = 0;
+		return (sc);
+	}
+	// Under the lock, c is built and published to the readers
+	void Insert(ShapeCache& sc, Cell* c)
+	{
+		Cell*& root = cells[static_cast<int>(c->hash % cells.size())];
+		c->next = root;
+		AtomicStore(root, c);
+		c->lruPrev = sc.lruTail;
+		c->lruNext = 0;
+		if (sc.lruTail)
+			sc.lruTail->lruNext = c;
+		else
+			sc.lruHead = c;
+		sc.lruTail = c;
+		++sc.ncells;
+		++ncells;
+	}
+	// Under the lock, evicts the least recently used cell of sc, the cells used in this step are moved to
+	// the tail once and marked as older, so a step that uses more cells than the budget still evicts
+	void Evict(ShapeCache& sc)
+	{
+		while (sc.lruHead != sc.lruTail && AtomicLoad(sc.lruHead->puid) == puid)
+		{
+			Cell* c = sc.lruHead;
+			AtomicStore(c->puid, puid - 1);
+			sc.lruHead = c->lruNext;
+			sc.lruHead->lruPrev = 0;
+			c->lruPrev = sc.lruTail;
+			c->lruNext = 0;
+			sc.lruTail->lruNext = c;
+			sc.lruTail = c;
+		}
+		Retire(sc, sc.lruHead);
+		++sc.evictions;
+		++m_evictions;
+	}
+	// Under the lock or without readers, c leaves its bucket but stays readable until FreeRetired
+	void Retire(ShapeCache& sc, Cell* c)
+	{
+		Cell** pp = &cells[static_cast<int>(c->hash % cells.size())];
+		while (*pp != c) pp = &(*pp)->next;
+		/* The readers going through c still find the rest of the bucket	*/
+		AtomicStore(*pp, c->next);
+		if (c->lruPrev)
+			c->lruPrev->lruNext = c->lruNext;
+		else
+			sc.lruHead = c->lruNext;
+		if (c->lruNext)
+			c->lruNext->lruPrev = c->lruPrev;
+		else
+			sc.lruTail = c->lruPrev;
+		c->lruNext = m_retired;
+		m_retired = c;
+		++m_nretired;
+		--sc.ncells;
+		--ncells;
+	}
+	//
+	void FreeRetired()
+	{
+		while (m_retired)
+		{
+			Cell* pn = m_retired->lruNext;
+			delete m_retired;
+			m_retired = pn;
+		}
+		m_nretired = 0;
+	}
+	// The cells and the counters are shared by the threads of the collisions
+	static inline Cell* AtomicLoad(Cell* const& p)
+	{
+		return (reinterpret_cast<const std::atomic<Cell*>&>(p).load(std::memory_order_acquire));
+	}
+	static inline void AtomicStore(Cell*& p, Cell* c)
+	{
+		reinterpret_cast<std::atomic<Cell*>&>(p).store(c, std::memory_order_release);
+	}
+	static inline int AtomicLoad(const int& i)
+	{
+		return (reinterpret_cast<const std::atomic<int>&>(i).load(std::memory_order_relaxed));
+	}
+	static inline void AtomicStore(int& i, int v)
+	{
+		reinterpret_cast<std::atomic<int>&>(i).store(v, std::memory_order_relaxed);
+	}
+	static inline void AtomicAdd(long long& i)
+	{
+		reinterpret_cast<std::atomic<long long>&>(i).fetch_add(1, std::memory_order_relaxed);
+	}
 	//
 	void BuildCell(Cell& c)
 	{
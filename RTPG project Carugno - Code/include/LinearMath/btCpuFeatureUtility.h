@@ -19,7 +19,7 @@
 #include <sys/sysctl.h>  //for sysctlbyname
 #endif                   //BT_USE_NEON
 
-///Rudimentary btCpuFeatureUtility for CPU features: only report the features that Bullet actually uses (SSE4/FMA3, NEON_HPFP)
+///Rudimentary btCpuFeatureUtility for CPU features: only report the features that Bullet actually uses (SSE4/FMA3, AVX, NEON_HPFP)
 ///We assume SSE2 in case BT_USE_SSE2 is defined in LinearMath/btScalar.h
 class btCpuFeatureUtility
 {
@@ -28,7 +28,8 @@ public:
 	{
 		CPU_FEATURE_FMA3 = 1,
 		CPU_FEATURE_SSE4_1 = 2,
-		CPU_FEATURE_NEON_HPFP = 4
+		CPU_FEATURE_NEON_HPFP = 4,
+		CPU_FEATURE_AVX = 8
 	};
 
 	static int getCpuFeatures()
@@ -71,6 +72,10 @@ public:
 			{
 				capabilities |= btCpuFeatureUtility::CPU_FEATURE_FMA3;
 			}
+			if ((cpuInfo[2] & AVXFlag) == AVXFlag && (sseExt & 6) == 6)
+			{
+				capabilities |= btCpuFeatureUtility::CPU_FEATURE_AVX;
+			}
 
 			const int SSE41Flag = (1 << 19);
 			if (cpuInfo[2] & SSE41Flag)
@@ -78,6 +83,21 @@ public:
 				capabilities |= btCpuFeatureUtility::CPU_FEATURE_SSE4_1;
 			}
 		}
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+		{
+			//the builtins also check that the OS saves the AVX registers
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx"))
+			{
+				capabilities |= btCpuFeatureUtility::CPU_FEATURE_AVX;
+				if (__builtin_cpu_supports("fma"))
+					capabilities |= btCpuFeatureUtility::CPU_FEATURE_FMA3;
+			}
+			if (__builtin_cpu_supports("sse4.1"))
+			{
+				capabilities |= btCpuFeatureUtility::CPU_FEATURE_SSE4_1;
+			}
+		}
 #endif  //BT_ALLOW_SSE4
 
 		testedCapabilities = true;
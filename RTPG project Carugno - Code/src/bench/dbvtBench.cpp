@@ -0,0 +1,325 @@
+//Bounding volume tree microbenchmark
+//Times the tree-tree, tree-volume and ray-tree queries of btDbvt, btDbvtLinear and btDbvtWide on random trees
+//
+//Usage: dbvtBench [--leaves N] [--queries N] [--repeats N] [--size S] [--seed N] [--format json|csv] [--output FILE]
+//
+//Build on Linux from the project folder:
+//g++ -std=c++14 -O2 -Iinclude -o dbvtBench src/bench/dbvtBench.cpp include/btLinearMathAll.cpp include/btBulletCollisionAll.cpp -lpthread
+//The report goes to stdout (or --output), each query of each tree reports the same leaves or it is marked as a mismatch
+//The wide tree is timed with each 4x4 kernel compiled in and supported by the CPU (generic, sse, avx)
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "btBulletCollisionCommon.h"
+#include "BulletCollision/BroadphaseCollision/btDbvt.h"
+#include "LinearMath/btCpuFeatureUtility.h"
+
+using namespace std;
+
+/////////////////////////////////////////////////////////
+//Benchmark settings
+
+struct BenchSettings
+{
+    int leaves = 8192;
+    int queries = 10000;
+    int repeats = 20;
+    //Half extent of the leaves, the trees fill a 100 units cube
+    float size = 1.0f;
+    unsigned seed = 1;
+    string format = "json";
+    string output;
+};
+
+//Time of one query kind on one tree
+struct QueryResult
+{
+    string query;
+    string tree;
+    double microseconds = 0.0;
+    long long results = 0;
+    bool match = true;
+};
+
+//Counts the reported leaves, the hash does not depend on their order
+struct CountPolicy : btDbvt::ICollide
+{
+    long long count = 0;
+    unsigned long long hash = 0;
+
+    void Process(const btDbvtNode* leaf)
+    {
+        count++;
+        hash += (unsigned long long)(size_t)leaf->data;
+    }
+    void Process(const btDbvtNode* leaf0, const btDbvtNode* leaf1)
+    {
+        count++;
+        hash += (unsigned long long)(size_t)leaf0->data * 100003u + (size_t)leaf1->data;
+    }
+};
+
+/////////////////////////////////////////////////////////
+//Functions declarations
+
+bool parseArguments(int argc, char** argv, BenchSettings& settings);
+float randUnit();
+btVector3 randPoint();
+void randTree(const BenchSettings& settings, btDbvt& tree);
+void addResult(vector<QueryResult>& results, const string& query, const string& tree, double microseconds, const CountPolicy& policy);
+void writeJson(ostream& out, const BenchSettings& settings, const vector<QueryResult>& results);
+void writeCsv(ostream& out, const vector<QueryResult>& results);
+
+typedef chrono::high_resolution_clock Clock;
+
+//Microseconds since start
+double elapsed(Clock::time_point start)
+{
+    return chrono::duration<double, micro>(Clock::now() - start).count();
+}
+
+//Main function
+int main(int argc, char** argv)
+{
+    BenchSettings settings;
+    if (!parseArguments(argc, argv, settings))
+        return 1;
+
+    srand(settings.seed);
+    btDbvt tree0, tree1;
+    randTree(settings, tree0);
+    randTree(settings, tree1);
+    tree0.optimizeTopDown();
+    tree1.optimizeTopDown();
+
+    btDbvtLinear linear0, linear1;
+    linear0.build(tree0);
+    linear1.build(tree1);
+    btDbvtWide wide0, wide1;
+    wide0.build(tree0);
+    wide1.build(tree1);
+
+    const char* kernelNames[] = {"generic", "sse", "avx"};
+    vector<QueryResult> results;
+
+    //Tree-tree: all the overlapping pairs of leaves of the two trees
+    {
+        CountPolicy reference;
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < settings.repeats; i++)
+            tree0.collideTT(tree0.m_root, tree1.m_root, reference);
+        addResult(results, "tree-tree", "binary", elapsed(start) / settings.repeats, reference);
+
+        CountPolicy policy;
+        start = Clock::now();
+        for (int i = 0; i < settings.repeats; i++)
+            linear0.collideTT(linear1, policy);
+        addResult(results, "tree-tree", "linear", elapsed(start) / settings.repeats, policy);
+        results.back().match = policy.count == reference.count && policy.hash == reference.hash;
+
+        for (int kernel = btDbvtWide::KERNEL_GENERIC; kernel <= btDbvtWide::KERNEL_AVX; kernel++)
+        {
+            wide0.m_overlap4x4 = btDbvtWide::getOverlap4x4((btDbvtWide::eKernel)kernel);
+            if (!wide0.m_overlap4x4)
+                continue;
+            policy = CountPolicy();
+            start = Clock::now();
+            for (int i = 0; i < settings.repeats; i++)
+                wide0.collideTT(wide1, policy);
+            addResult(results, "tree-tree", string("wide-") + kernelNames[kernel], elapsed(start) / settings.repeats, policy);
+            results.back().match = policy.count == reference.count && policy.hash == reference.hash;
+        }
+        wide0.m_overlap4x4 = btDbvtWide::getOverlap4x4(btDbvtWide::KERNEL_BEST);
+    }
+
+    //Tree-volume: boxes a few times larger than the leaves
+    {
+        vector<btDbvtVolume> volumes;
+        for (int i = 0; i < settings.queries; i++)
+            volumes.push_back(btDbvtVolume::FromCR(randPoint(), settings.size * (1.0f + 4.0f * randUnit())));
+
+        CountPolicy reference, linearPolicy, widePolicy;
+        Clock::time_point start = Clock::now();
+        for (const btDbvtVolume& volume : volumes)
+            tree0.collideTV(tree0.m_root, volume, reference);
+        addResult(results, "tree-volume", "binary", elapsed(start) / settings.queries, reference);
+
+        start = Clock::now();
+        for (const btDbvtVolume& volume : volumes)
+            linear0.collideTV(volume, linearPolicy);
+        addResult(results, "tree-volume", "linear", elapsed(start) / settings.queries, linearPolicy);
+        results.back().match = linearPolicy.count == reference.count && linearPolicy.hash == reference.hash;
+
+        start = Clock::now();
+        for (const btDbvtVolume& volume : volumes)
+            wide0.collideTV(volume, widePolicy);
+        addResult(results, "tree-volume", "wide", elapsed(start) / settings.queries, widePolicy);
+        results.back().match = widePolicy.count == reference.count && widePolicy.hash == reference.hash;
+    }
+
+    //Ray-tree: rays across the cube between two random points
+    {
+        vector<btVector3> rays;
+        for (int i = 0; i < settings.queries; i++)
+        {
+            rays.push_back(randPoint());
+            rays.push_back(randPoint());
+        }
+
+        CountPolicy reference, linearPolicy, widePolicy;
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < settings.queries; i++)
+            btDbvt::rayTest(tree0.m_root, rays[i * 2], rays[i * 2 + 1], reference);
+        addResult(results, "ray-tree", "binary", elapsed(start) / settings.queries, reference);
+
+        start = Clock::now();
+        for (int i = 0; i < settings.queries; i++)
+            linear0.rayTest(rays[i * 2], rays[i * 2 + 1], linearPolicy);
+        addResult(results, "ray-tree", "linear", elapsed(start) / settings.queries, linearPolicy);
+        results.back().match = linearPolicy.count == reference.count && linearPolicy.hash == reference.hash;
+
+        start = Clock::now();
+        for (int i = 0; i < settings.queries; i++)
+            wide0.rayTest(rays[i * 2], rays[i * 2 + 1], widePolicy);
+        addResult(results, "ray-tree", "wide", elapsed(start) / settings.queries, widePolicy);
+        results.back().match = widePolicy.count == reference.count && widePolicy.hash == reference.hash;
+    }
+
+    ofstream file;
+    if (!settings.output.empty())
+    {
+        file.open(settings.output);
+        if (!file)
+        {
+            cerr << "ERROR::BENCH::could not write " << settings.output << endl;
+            return 1;
+        }
+    }
+    ostream& out = settings.output.empty() ? cout : file;
+
+    if (settings.format == "csv")
+        writeCsv(out, results);
+    else
+        writeJson(out, settings, results);
+
+    for (const QueryResult& result : results)
+    {
+        if (!result.match)
+            return 2;
+    }
+    return 0;
+}
+
+/////////////////////////////////////////////////////////
+//Functions definitions
+
+bool parseArguments(int argc, char** argv, BenchSettings& settings)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        string argument = argv[i];
+        if (i + 1 >= argc)
+        {
+            cerr << "ERROR::BENCH::missing value for " << argument << endl;
+            return false;
+        }
+        string value = argv[++i];
+
+        if (argument == "--leaves")
+            settings.leaves = atoi(value.c_str());
+        else if (argument == "--queries")
+            settings.queries = atoi(value.c_str());
+        else if (argument == "--repeats")
+            settings.repeats = atoi(value.c_str());
+        else if (argument == "--size")
+            settings.size = (float)atof(value.c_str());
+        else if (argument == "--seed")
+            settings.seed = (unsigned)atoi(value.c_str());
+        else if (argument == "--format")
+            settings.format = value;
+        else if (argument == "--output")
+            settings.output = value;
+        else
+        {
+            cerr << "ERROR::BENCH::unknown argument " << argument << endl;
+            return false;
+        }
+    }
+
+    if (settings.leaves < 1 || settings.queries < 1 || settings.repeats < 1 || settings.size <= 0.0f)
+    {
+        cerr << "ERROR::BENCH::leaves, queries, repeats and size must be positive" << endl;
+        return false;
+    }
+    if (settings.format != "json" && settings.format != "csv")
+    {
+        cerr << "ERROR::BENCH::unknown format " << settings.format << endl;
+        return false;
+    }
+    return true;
+}
+
+float randUnit()
+{
+    return rand() / (float)RAND_MAX;
+}
+
+//Point in the 100 units cube of the trees
+btVector3 randPoint()
+{
+    return btVector3(randUnit(), randUnit(), randUnit()) * 100.0f;
+}
+
+//Leaves with half extents between 0.5 and 1.5 times settings.size, their data is their index
+void randTree(const BenchSettings& settings, btDbvt& tree)
+{
+    for (int i = 0; i < settings.leaves; i++)
+    {
+        btVector3 extents = btVector3(randUnit(), randUnit(), randUnit()) * settings.size + btVector3(1, 1, 1) * settings.size * 0.5f;
+        tree.insert(btDbvtVolume::FromCE(randPoint(), extents), (void*)(size_t)i);
+    }
+}
+
+void addResult(vector<QueryResult>& results, const string& query, const string& tree, double microseconds, const CountPolicy& policy)
+{
+    QueryResult result;
+    result.query = query;
+    result.tree = tree;
+    result.microseconds = microseconds;
+    result.results = policy.count;
+    results.push_back(result);
+}
+
+void writeJson(ostream& out, const BenchSettings& settings, const vector<QueryResult>& results)
+{
+    const int features = btCpuFeatureUtility::getCpuFeatures();
+    out << "{" << endl;
+    out << "  \"leaves\": " << settings.leaves << "," << endl;
+    out << "  \"queries\": " << settings.queries << "," << endl;
+    out << "  \"repeats\": " << settings.repeats << "," << endl;
+    out << "  \"size\": " << settings.size << "," << endl;
+    out << "  \"seed\": " << settings.seed << "," << endl;
+    out << "  \"avx\": " << ((features & btCpuFeatureUtility::CPU_FEATURE_AVX) ? "true" : "false") << "," << endl;
+    out << "  \"results\": [" << endl;
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const QueryResult& result = results[i];
+        out << "    {\"query\": \"" << result.query << "\", \"tree\": \"" << result.tree << "\", \"us\": " << result.microseconds
+            << ", \"results\": " << result.results << ", \"match\": " << (result.match ? "true" : "false") << "}"
+            << (i + 1 < results.size() ? "," : "") << endl;
+    }
+    out << "  ]" << endl;
+    out << "}" << endl;
+}
+
+void writeCsv(ostream& out, const vector<QueryResult>& results)
+{
+    out << "query,tree,us,results,match" << endl;
+    for (const QueryResult& result : results)
+        out << result.query << "," << result.tree << "," << result.microseconds << "," << result.results << "," << (result.match ? 1 : 0) << endl;
+}
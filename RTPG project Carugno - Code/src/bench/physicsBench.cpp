@@ -0,0 +1,904 @@
+//Headless physics benchmark
+//Drives PhysicsV2 with scripted scenes, no window and no OpenGL context are created
+//
+//Usage: physicsBench [--scene cubes|spheres|stack|bunny|bunny-stack|male|cylinder|mixed] [--count N] [--steps N]
+//                    [--warmup N] [--rate HZ] [--format json|csv] [--output FILE] [--models DIR]
+//                    [--layout soa|aos] [--link-batches 0|1] [--threads N] [--body-solver parallel|serial]
+//                    [--world parallel|serial] [--sleeping 0|1] [--fused-integrate 0|1]
+//                    [--tree-rebuild RATIO] [--broadphase-refit RATIO] [--linear-trees 0|1] [--wide-trees 0|1]
+//                    [--sdf-budget CELLS] [--sdf-precompute 0|1]
+//       physicsBench --load 1 [--models DIR] [--weld-epsilon E] [--format json|csv] [--output FILE]
+//       physicsBench --spawn 1 [--models DIR] [--count N] [--format json|csv] [--output FILE]
+//
+//With --load 1 no scene is simulated: every .obj file of the models folder is imported and welded without the
+//model cache, the import, the parallel weld and the serial reference weld are timed (best of LOAD_REPEATS runs)
+//and the parallel weld is checked against the serial one, with exact matching and with the weld epsilon
+//
+//With --spawn 1 no scene is simulated: N soft bodies and N rigid bodies of the cube, sphere and bunny models
+//are spawned, and the allocations (operator new and Bullet's btAlignedAlloc) and bytes of every spawn are counted.
+//The first spawn of a model also builds its template or shape, the next ones are reported as a mean
+//
+//Build on Linux from the project folder (Bullet is compiled from the sources in include):
+//g++ -std=c++14 -O2 -DBT_THREADSAFE=1 -Iinclude -o physicsBench src/bench/physicsBench.cpp "src/OpenGL loader file/glad.c"
+//    include/btLinearMathAll.cpp include/btBulletCollisionAll.cpp include/btBulletDynamicsAll.cpp
+//    include/BulletSoftBody/*.cpp include/BulletSoftBody/BulletReducedDeformableBody/*.cpp -lassimp -lpthread -ldl
+//The report goes to stdout (or --output), logs go to stderr
+//Scaling curves: run the same scene with --threads 1, 2, 4... and compare the step percentiles,
+//the task scheduler caps the threads to the cores of the machine (see "threads" in the report),
+//so the curves are only meaningful on a machine with at least as many cores as the largest --threads
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <dirent.h>
+#endif
+
+#include "../../utilsV2/ModelV2.h"
+#include "../../utilsV2/PhysicsV2.h"
+#include "../../utilsV2/PhysicsProfilerV2.h"
+
+/////////////////////////////////////////////////////////
+//Allocation counters
+
+//Every operator new of the program and, during the spawn benchmark, every Bullet allocation is counted
+//The counters are read around each spawn, no step runs on the task scheduler threads at that time
+static atomic<long long> allocationCount{ 0 };
+static atomic<long long> allocationBytes{ 0 };
+
+static void* countedAlloc(size_t size)
+{
+    allocationCount++;
+    allocationBytes += size;
+    return malloc(size);
+}
+
+void* operator new(size_t size)
+{
+    void* pointer = countedAlloc(size > 0 ? size : 1);
+    if (!pointer)
+        throw bad_alloc();
+    return pointer;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* pointer) noexcept
+{
+    free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    free(pointer);
+}
+
+/////////////////////////////////////////////////////////
+//Benchmark settings
+
+struct BenchSettings
+{
+    string scene = "spheres";
+    int count = 8;
+    int steps = 600;
+    int warmup = 60;
+    float rate = 60.0f;
+    string format = "json";
+    string output;
+    string models = "models";
+    //Node layout of the position solver and normals update, aos runs the original Bullet loops
+    string layout = "soa";
+    //Colored link batches, solved in parallel by the task scheduler threads
+    bool linkBatches = true;
+    //Task scheduler threads, 0 lets PhysicsV2 choose
+    int threads = 0;
+    //Soft bodies stepped in parallel (btDefaultSoftBodySolverMt) or one after the other
+    string bodySolver = "parallel";
+    //Multithreaded world (btSoftRigidDynamicsWorldMt) or the single threaded one
+    string world = "parallel";
+    //Soft bodies at rest are deactivated
+    bool sleeping = true;
+    //Nodes, bounds and tree leaves integrated in one pass, trees refit in bulk
+    bool fusedIntegrate = true;
+    //SAH cost growth that rebuilds the refit soft body trees, 0 never
+    float treeRebuildRatio = 1.5f;
+    //Broadphase tree refit once per step instead of updated per object, 0 disables it
+    float broadphaseRefitRatio = 0.0f;
+    //Soft body trees copied to flat arrays for the collisions
+    bool linearTrees = true;
+    //Soft body trees copied to 4-ary trees for the soft-soft collisions
+    bool wideTrees = true;
+    //Signed distance cells kept for each rigid shape, 0 no limit
+    int sdfBudget = 16384;
+    //Signed distance cells of the world plane built before the steps
+    bool sdfPrecompute = false;
+    //Time the loading of the models instead of simulating a scene
+    bool load = false;
+    //Tolerance of the second weld of the load benchmark
+    float weldEpsilon = 0.0001f;
+    //Count the allocations of spawning bodies instead of simulating a scene
+    bool spawn = false;
+};
+
+//Load times of one model file, in milliseconds
+struct LoadResult
+{
+    string file;
+    size_t meshes = 0;
+    size_t sourceVertices = 0;
+    size_t indices = 0;
+    double importMs = 0.0;
+    //Merged vertices, weld times and check against the serial weld, exact matching and with the epsilon
+    size_t vertices[2] = {};
+    double weldMs[2] = {};
+    double serialWeldMs[2] = {};
+    bool match[2] = { true, true };
+};
+
+//Allocations of spawning the bodies of one model
+struct SpawnResult
+{
+    string file;
+    string body;
+    //Merged vertices and indices of the model, the data a spawn copied before the templates
+    size_t modelBytes = 0;
+    int nodes = 0;
+    int links = 0;
+    int faces = 0;
+    //The first spawn also builds the template of the soft body or the shape of the rigid body
+    long long firstAllocations = 0;
+    long long firstBytes = 0;
+    //Mean of the next spawns
+    double allocations = 0.0;
+    double bytes = 0.0;
+};
+
+//Per step samples of a phase, in seconds
+struct PhaseSamples
+{
+    string name;
+    vector<double> samples;
+
+    double total() const
+    {
+        double sum = 0.0;
+        for (double sample : samples)
+            sum += sample;
+        return sum;
+    }
+
+    //Nearest rank percentile
+    double percentile(double p) const
+    {
+        if (samples.empty())
+            return 0.0;
+        vector<double> sorted = samples;
+        sort(sorted.begin(), sorted.end());
+        size_t rank = (size_t)ceil(p / 100.0 * sorted.size());
+        return sorted[rank > 0 ? rank - 1 : 0];
+    }
+};
+
+/////////////////////////////////////////////////////////
+//Functions declarations
+
+bool parseArguments(int argc, char** argv, BenchSettings& settings);
+int runLoadBenchmark(const BenchSettings& settings);
+int runSpawnBenchmark(const BenchSettings& settings);
+vector<string> listObjFiles(const string& folder);
+bool setupScene(const BenchSettings& settings, PhysicsV2& physics, vector<unique_ptr<ModelV2>>& models);
+void writeJson(ostream& out, const BenchSettings& settings, PhysicsV2& physics, const vector<PhaseSamples>& phases);
+void writeCsv(ostream& out, const BenchSettings& settings, const vector<PhaseSamples>& phases);
+
+//Main function
+int main(int argc, char** argv)
+{
+    BenchSettings settings;
+    if (!parseArguments(argc, argv, settings))
+        return 1;
+
+    if (settings.load)
+        return runLoadBenchmark(settings);
+    if (settings.spawn)
+        return runSpawnBenchmark(settings);
+
+    //Model loading logs go to stderr, stdout is left for the report
+    streambuf* coutBuffer = cout.rdbuf(cerr.rdbuf());
+
+    PhysicsV2 physics;
+    physics.numThreads = settings.threads;
+    physics.parallelSoftBodySolver = settings.bodySolver == "parallel";
+    physics.multithreadedWorld = settings.world == "parallel";
+    physics.softBodySleeping = settings.sleeping;
+    physics.broadphaseRefitRatio = settings.broadphaseRefitRatio;
+    physics.sdfShapeBudget = settings.sdfBudget;
+    physics.precomputePlaneSdf = settings.sdfPrecompute;
+    physics.setupPhysics();
+    physics.fixedTimeStep = 1.0f / settings.rate;
+    physics.useNodeSoA = settings.layout == "soa";
+    physics.batchLinks = settings.linkBatches;
+    physics.fusedIntegrate = settings.fusedIntegrate;
+    physics.treeRebuildRatio = settings.treeRebuildRatio;
+    physics.linearTrees = settings.linearTrees;
+    physics.wideTrees = settings.wideTrees;
+
+    //Models must outlive the soft bodies generated from them
+    vector<unique_ptr<ModelV2>> models;
+    if (!setupScene(settings, physics, models))
+    {
+        cout.rdbuf(coutBuffer);
+        physics.deletePhysics();
+        return 1;
+    }
+
+    //Warm up caches and let the bodies settle before measuring
+    for (int i = 0; i < settings.warmup; i++)
+        physics.world->stepSimulation(physics.fixedTimeStep, 0, physics.fixedTimeStep);
+
+    vector<PhaseSamples> phases(PhysicsProfilerV2::NUM_PHASES + 2);
+    for (int i = 0; i < PhysicsProfilerV2::NUM_PHASES; i++)
+        phases[i].name = PhysicsProfilerV2::getPhaseName(i);
+    phases[PhysicsProfilerV2::NUM_PHASES].name = "other";
+    phases[PhysicsProfilerV2::NUM_PHASES + 1].name = "step";
+    for (PhaseSamples& phase : phases)
+        phase.samples.reserve(settings.steps);
+
+    PhysicsProfilerV2 profiler;
+    profiler.install();
+    for (int i = 0; i < settings.steps; i++)
+    {
+        profiler.reset();
+        auto startTime = chrono::steady_clock::now();
+        physics.world->stepSimulation(physics.fixedTimeStep, 0, physics.fixedTimeStep);
+        double stepTime = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+        //Whatever is not in a phase (e.g. soft bodies optimize, actions, activation states)
+        double other = stepTime;
+        for (int j = 0; j < PhysicsProfilerV2::NUM_PHASES; j++)
+        {
+            phases[j].samples.push_back(profiler.getPhaseTime(j));
+            other -= profiler.getPhaseTime(j);
+        }
+        phases[PhysicsProfilerV2::NUM_PHASES].samples.push_back(max(other, 0.0));
+        phases[PhysicsProfilerV2::NUM_PHASES + 1].samples.push_back(stepTime);
+    }
+    profiler.uninstall();
+
+    cout.rdbuf(coutBuffer);
+
+    ofstream file;
+    if (!settings.output.empty())
+    {
+        file.open(settings.output);
+        if (!file)
+        {
+            cerr << "ERROR::BENCH::could not write " << settings.output << endl;
+            physics.deletePhysics();
+            return 1;
+        }
+    }
+    ostream& out = settings.output.empty() ? cout : file;
+
+    if (settings.format == "csv")
+        writeCsv(out, settings, phases);
+    else
+        writeJson(out, settings, physics, phases);
+
+    physics.deletePhysics();
+
+    return 0;
+}
+
+/////////////////////////////////////////////////////////
+//Functions definitions
+
+bool parseArguments(int argc, char** argv, BenchSettings& settings)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        string argument = argv[i];
+        if (i + 1 >= argc)
+        {
+            cerr << "ERROR::BENCH::missing value for " << argument << endl;
+            return false;
+        }
+        string value = argv[++i];
+
+        if (argument == "--scene")
+            settings.scene = value;
+        else if (argument == "--count")
+            settings.count = atoi(value.c_str());
+        else if (argument == "--steps")
+            settings.steps = atoi(value.c_str());
+        else if (argument == "--warmup")
+            settings.warmup = atoi(value.c_str());
+        else if (argument == "--rate")
+            settings.rate = (float)atof(value.c_str());
+        else if (argument == "--format")
+            settings.format = value;
+        else if (argument == "--output")
+            settings.output = value;
+        else if (argument == "--models")
+            settings.models = value;
+        else if (argument == "--layout")
+            settings.layout = value;
+        else if (argument == "--link-batches")
+            settings.linkBatches = atoi(value.c_str()) != 0;
+        else if (argument == "--threads")
+            settings.threads = atoi(value.c_str());
+        else if (argument == "--body-solver")
+            settings.bodySolver = value;
+        else if (argument == "--world")
+            settings.world = value;
+        else if (argument == "--sleeping")
+            settings.sleeping = atoi(value.c_str()) != 0;
+        else if (argument == "--fused-integrate")
+            settings.fusedIntegrate = atoi(value.c_str()) != 0;
+        else if (argument == "--tree-rebuild")
+            settings.treeRebuildRatio = (float)atof(value.c_str());
+        else if (argument == "--broadphase-refit")
+            settings.broadphaseRefitRatio = (float)atof(value.c_str());
+        else if (argument == "--linear-trees")
+            settings.linearTrees = atoi(value.c_str()) != 0;
+        else if (argument == "--wide-trees")
+            settings.wideTrees = atoi(value.c_str()) != 0;
+        else if (argument == "--sdf-budget")
+            settings.sdfBudget = atoi(value.c_str());
+        else if (argument == "--sdf-precompute")
+            settings.sdfPrecompute = atoi(value.c_str()) != 0;
+        else if (argument == "--load")
+            settings.load = atoi(value.c_str()) != 0;
+        else if (argument == "--weld-epsilon")
+            settings.weldEpsilon = (float)atof(value.c_str());
+        else if (argument == "--spawn")
+            settings.spawn = atoi(value.c_str()) != 0;
+        else
+        {
+            cerr << "ERROR::BENCH::unknown argument " << argument << endl;
+            return false;
+        }
+    }
+
+    if (settings.count < 1 || settings.steps < 1 || settings.warmup < 0 || settings.rate <= 0.0f || settings.threads < 0 ||
+        settings.treeRebuildRatio < 0.0f || settings.broadphaseRefitRatio < 0.0f || settings.sdfBudget < 0 ||
+        settings.weldEpsilon < 0.0f)
+    {
+        cerr << "ERROR::BENCH::count, steps and rate must be positive, ratios and budgets must not be negative" << endl;
+        return false;
+    }
+    if (settings.format != "json" && settings.format != "csv")
+    {
+        cerr << "ERROR::BENCH::unknown format " << settings.format << endl;
+        return false;
+    }
+    if (settings.layout != "soa" && settings.layout != "aos")
+    {
+        cerr << "ERROR::BENCH::unknown layout " << settings.layout << endl;
+        return false;
+    }
+    if (settings.bodySolver != "parallel" && settings.bodySolver != "serial")
+    {
+        cerr << "ERROR::BENCH::unknown body solver " << settings.bodySolver << endl;
+        return false;
+    }
+    if (settings.world != "parallel" && settings.world != "serial")
+    {
+        cerr << "ERROR::BENCH::unknown world " << settings.world << endl;
+        return false;
+    }
+    return true;
+}
+
+//Generate the soft bodies of the scene on the world plane
+//The mixed scene drops a pile of rigid cubes on each soft sphere
+//Positions only depend on the settings so every run simulates the same scene
+bool setupScene(const BenchSettings& settings, PhysicsV2& physics, vector<unique_ptr<ModelV2>>& models)
+{
+    string file;
+    bool stacked = false;
+    bool mixed = false;
+    if (settings.scene == "cubes")
+        file = "cube.obj";
+    else if (settings.scene == "spheres")
+        file = "sphere.obj";
+    else if (settings.scene == "stack")
+    {
+        file = "sphere.obj";
+        stacked = true;
+    }
+    else if (settings.scene == "bunny")
+        file = "bunny_lp.obj";
+    else if (settings.scene == "bunny-stack")
+    {
+        file = "bunny_lp.obj";
+        stacked = true;
+    }
+    else if (settings.scene == "male")
+        file = "MaleBaseMesh.obj";
+    else if (settings.scene == "cylinder")
+        file = "hollowCylinder.obj";
+    else if (settings.scene == "mixed")
+    {
+        file = "sphere.obj";
+        mixed = true;
+    }
+    else
+    {
+        cerr << "ERROR::BENCH::unknown scene " << settings.scene << endl;
+        return false;
+    }
+
+    physics.genWorldPlane(glm::vec3(50.0f, 0.1f, 50.0f), 0.0f);
+
+    //Only the collision geometry is needed, no GPU buffers
+    models.emplace_back(new ModelV2(settings.models + "/" + file, 0.0f, false));
+    const ModelV2& model = *models.back();
+    if (model.vertices.empty())
+    {
+        cerr << "ERROR::BENCH::could not load " << settings.models << "/" << file << endl;
+        return false;
+    }
+
+    //Bodies are spaced by the model size so they do not overlap when generated
+    btVector3 minimum = model.vertices[0];
+    btVector3 maximum = model.vertices[0];
+    for (const btVector3& vertex : model.vertices)
+    {
+        minimum.setMin(vertex);
+        maximum.setMax(vertex);
+    }
+    btVector3 extent = maximum - minimum;
+    float spacing = 1.25f * max(extent.x(), extent.z());
+    float height = 1.25f * extent.y();
+
+    int side = (int)ceil(sqrt((double)settings.count));
+    for (int i = 0; i < settings.count; i++)
+    {
+        float position[3] = { 0.0f, 3.0f - minimum.y(), 0.0f };
+        if (stacked)
+        {
+            position[1] += i * height;
+        }
+        else
+        {
+            position[0] = (i % side - (side - 1) * 0.5f) * spacing;
+            position[2] = (i / side - (side - 1) * 0.5f) * spacing;
+        }
+        float rotation[3] = { 0.0f, 0.0f, 0.0f };
+        float scale[3] = { 1.0f, 1.0f, 1.0f };
+        physics.generateSoftBodyTest(model, position, rotation, scale, 100.0f, 100.0f);
+    }
+
+    if (mixed)
+    {
+        models.emplace_back(new ModelV2(settings.models + "/cube.obj", 0.0f, false));
+        const ModelV2& cube = *models.back();
+        if (cube.vertices.empty())
+        {
+            cerr << "ERROR::BENCH::could not load " << settings.models << "/cube.obj" << endl;
+            return false;
+        }
+        btVector3 cubeMinimum = cube.vertices[0];
+        btVector3 cubeMaximum = cube.vertices[0];
+        for (const btVector3& vertex : cube.vertices)
+        {
+            cubeMinimum.setMin(vertex);
+            cubeMaximum.setMax(vertex);
+        }
+        float cubeHeight = 1.25f * (cubeMaximum.y() - cubeMinimum.y());
+
+        const int cubesPerPile = 4;
+        for (int i = 0; i < settings.count; i++)
+        {
+            for (int j = 0; j < cubesPerPile; j++)
+            {
+                float position[3] = {
+                    (i % side - (side - 1) * 0.5f) * spacing,
+                    3.0f - minimum.y() + height - cubeMinimum.y() + j * cubeHeight,
+                    (i / side - (side - 1) * 0.5f) * spacing
+                };
+                //Slightly turned so the piles topple
+                float rotation[3] = { 0.1f * j, 0.0f, 0.05f * j };
+                physics.generateRigidBody(cube, position, rotation, 1.0f);
+            }
+        }
+    }
+
+    return true;
+}
+
+void writeJson(ostream& out, const BenchSettings& settings, PhysicsV2& physics, const vector<PhaseSamples>& phases)
+{
+    //Size of the scene and a checksum of the final state to spot behaviour changes
+    //The strain of the links (mean of |length / rest length - 1|) compares the convergence of the solvers
+    long long nodes = 0, links = 0, faces = 0;
+    double checksum = 0.0;
+    double strain = 0.0;
+    long long strainedLinks = 0;
+    int sleepingSoftBodies = 0;
+    btSoftBodyArray& softBodies = physics.world->getSoftBodyArray();
+    btCollisionObjectArray& objects = physics.world->getCollisionObjectArray();
+    for (int i = 0; i < objects.size(); i++)
+    {
+        //Static bodies never move, leaving them out keeps the checksums of the soft scenes
+        btRigidBody* rigidBody = btRigidBody::upcast(objects[i]);
+        if (!rigidBody || rigidBody->isStaticObject())
+            continue;
+        const btVector3& x = rigidBody->getWorldTransform().getOrigin();
+        checksum += x.x() + x.y() + x.z();
+    }
+    for (int i = 0; i < softBodies.size(); i++)
+    {
+        nodes += softBodies[i]->m_nodes.size();
+        links += softBodies[i]->m_links.size();
+        faces += softBodies[i]->m_faces.size();
+        if (!softBodies[i]->isActive())
+            sleepingSoftBodies++;
+        for (int j = 0; j < softBodies[i]->m_nodes.size(); j++)
+        {
+            const btVector3& x = softBodies[i]->m_nodes[j].m_x;
+            checksum += x.x() + x.y() + x.z();
+        }
+        for (int j = 0; j < softBodies[i]->m_links.size(); j++)
+        {
+            const btSoftBody::Link& link = softBodies[i]->m_links[j];
+            if (link.m_rl <= 0)
+                continue;
+            strain += fabs((link.m_n[1]->m_x - link.m_n[0]->m_x).length() / link.m_rl - 1.0);
+            strainedLinks++;
+        }
+    }
+
+    out << setprecision(9);
+    out << "{" << endl;
+    out << "  \"scene\": \"" << settings.scene << "\"," << endl;
+    out << "  \"layout\": \"" << settings.layout << "\"," << endl;
+    out << "  \"linkBatches\": " << (settings.linkBatches ? "true" : "false") << "," << endl;
+    out << "  \"bodySolver\": \"" << settings.bodySolver << "\"," << endl;
+    out << "  \"world\": \"" << settings.world << "\"," << endl;
+    out << "  \"sleeping\": " << (settings.sleeping ? "true" : "false") << "," << endl;
+    out << "  \"fusedIntegrate\": " << (settings.fusedIntegrate ? "true" : "false") << "," << endl;
+    out << "  \"treeRebuildRatio\": " << settings.treeRebuildRatio << "," << endl;
+    out << "  \"broadphaseRefitRatio\": " << settings.broadphaseRefitRatio << "," << endl;
+    out << "  \"linearTrees\": " << (settings.linearTrees ? "true" : "false") << "," << endl;
+    out << "  \"wideTrees\": " << (settings.wideTrees ? "true" : "false") << "," << endl;
+    out << "  \"sdfBudget\": " << settings.sdfBudget << "," << endl;
+    out << "  \"sdfPrecompute\": " << (settings.sdfPrecompute ? "true" : "false") << "," << endl;
+    out << "  \"threads\": " << (physics.taskScheduler ? physics.taskScheduler->getNumThreads() : 1) << "," << endl;
+    out << "  \"softBodies\": " << softBodies.size() << "," << endl;
+    out << "  \"sleepingSoftBodies\": " << sleepingSoftBodies << "," << endl;
+    out << "  \"nodes\": " << nodes << "," << endl;
+    out << "  \"links\": " << links << "," << endl;
+    out << "  \"faces\": " << faces << "," << endl;
+    out << "  \"steps\": " << settings.steps << "," << endl;
+    out << "  \"warmup\": " << settings.warmup << "," << endl;
+    out << "  \"fixedTimeStep\": " << physics.fixedTimeStep << "," << endl;
+    out << "  \"checksum\": " << checksum << "," << endl;
+    out << "  \"linkStrain\": " << (strainedLinks > 0 ? strain / strainedLinks : 0.0) << "," << endl;
+    //Signed distance cache of the soft-rigid contacts over warmup and measured steps
+    const btSparseSdf<3>& sparseSdf = physics.world->getWorldInfo().m_sparsesdf;
+    out << "  \"sdf\": { \"cells\": " << sparseSdf.ncells << ", \"precomputed\": " << physics.stepStatistics.sdfPrecomputed
+        << ", \"queries\": " << sparseSdf.m_queries << ", \"hitRate\": " << sparseSdf.GetHitRate()
+        << ", \"evictions\": " << sparseSdf.m_evictions << " }," << endl;
+    out << "  \"phases\": {" << endl;
+    for (size_t i = 0; i < phases.size(); i++)
+    {
+        const PhaseSamples& phase = phases[i];
+        out << "    \"" << phase.name << "\": { "
+            << "\"total_ms\": " << phase.total() * 1000.0 << ", "
+            << "\"mean_ms\": " << phase.total() * 1000.0 / phase.samples.size() << ", "
+            << "\"p50_ms\": " << phase.percentile(50.0) * 1000.0 << ", "
+            << "\"p95_ms\": " << phase.percentile(95.0) * 1000.0 << ", "
+            << "\"max_ms\": " << phase.percentile(100.0) * 1000.0 << " }"
+            << (i + 1 < phases.size() ? "," : "") << endl;
+    }
+    out << "  }" << endl;
+    out << "}" << endl;
+}
+
+void writeCsv(ostream& out, const BenchSettings& settings, const vector<PhaseSamples>& phases)
+{
+    out << setprecision(9);
+    out << "scene,count,steps,phase,total_ms,mean_ms,p50_ms,p95_ms,max_ms" << endl;
+    for (const PhaseSamples& phase : phases)
+    {
+        out << settings.scene << "," << settings.count << "," << settings.steps << "," << phase.name << ","
+            << phase.total() * 1000.0 << ","
+            << phase.total() * 1000.0 / phase.samples.size() << ","
+            << phase.percentile(50.0) * 1000.0 << ","
+            << phase.percentile(95.0) * 1000.0 << ","
+            << phase.percentile(100.0) * 1000.0 << endl;
+    }
+}
+
+//Import and weld every .obj file of the models folder, 2 if a parallel weld differs from the serial one
+int runLoadBenchmark(const BenchSettings& settings)
+{
+    const int LOAD_REPEATS = 3;
+    vector<string> files = listObjFiles(settings.models);
+    if (files.empty())
+    {
+        cerr << "ERROR::BENCH::no .obj file in " << settings.models << endl;
+        return 1;
+    }
+
+    //Assimp errors go to stderr, stdout is left for the report
+    streambuf* coutBuffer = cout.rdbuf(cerr.rdbuf());
+    typedef chrono::steady_clock Clock;
+    auto milliseconds = [](Clock::time_point start) { return chrono::duration<double, milli>(Clock::now() - start).count(); };
+
+    vector<LoadResult> results;
+    for (const string& file : files)
+    {
+        LoadResult result;
+        result.file = file;
+        result.importMs = 1e30;
+
+        vector<MeshDataV2> meshes;
+        for (int i = 0; i < LOAD_REPEATS; i++)
+        {
+            meshes.clear();
+            Clock::time_point start = Clock::now();
+            ModelV2::importMeshes(settings.models + "/" + file, meshes);
+            result.importMs = min(result.importMs, milliseconds(start));
+        }
+        result.meshes = meshes.size();
+        for (const MeshDataV2& mesh : meshes)
+        {
+            result.sourceVertices += mesh.vertices.size();
+            result.indices += mesh.indices.size();
+        }
+
+        const float epsilons[2] = { 0.0f, settings.weldEpsilon };
+        for (int e = 0; e < 2; e++)
+        {
+            vector<btVector3> vertices, serialVertices;
+            vector<GLuint> indices, serialIndices;
+            result.weldMs[e] = result.serialWeldMs[e] = 1e30;
+            for (int i = 0; i < LOAD_REPEATS; i++)
+            {
+                Clock::time_point start = Clock::now();
+                ModelV2::weldMeshes(meshes, &vertices, &indices, epsilons[e]);
+                result.weldMs[e] = min(result.weldMs[e], milliseconds(start));
+
+                start = Clock::now();
+                ModelV2::weldMeshesSerial(meshes, &serialVertices, &serialIndices, epsilons[e]);
+                result.serialWeldMs[e] = min(result.serialWeldMs[e], milliseconds(start));
+            }
+            result.vertices[e] = vertices.size();
+            result.match[e] = vertices == serialVertices && indices == serialIndices;
+        }
+        results.push_back(result);
+    }
+
+    cout.rdbuf(coutBuffer);
+
+    ofstream outputFile;
+    if (!settings.output.empty())
+    {
+        outputFile.open(settings.output);
+        if (!outputFile)
+        {
+            cerr << "ERROR::BENCH::could not write " << settings.output << endl;
+            return 1;
+        }
+    }
+    ostream& out = settings.output.empty() ? cout : outputFile;
+
+    out << setprecision(9);
+    if (settings.format == "csv")
+    {
+        out << "file,meshes,sourceVertices,indices,importMs,vertices,weldMs,serialWeldMs,match,"
+            << "epsilonVertices,epsilonWeldMs,epsilonSerialWeldMs,epsilonMatch" << endl;
+        for (const LoadResult& result : results)
+        {
+            out << result.file << "," << result.meshes << "," << result.sourceVertices << "," << result.indices << "," << result.importMs;
+            for (int e = 0; e < 2; e++)
+                out << "," << result.vertices[e] << "," << result.weldMs[e] << "," << result.serialWeldMs[e] << "," << (result.match[e] ? 1 : 0);
+            out << endl;
+        }
+    }
+    else
+    {
+        out << "{" << endl;
+        out << "  \"models\": \"" << settings.models << "\"," << endl;
+        out << "  \"weldEpsilon\": " << settings.weldEpsilon << "," << endl;
+        out << "  \"repeats\": " << LOAD_REPEATS << "," << endl;
+        out << "  \"files\": [" << endl;
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const LoadResult& result = results[i];
+            out << "    {\"file\": \"" << result.file << "\", \"meshes\": " << result.meshes
+                << ", \"sourceVertices\": " << result.sourceVertices << ", \"indices\": " << result.indices
+                << ", \"importMs\": " << result.importMs
+                << ", \"vertices\": " << result.vertices[0] << ", \"weldMs\": " << result.weldMs[0]
+                << ", \"serialWeldMs\": " << result.serialWeldMs[0] << ", \"match\": " << (result.match[0] ? "true" : "false")
+                << ", \"epsilonVertices\": " << result.vertices[1] << ", \"epsilonWeldMs\": " << result.weldMs[1]
+                << ", \"epsilonSerialWeldMs\": " << result.serialWeldMs[1] << ", \"epsilonMatch\": " << (result.match[1] ? "true" : "false")
+                << "}" << (i + 1 < results.size() ? "," : "") << endl;
+        }
+        out << "  ]" << endl;
+        out << "}" << endl;
+    }
+
+    for (const LoadResult& result : results)
+    {
+        if (!result.match[0] || !result.match[1])
+            return 2;
+    }
+    return 0;
+}
+
+//Spawn count soft bodies and count rigid bodies of the cube, sphere and bunny models, counting the allocations of each spawn
+int runSpawnBenchmark(const BenchSettings& settings)
+{
+    const char* files[] = { "cube.obj", "sphere.obj", "bunny_lp.obj" };
+
+    //Model loading logs go to stderr, stdout is left for the report
+    streambuf* coutBuffer = cout.rdbuf(cerr.rdbuf());
+    btAlignedAllocSetCustom(countedAlloc, free);
+
+    vector<SpawnResult> results;
+    bool loaded = true;
+    for (const char* file : files)
+    {
+        //A new world for each model, so the arrays of the world grow in the same way for every model
+        PhysicsV2 physics;
+        physics.numThreads = settings.threads;
+        physics.setupPhysics();
+
+        ModelV2 model(settings.models + "/" + file, 0.0f, false);
+        if (model.vertices.empty())
+        {
+            cerr << "ERROR::BENCH::could not load " << settings.models << "/" << file << endl;
+            physics.deletePhysics();
+            loaded = false;
+            break;
+        }
+
+        for (int kind = 0; kind < 2; kind++)
+        {
+            SpawnResult result;
+            result.file = file;
+            result.body = kind == 0 ? "soft" : "rigid";
+            result.modelBytes = model.vertices.size() * sizeof(btVector3) + model.indices.size() * sizeof(GLuint);
+            for (int i = 0; i < settings.count; i++)
+            {
+                //Side by side, away from the other kind of bodies
+                float position[3] = { i * 4.0f, 3.0f, kind * 4.0f };
+                float rotation[3] = { 0.0f, 0.0f, 0.0f };
+                float scale[3] = { 1.0f, 1.0f, 1.0f };
+
+                long long count = allocationCount;
+                long long bytes = allocationBytes;
+                btSoftBody* softBody = 0;
+                if (kind == 0)
+                    softBody = physics.generateSoftBodyTest(model, position, rotation, scale, 100.0f, 100.0f);
+                else
+                    physics.generateRigidBody(model, position, rotation, 1.0f);
+                count = allocationCount - count;
+                bytes = allocationBytes - bytes;
+
+                if (i == 0)
+                {
+                    result.firstAllocations = count;
+                    result.firstBytes = bytes;
+                    if (softBody)
+                    {
+                        result.nodes = softBody->m_nodes.size();
+                        result.links = softBody->m_links.size();
+                        result.faces = softBody->m_faces.size();
+                    }
+                }
+                else
+                {
+                    result.allocations += count;
+                    result.bytes += bytes;
+                }
+            }
+            if (settings.count > 1)
+            {
+                result.allocations /= settings.count - 1;
+                result.bytes /= settings.count - 1;
+            }
+            results.push_back(result);
+        }
+
+        physics.deletePhysics();
+    }
+
+    btAlignedAllocSetCustom(0, 0);
+    cout.rdbuf(coutBuffer);
+    if (!loaded)
+        return 1;
+
+    ofstream outputFile;
+    if (!settings.output.empty())
+    {
+        outputFile.open(settings.output);
+        if (!outputFile)
+        {
+            cerr << "ERROR::BENCH::could not write " << settings.output << endl;
+            return 1;
+        }
+    }
+    ostream& out = settings.output.empty() ? cout : outputFile;
+
+    out << setprecision(9);
+    if (settings.format == "csv")
+    {
+        out << "file,body,modelBytes,nodes,links,faces,firstAllocations,firstBytes,allocations,bytes" << endl;
+        for (const SpawnResult& result : results)
+        {
+            out << result.file << "," << result.body << "," << result.modelBytes << "," << result.nodes << "," << result.links << ","
+                << result.faces << "," << result.firstAllocations << "," << result.firstBytes << "," << result.allocations << ","
+                << result.bytes << endl;
+        }
+    }
+    else
+    {
+        out << "{" << endl;
+        out << "  \"models\": \"" << settings.models << "\"," << endl;
+        out << "  \"spawns\": " << settings.count << "," << endl;
+        out << "  \"results\": [" << endl;
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const SpawnResult& result = results[i];
+            out << "    {\"file\": \"" << result.file << "\", \"body\": \"" << result.body << "\", \"modelBytes\": " << result.modelBytes
+                << ", \"nodes\": " << result.nodes << ", \"links\": " << result.links << ", \"faces\": " << result.faces
+                << ", \"firstAllocations\": " << result.firstAllocations << ", \"firstBytes\": " << result.firstBytes
+                << ", \"allocations\": " << result.allocations << ", \"bytes\": " << result.bytes
+                << "}" << (i + 1 < results.size() ? "," : "") << endl;
+        }
+        out << "  ]" << endl;
+        out << "}" << endl;
+    }
+
+    return 0;
+}
+
+//Names of the .obj files of a folder, sorted
+vector<string> listObjFiles(const string& folder)
+{
+    vector<string> files;
+    auto isObj = [](const string& name) { return name.size() > 4 && name.compare(name.size() - 4, 4, ".obj") == 0; };
+#ifdef _WIN32
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA((folder + "/*.obj").c_str(), &data);
+    if (find != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if (isObj(data.cFileName))
+                files.push_back(data.cFileName);
+        } while (FindNextFileA(find, &data));
+        FindClose(find);
+    }
+#else
+    DIR* dir = opendir(folder.c_str());
+    if (dir)
+    {
+        while (dirent* entry = readdir(dir))
+        {
+            if (isObj(entry->d_name))
+                files.push_back(entry->d_name);
+        }
+        closedir(dir);
+    }
+#endif
+    sort(files.begin(), files.end());
+    return files;
+}
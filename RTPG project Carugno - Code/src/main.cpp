@@ -5,8 +5,11 @@
 #include "ImGui/imgui_impl_opengl3.h"
 
 #include "../utilsV2/ModelV2.h"
+#include "../utilsV2/SoftBodyRendererV2.h"
+#include "../utilsV2/InstanceRendererV2.h"
 
 #include "../utilsV2/PhysicsV2.h"
+#include "../utilsV2/FrameProfilerV2.h"
 
 /////////////////////////////////////////////////////////
 //Functions declarations
@@ -14,12 +17,8 @@
 //Link functions to GLFWindow
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow* window);
-
-//Render soft body
-void drawSoftBody(Shader& shader, CamV2& camera, btSoftBody& softBody, glm::vec3 softBodyColor);
-
-//Generate mesh
-MeshV2 getSoftBodyMesh(btSoftBody* softBody, glm::vec3 softBodyColor);
+//Model matrix of a rigid body of the snapshot, interpolated between its last two states
+glm::mat4 getRigidBodyMatrix(const PhysicsSnapshotV2& snapshot, int rigidBodyIndex, btScalar alpha);
 
 /////////////////////////////////////////////////////////
 //Setup values
@@ -35,10 +34,15 @@ GLfloat lastFrame = 0.0f;
 //Soft bodies physics class
 PhysicsV2 physics;
 
-//Soft bodies attributes to generate and render them
-vector<MeshV2> generatedSoftBodiesMeshes;
+//Colours chosen when the soft bodies were requested, in the order they are generated
+//(the position of a colour is the id of its soft body)
 vector<glm::vec3> softBodiesColours;
 
+//Models, scales and colours of the rigid bodies, in the order they are generated (same order of the snapshots)
+vector<ModelV2*> rigidBodiesModels;
+vector<glm::vec3> rigidBodiesScales;
+vector<glm::vec3> rigidBodiesColours;
+
 //Main function
 int main() {
 
@@ -71,12 +75,17 @@ int main() {
     gladLoadGL();
     glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
 
+    //Count the GL calls of every frame, shown by the frame profiler
+    GLCallCounterV2::install();
+
     ////////////////////////////////////////////////////
     //Shader setup
 
     //Read vertex and fragment shaders
     //Generate and link shader program
     Shader shaderProgram("Shaders/basic.vert", "Shaders/basic.frag");
+    //Same fragment shader, model matrix and colour come from the instance buffer
+    Shader instancedProgram("Shaders/instanced.vert", "Shaders/basic.frag");
 
     //////////////////////////////////////////////////////
     //Application loading
@@ -86,6 +95,9 @@ int main() {
 
     //Create camera in starting position
     CamV2 CamV2(SCR_WIDTH, SCR_HEIGHT, glm::vec3(0.0f, 0.0f, 2.0f));
+    //Both programs read the camera from the same uniform buffer
+    CamV2.Bind(shaderProgram);
+    CamV2.Bind(instancedProgram);
 
     //Import models at the start
     //Simple models
@@ -93,8 +105,7 @@ int main() {
     ModelV2 cubeModel("models/cube.obj");
     ModelV2 sphereModel("models/sphere.obj");
     //More complex models
-    //Longer loading times
-    //ModelV2 bunnyModel("models/bunny_lp.obj");
+    ModelV2 bunnyModel("models/bunny_lp.obj");
     //ModelV2 yodaModel("models/babyyoda.obj");
 
     /////////////////////////////////////////////////////////
@@ -105,13 +116,19 @@ int main() {
 
     //Generate world plane
     glm::vec3 planeScale = glm::vec3(50.0f, 0.1f, 50.0f);
-    btRigidBody* plane = physics.genWorldPlane(planeScale, 0.0f);
+    physics.genWorldPlane(planeScale, 0.0f);
+    //The plane is drawn as a scaled cube, black like its vertices colour
+    rigidBodiesModels.push_back(&planeModel);
+    rigidBodiesScales.push_back(planeScale);
+    rigidBodiesColours.push_back(glm::vec3(0.0f, 0.0f, 0.0f));
 
-    ///////////////////////////////////////////////////
-    //Time steps
+    //Rigid and static bodies are drawn with one instanced draw per mesh
+    InstanceRendererV2 rigidRenderer;
+    //All the soft bodies share the same buffers and are drawn with one call
+    SoftBodyRendererV2 softBodyRenderer;
 
-    //Set the maximum delta time for the update of the physical simulation
-    GLfloat maxSecPerFrame = 1.0f / 60.0f;
+    //From now on the world is stepped and modified only by the simulation thread
+    physics.startSimulationThread();
 
     //////////////////////////////////////////////////////////
     //GUI
@@ -126,7 +143,7 @@ int main() {
 
     //GUI parameters collection for generating soft bodies!
     static int selectedModel = NULL;
-    vector<const char*> availableModels = { "Cube", "Sphere" };
+    vector<const char*> availableModels = { "Cube", "Sphere", "Bunny" };
 
     float position[3] = { 0.0f, 3.0f, 0.0f };
     float rotation[3] = { 0.0f, 0.0f, 0.0f };
@@ -138,17 +155,26 @@ int main() {
     float internalPressure = 100.0f;
 
     bool generate = false;
+    bool rigidBody = false;
+
+    //Simulation steps per second
+    float physicsRate = 60.0f;
+    int maxSubSteps = physics.maxSubSteps;
 
-    //Frame rate monitor
-    auto startTime = chrono::high_resolution_clock::now();
+    //Frame profiler (overlay window), replaces printing the frame rate every frame
+    FrameProfilerV2 frameProfiler;
+    frameProfiler.init();
 
     ////////////////////////////////////////////////////////////////////////
     //Rendering loop!
 
     while (!glfwWindowShouldClose(window)) 
     {
+        frameProfiler.beginFrame();
 
+        frameProfiler.beginScope("Input");
         processInput(window);
+        frameProfiler.endScope();
 
         GLfloat currentFrame = glfwGetTime();
         deltaTime = currentFrame - lastFrame;
@@ -163,34 +189,68 @@ int main() {
         ImGui::NewFrame();
 
         //Unlink mouse from OpenGL window when I'm above the GUI window
+        frameProfiler.beginScope("Input");
         if (!io.WantCaptureMouse)
         {
             CamV2.Inputs(window);
         }
+        frameProfiler.endScope();
+
+        //Latest state published by the simulation thread
+        frameProfiler.beginScope("Physics sync");
+        const PhysicsSnapshotV2& snapshot = physics.acquireSnapshot();
+        frameProfiler.recordPhysics(snapshot.statistics);
+        frameProfiler.endScope();
+
+        //////////////////////////////////////////////////////////////////////
+        //Soft bodies meshes update and rigid bodies instances
+
+        frameProfiler.beginScope("Mesh extraction");
+
+        //Interpolation factor at the current time, the snapshot was taken some time ago
+        btScalar alpha = snapshot.alpha +
+            (btScalar)((PhysicsV2::currentTime() - snapshot.time) / snapshot.fixedTimeStep);
+        alpha = min(alpha, (btScalar)1.0f);
+
+        //New and removed soft bodies take and give back their ranges of the shared buffers
+        softBodyRenderer.update(snapshot, softBodiesColours, alpha);
+
+        //Bodies requested in this frame are not in the snapshot yet
+        int numRigidBodies = min(snapshot.rigidTransforms.size(), (int)rigidBodiesModels.size());
+        for (int i = 0; i < numRigidBodies; i++)
+        {
+            glm::mat4 model = getRigidBodyMatrix(snapshot, i, alpha) * glm::scale(glm::mat4(1.0f), rigidBodiesScales[i]);
+            for (MeshV2& mesh : rigidBodiesModels[i]->meshes)
+                rigidRenderer.add(mesh, model, rigidBodiesColours[i]);
+        }
+
+        frameProfiler.endScope();
 
-        //Step simulation forward
-        physics.world->stepSimulation((deltaTime < maxSecPerFrame ? deltaTime : maxSecPerFrame), 10);
+        //////////////////////////////////////////////////////////////////////
+        //Rendering
 
-        //Activate shader program
-        shaderProgram.Use();
+        frameProfiler.beginScope("GPU submission");
+        frameProfiler.beginGpuScope("Scene");
 
         //CamV2.Inputs(window);
-        //Updates and exports the camera matrix to the Vertex Shader
+        //Updates the camera matrix and uploads it once for all the shader programs
         CamV2.updateMatrix(45.0f, 0.1f, 1000.0f);
+        CamV2.updateBuffer();
+
+        //Static world plane and rigid bodies
+        rigidRenderer.draw(instancedProgram);
 
-        /////////////////////////////////////////////////////////
+        //Soft bodies only (to speed up development)
+        softBodyRenderer.draw(shaderProgram);
 
-        //Static world plane
-        btTransform t;
-        plane->getMotionState()->getWorldTransform(t);
-        planeModel.meshes[0].Draw(shaderProgram, CamV2, glm::mat4(1.0f),
-            glm::vec3(t.getOrigin().x(), t.getOrigin().y(), t.getOrigin().z()),
-            glm::quat(t.getRotation().x(), t.getRotation().y(), t.getRotation().z(), t.getRotation().w()),
-            planeScale);
-        //cout << planeModel.meshes.size() << "piano" << endl;
+        frameProfiler.endGpuScope();
+        frameProfiler.endScope();
 
         /////////////////////////////////////////////
-        //GUI
+        //GUI, drawn last so it stays on top of the scene
+
+        frameProfiler.beginScope("ImGui");
+        frameProfiler.beginGpuScope("ImGui");
         
         //Helper
         //ImGui::ShowDemoWindow();
@@ -215,60 +275,107 @@ int main() {
         //Internal pressure
         ImGui::DragFloat("Internal pressure", &internalPressure, 0.005f, 0.0f, FLT_MAX, "%.2f", 0);
         
+        //Rigid body instead of a soft one
+        ImGui::Checkbox("Rigid body", &rigidBody);
+        
         //When clicked spawn new body
         generate = ImGui::Button("Generate");
 
+        //Remove the oldest soft body still in the world
+        ImGui::SameLine();
+        if (ImGui::Button("Remove soft body") && !snapshot.softBodies.empty())
+        {
+            int oldest = snapshot.softBodies[0].id;
+            for (const SoftBodySnapshotV2& softBody : snapshot.softBodies)
+                oldest = min(oldest, softBody.id);
+            physics.enqueue([oldest]() { physics.removeSoftBody(oldest); });
+        }
+
         //Stop accepting inputs
         ImGui::End();
 
+        //Simulation rate and fixed step statistics
+        ImGui::Begin("Simulation");
+        //Settings are changed by the simulation thread between two steps
+        if (ImGui::SliderFloat("Physics rate (Hz)", &physicsRate, 10.0f, 240.0f, "%.0f", 0))
+        {
+            btScalar fixedTimeStep = 1.0f / physicsRate;
+            physics.enqueue([fixedTimeStep]() { physics.fixedTimeStep = fixedTimeStep; });
+        }
+        if (ImGui::SliderInt("Substeps budget", &maxSubSteps, 1, 20))
+        {
+            int budget = maxSubSteps;
+            physics.enqueue([budget]() { physics.maxSubSteps = budget; });
+        }
+        ImGui::Text("Steps last publish: %d", snapshot.statistics.lastSubSteps);
+        ImGui::Text("Frames over budget: %lld", snapshot.statistics.framesOverBudget);
+        ImGui::Text("Dropped time: %.3f s", snapshot.statistics.droppedTime);
+        //Use of the shared soft bodies buffers
+        const FreeListAllocatorV2& vertexRanges = softBodyRenderer.getVertexRanges();
+        ImGui::Text("Soft bodies: %d, vertices %lld/%lld in %d free ranges", softBodyRenderer.getNumBodies(),
+            vertexRanges.getUsed(), vertexRanges.getCapacity(), vertexRanges.getNumFreeRanges());
+        ImGui::Text("Sleeping soft bodies: %d", snapshot.statistics.sleepingSoftBodies);
+        //Signed distance cache of the soft-rigid contacts and time spent in the collisions since the start
+        const StepStatisticsV2& statistics = snapshot.statistics;
+        ImGui::Text("SDF cells: %d (%d precomputed), hit rate %.1f%%, evictions %lld", statistics.sdfCells, statistics.sdfPrecomputed,
+            statistics.sdfQueries > 0 ? 100.0 * (statistics.sdfQueries - statistics.sdfMisses) / statistics.sdfQueries : 0.0,
+            statistics.sdfEvictions);
+        ImGui::Text("Collision time: %.3f s", statistics.phaseTimes[PhysicsProfilerV2::COLLISION]);
+        ImGui::End();
+
+        //Frame times of the last frames
+        frameProfiler.drawOverlay();
+
         //GUI rendering
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
+        frameProfiler.endGpuScope();
+        frameProfiler.endScope();
+
         //Generate a soft body using all parameters passed to the GUI when generate is true
-        if (generate == true) cout << "button pressed" << endl;
         if (generate == true)
         {
-            //Generate softBody
-            btSoftBody* softBody{};
-            if (selectedModel == 0)
-                softBody = physics.generateSoftBodyTest(cubeModel, position, rotation, scale, mass, internalPressure);
-            else if (selectedModel == 1)
-                softBody = physics.generateSoftBodyTest(sphereModel, position, rotation, scale, mass, internalPressure);
-            //Generate its colours
-            softBodiesColours.push_back(glm::make_vec3(color));
-
-            //Retrieve soft body mesh
-            MeshV2 softBodyMesh = getSoftBodyMesh(softBody, glm::make_vec3(color));
-            generatedSoftBodiesMeshes.push_back(softBodyMesh);
+            ModelV2* model = &cubeModel;
+            if (selectedModel == 1)
+                model = &sphereModel;
+            else if (selectedModel == 2)
+                model = &bunnyModel;
+
+            //The body is generated by the simulation thread, the parameters are copied
+            //Commands run in order so the colour matches the body once it shows up in a snapshot
+            //A model that failed to import gives no rigid body, so nothing is added to the drawn bodies
+            if (rigidBody && !model->vertices.empty())
+            {
+                rigidBodiesModels.push_back(model);
+                rigidBodiesScales.push_back(glm::vec3(1.0f, 1.0f, 1.0f));
+                rigidBodiesColours.push_back(glm::make_vec3(color));
+                physics.enqueue([model, position, rotation, mass]() mutable {
+                    physics.generateRigidBody(*model, position, rotation, mass);
+                });
+            }
+            else if (!rigidBody)
+            {
+                softBodiesColours.push_back(glm::make_vec3(color));
+                physics.enqueue([model, position, rotation, scale, mass, internalPressure]() mutable {
+                    physics.generateSoftBodyTest(*model, position, rotation, scale, mass, internalPressure);
+                });
+            }
         }
 
         //Switch generate to false otherwise bodies keep being generated!
         generate = false;
 
-        /////////////////////////////////////////////////////////////////////
-        //Frame rate evaluation
-        //Calculate elapsed time
-        auto elapsedTime = std::chrono::high_resolution_clock::now() - startTime;
-        startTime = std::chrono::high_resolution_clock::now();
-        //Calculate frame rate
-        double frameRate = 1.0 / std::chrono::duration_cast<std::chrono::duration<double>>(elapsedTime).count();
-        //Print the frame rate
-        std::cout << "Frame rate: " << frameRate << std::endl;
-
-        //////////////////////////////////////////////////////////////////////
-        //Rendering
-
-        //Soft bodies only (to speed up development)
-        for (int i = 0; i < physics.world->getSoftBodyArray().size(); i++)
-        {
-            btSoftBody* softBodyToDraw = physics.world->getSoftBodyArray()[i];
-            drawSoftBody(shaderProgram, CamV2, *softBodyToDraw, softBodiesColours[i]);
-        }
-
         ///////////////////////////////
+        frameProfiler.beginScope("Swap");
         glfwSwapBuffers(window);
+        frameProfiler.endScope();
+
+        frameProfiler.beginScope("Input");
         glfwPollEvents();
+        frameProfiler.endScope();
+
+        frameProfiler.endFrame();
     }
 
     /////////////////////////////////////////////////////////
@@ -279,8 +386,23 @@ int main() {
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
-    //Shader program
+    //Soft bodies meshes and rigid bodies instances
+    softBodyRenderer.Delete();
+    rigidRenderer.Delete();
+
+    //Models meshes, their buffers can't be freed once the window is destroyed
+    planeModel.Delete();
+    cubeModel.Delete();
+    sphereModel.Delete();
+    bunnyModel.Delete();
+
+    //Frame profiler queries
+    frameProfiler.Delete();
+
+    //Camera uniform buffer and shader programs
+    CamV2.Delete();
     shaderProgram.Delete();
+    instancedProgram.Delete();
 
     //Physics
     physics.deletePhysics();
@@ -314,142 +436,16 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
     glViewport(0, 0, width, height);
 }
 
-//Rendering function
-void drawSoftBody(Shader& shader, CamV2& camera, btSoftBody& softBody, glm::vec3 softBodyColor)
+//Rigid bodies are stepped at the physics rate, like the soft bodies they are drawn between their last two states
+glm::mat4 getRigidBodyMatrix(const PhysicsSnapshotV2& snapshot, int rigidBodyIndex, btScalar alpha)
 {
-    //Get soft body vertices
-    vector<Vertex> softVertices;
-    //Map vertices
-    unsigned int index = 0;
-
-    //Recover soft body indices using mapping (since soft bodies in Bullet do not have them)
-    vector<GLuint> softIndices;
-
-    //Reserve size to save time and avoid reallocations
-    softVertices.reserve(softBody.m_nodes.size());
-    softIndices.reserve(softBody.m_faces.size() * 3);
-
-
-    //Get soft body vertices
-    //BY ITERATING OVER NODES; NOT FACES!!!!!
-    for (unsigned int i = 0; i < softBody.m_nodes.size(); i++)
-    {
-        Vertex vertex;
-
-        vertex.Position = glm::vec3(
-            softBody.m_nodes[i].m_x.x(),
-            softBody.m_nodes[i].m_x.y(),
-            softBody.m_nodes[i].m_x.z()
-        );
-
-        vertex.Normal = glm::vec3(
-            softBody.m_nodes[i].m_n.x(),
-            softBody.m_nodes[i].m_n.y(),
-            softBody.m_nodes[i].m_n.z()
-        );
-
-        vertex.Color = softBodyColor;
-
-        //Create vertices list
-        softVertices.push_back(vertex);
-
-    }
-
-    //Get soft body indices
-    unsigned int numNodes = softBody.m_nodes.size();
-
-    for (unsigned int i = 0; i < softBody.m_faces.size(); i++)
-    {
-        btSoftBody::Face face = softBody.m_faces[i];
-        for (int j = 0; j < 3; j++)
-        {
-            btSoftBody::Node* node = face.m_n[j];
-            for (int k = 0; k < numNodes; k++)
-            {
-                if (node == &softBody.m_nodes[k])
-                {
-                    softIndices.push_back(static_cast<GLuint>(k));
-                    break;
-                }
-            }
-        }
-    }
+    const btTransform& current = snapshot.rigidTransforms[rigidBodyIndex];
+    const btTransform& previous = snapshot.previousRigidTransforms[rigidBodyIndex];
 
-    //V1
-    //Li passo alla GPU per disegnare il softbody
-    //MeshV2 mesh(softVertices, softIndices);
-    //mesh.Draw(shader, camera);
-
-    //V2
-    MeshV2 mesh2(softVertices, softIndices, 0);
-    mesh2.drawV2(shader, camera);
+    btTransform transform(previous.getRotation().slerp(current.getRotation(), alpha),
+        lerp(previous.getOrigin(), current.getOrigin(), alpha));
 
+    btScalar matrix[16];
+    transform.getOpenGLMatrix(matrix);
+    return glm::make_mat4(matrix);
 }
-
-MeshV2 getSoftBodyMesh(btSoftBody* softBody, glm::vec3 softBodyColor)
-{
-    //Get soft body vertices
-    vector<Vertex> softVertices;
-    //Vertices mapping
-    unsigned int index = 0;
-
-    //Build indices correctly using the mapping (since missing in the Bullet soft body)
-    vector<GLuint> softIndices;
-
-    //Reserve size to save time and avoid reallocations
-    softVertices.reserve(softBody->m_nodes.size());
-    softIndices.reserve(softBody->m_faces.size() * 3);
-
-    //Recover soft body vertices components
-    //DO IT OVER THE NODES, NOT THE FACES!!!!!
-
-    //Get vertices
-    for (unsigned int i = 0; i < softBody->m_nodes.size(); i++)
-    {
-        Vertex vertex;
-
-        vertex.Position = glm::vec3(
-            softBody->m_nodes[i].m_x.x(),
-            softBody->m_nodes[i].m_x.y(),
-            softBody->m_nodes[i].m_x.z()
-        );
-
-        vertex.Normal = glm::vec3(
-            softBody->m_nodes[i].m_n.x(),
-            softBody->m_nodes[i].m_n.y(),
-            softBody->m_nodes[i].m_n.z()
-        );
-
-        vertex.Color = softBodyColor;
-
-        //Create vertices list
-        softVertices.push_back(vertex);
-        //Prepare indexing
-        //Insert node and corresponding assigned index
-
-    }
-
-    //Get indices
-    unsigned int numNodes = softBody->m_nodes.size();
-
-    for (unsigned int i = 0; i < softBody->m_faces.size(); i++)
-    {
-        btSoftBody::Face face = softBody->m_faces[i];
-        for (int j = 0; j < 3; j++)
-        {
-            btSoftBody::Node* node = face.m_n[j];
-            for (int k = 0; k < numNodes; k++)
-            {
-                if (node == &softBody->m_nodes[k])
-                {
-                    softIndices.push_back(static_cast<GLuint>(k));
-                    break;
-                }
-            }
-        }
-    }
-
-    return MeshV2(softVertices, softIndices);
-
-}
-
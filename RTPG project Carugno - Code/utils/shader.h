@@ -17,7 +17,11 @@ using namespace std;
 
 // Std. Includes
 #include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <cstring>
 #include <string>
+#include <unordered_map>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -95,19 +99,153 @@ public:
         // Step 4: we delete the shaders because they are linked to the Shader Program, and we do not need them anymore
         glDeleteShader(vertex);
         glDeleteShader(fragment);
+
+        // Step 5: we collect the locations of the active uniforms, so they are never queried by name while drawing
+        reflectUniforms();
     }
 
     //////////////////////////////////////////
 
     // We activate the Shader Program as part of the current rendering process
-    void Use() { glUseProgram(this->Program); }
+    // (the call is skipped if the program is already in use)
+    void Use()
+    {
+        if (currentProgram() == this->Program)
+            return;
+        glUseProgram(this->Program);
+        currentProgram() = this->Program;
+    }
 
     // We delete the Shader Program when application closes
-    void Delete() { glDeleteProgram(this->Program); }
+    void Delete()
+    {
+        if (currentProgram() == this->Program)
+            currentProgram() = 0;
+        glDeleteProgram(this->Program);
+        uniforms.clear();
+    }
+
+    // Location of an active uniform, -1 if the program does not use it
+    GLint getLocation(const char* name)
+    {
+        Uniform* uniform = findUniform(name);
+        return uniform ? uniform->location : -1;
+    }
+
+    // We assign a uniform block of the program to a binding point, where a uniform buffer is bound
+    void bindUniformBlock(const char* name, GLuint binding)
+    {
+        GLuint index = glGetUniformBlockIndex(this->Program, name);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(this->Program, index, binding);
+    }
+
+    //////////////////////////////////////////
+
+    // Typed setters: the program must be in use (see Use())
+    // the last value of every uniform is kept, and a value equal to it is not uploaded again
+    void setInt(const char* name, GLint value)
+    {
+        Uniform* uniform = changedUniform(name, &value, sizeof(value));
+        if (uniform)
+            glUniform1i(uniform->location, value);
+    }
+
+    void setFloat(const char* name, GLfloat value)
+    {
+        Uniform* uniform = changedUniform(name, &value, sizeof(value));
+        if (uniform)
+            glUniform1f(uniform->location, value);
+    }
+
+    void setVec3(const char* name, const glm::vec3& value)
+    {
+        Uniform* uniform = changedUniform(name, glm::value_ptr(value), sizeof(value));
+        if (uniform)
+            glUniform3fv(uniform->location, 1, glm::value_ptr(value));
+    }
+
+    void setVec4(const char* name, const glm::vec4& value)
+    {
+        Uniform* uniform = changedUniform(name, glm::value_ptr(value), sizeof(value));
+        if (uniform)
+            glUniform4fv(uniform->location, 1, glm::value_ptr(value));
+    }
+
+    void setMat4(const char* name, const glm::mat4& value)
+    {
+        Uniform* uniform = changedUniform(name, glm::value_ptr(value), sizeof(value));
+        if (uniform)
+            glUniformMatrix4fv(uniform->location, 1, GL_FALSE, glm::value_ptr(value));
+    }
 
 private:
     //////////////////////////////////////////
 
+    // Active uniform of the program, with the last value uploaded to it
+    struct Uniform
+    {
+        GLint location = -1;
+        // the largest value handled by the setters is a mat4
+        GLfloat value[16];
+        size_t size = 0;
+    };
+
+    // hashed table of the active uniforms, filled once after linking
+    unordered_map<string, Uniform> uniforms;
+
+    // Program in use in the context, shared by all the Shader objects
+    static GLuint& currentProgram()
+    {
+        static GLuint program = 0;
+        return program;
+    }
+
+    // We query the active uniforms of the linked program and store their locations by name
+    // (uniforms in blocks have no location and are set through their uniform buffer)
+    void reflectUniforms()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(this->Program, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(this->Program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        string name(maxLength > 0 ? maxLength : 1, '\0');
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(this->Program, i, (GLsizei)name.size(), &length, &size, &type, &name[0]);
+            GLint location = glGetUniformLocation(this->Program, name.c_str());
+            if (location < 0)
+                continue;
+            // arrays are reported as "name[0]", they are set by their name
+            string key = name.substr(0, length);
+            if (key.size() > 3 && key.compare(key.size() - 3, 3, "[0]") == 0)
+                key.resize(key.size() - 3);
+            uniforms[key].location = location;
+        }
+    }
+
+    Uniform* findUniform(const char* name)
+    {
+        auto uniform = uniforms.find(name);
+        return uniform != uniforms.end() ? &uniform->second : nullptr;
+    }
+
+    // We return the uniform only if the value differs from the last one uploaded, and we store it
+    Uniform* changedUniform(const char* name, const void* value, size_t size)
+    {
+        Uniform* uniform = findUniform(name);
+        if (!uniform)
+            return nullptr;
+        if (uniform->size == size && memcmp(uniform->value, value, size) == 0)
+            return nullptr;
+        memcpy(uniform->value, value, size);
+        uniform->size = size;
+        return uniform;
+    }
+    //////////////////////////////////////////
+
     // Check compilation and linking errors
     void checkCompileErrors(GLuint shader, string type)
     {
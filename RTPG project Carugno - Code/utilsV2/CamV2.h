@@ -12,9 +12,20 @@
 
 #include "../utils/shader.h"
 
+//Camera data as laid out in the std140 Camera uniform block of the shaders
+//(a vec3 takes the space of a vec4)
+struct CameraBlockV2
+{
+	glm::mat4 camMatrix;
+	glm::vec4 camPos;
+};
+
 class CamV2
 {
 public:
+	//Binding point of the Camera uniform block, shared by all the programs
+	enum { CAMERA_BINDING = 0 };
+
 	glm::vec3 Position;
 	glm::vec3 Orientation = glm::vec3(0.0f, 0.0f, -1.0f);
 	glm::vec3 Up = glm::vec3(0.0f, 1.0f, 0.0f);
@@ -28,6 +39,9 @@ public:
 	float speed = 0.1f;
 	float sensitivity = 100.0f;
 
+	//Uniform buffer with the camera block, created by the first updateBuffer
+	GLuint UBO = 0;
+
 	//Cam constructor
 	CamV2(int width, int height, glm::vec3 position)
 	{
@@ -49,11 +63,39 @@ public:
 		cameraMatrix = projection * view;
 	}
 
-	//Used for rendering camera
+	//Upload the camera matrix and position for every program, once per frame after updateMatrix
+	void updateBuffer()
+	{
+		if (!UBO)
+		{
+			glGenBuffers(1, &UBO);
+			glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+			glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlockV2), NULL, GL_DYNAMIC_DRAW);
+			glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_BINDING, UBO);
+		}
+		CameraBlockV2 block = { cameraMatrix, glm::vec4(Position, 1.0f) };
+		glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraBlockV2), &block);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+	//Link the Camera block of a program to the camera buffer
+	void Bind(Shader& shader)
+	{
+		shader.bindUniformBlock("Camera", CAMERA_BINDING);
+	}
+
+	//Used for rendering camera with programs that take the matrix as a plain uniform
 	void Matrix(Shader& shader, const char* uniform)
 	{
-		glUniformMatrix4fv(glGetUniformLocation(shader.Program, uniform),
-			1, GL_FALSE, glm::value_ptr(cameraMatrix));
+		shader.setMat4(uniform, cameraMatrix);
+	}
+
+	void Delete()
+	{
+		if (UBO)
+			glDeleteBuffers(1, &UBO);
+		UBO = 0;
 	}
 
 	//Collect inputs
@@ -7,11 +7,50 @@
 class EBO
 {
 public:
-	GLuint ID;
+	GLuint ID = 0;
 
-	EBO(vector<GLuint>& indices)
+	//Empty buffer, data is uploaded later
+	EBO()
 	{
 		glGenBuffers(1, &ID);
+	}
+
+	EBO(const vector<GLuint>& indices)
+	{
+		glGenBuffers(1, &ID);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ID);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint),
+			indices.data(), GL_STATIC_DRAW);
+	}
+
+	//The buffer is owned by a single object, so it can be moved but not copied
+	EBO(const EBO&) = delete;
+	EBO& operator=(const EBO&) = delete;
+
+	EBO(EBO&& other) noexcept : ID(other.ID)
+	{
+		other.ID = 0;
+	}
+
+	EBO& operator=(EBO&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Delete();
+			ID = other.ID;
+			other.ID = 0;
+		}
+		return *this;
+	}
+
+	~EBO()
+	{
+		Delete();
+	}
+
+	//Replace the content of the buffer, binding it to the current VAO
+	void Data(const vector<GLuint>& indices)
+	{
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ID);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint),
 			indices.data(), GL_STATIC_DRAW);
@@ -29,7 +68,9 @@ public:
 
 	void Delete()
 	{
-		glDeleteBuffers(1, &ID);
+		if (ID)
+			glDeleteBuffers(1, &ID);
+		ID = 0;
 	};
 
 };
@@ -0,0 +1,450 @@
+#pragma once
+using namespace std;
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "ImGui/imgui.h"
+
+#include "GLCallCounterV2.h"
+#include "PhysicsSnapshotV2.h"
+
+//Profiler of the last frames, kept in a ring buffer
+//CPU scopes are timed with the steady clock, GPU scopes with timer queries that are read
+//a few frames later (the CPU never waits for the GPU) and the physics phases come from
+//the statistics of the snapshots, as time spent by the simulation thread during the frame
+//The GL calls of every frame are taken from GLCallCounterV2 (zero if it is not installed)
+class FrameProfilerV2
+{
+public:
+
+	enum
+	{
+		//Frames kept for the overlay and the trace
+		NUM_FRAMES = 240,
+		//Sequential GPU scopes in a frame (timer queries cannot be nested)
+		MAX_GPU_SCOPES = 4,
+		//Frames after which the result of a timer query is read
+		GPU_LATENCY = 4
+	};
+
+	struct ScopeEvent
+	{
+		const char* name;
+		int depth;
+		//Seconds since the profiler was created
+		double start;
+		double duration;
+	};
+
+	struct FrameRecord
+	{
+		long long index = -1;
+		double start = 0.0;
+		double duration = 0.0;
+
+		vector<ScopeEvent> events;
+
+		const char* gpuNames[MAX_GPU_SCOPES] = {};
+		double gpuTimes[MAX_GPU_SCOPES] = {};
+		int numGpuScopes = 0;
+		bool gpuReady = false;
+
+		int physicsSteps = 0;
+		double physicsStepTime = 0.0;
+		double physicsPhaseTimes[PhysicsProfilerV2::NUM_PHASES] = {};
+
+		long long glCalls = 0;
+		long long glDrawCalls = 0;
+	};
+
+	FrameProfilerV2()
+	{
+		origin = chrono::steady_clock::now();
+	}
+
+	FrameProfilerV2(const FrameProfilerV2&) = delete;
+	FrameProfilerV2& operator=(const FrameProfilerV2&) = delete;
+
+	//Create the timer queries, needs a current OpenGL context
+	void init()
+	{
+		glGenQueries(GPU_LATENCY * MAX_GPU_SCOPES, &queries[0][0]);
+	}
+
+	void Delete()
+	{
+		if (queries[0][0])
+			glDeleteQueries(GPU_LATENCY * MAX_GPU_SCOPES, &queries[0][0]);
+		memset(queries, 0, sizeof(queries));
+	}
+
+	void beginFrame()
+	{
+		recording = !pauseRequested;
+		if (!recording)
+			return;
+
+		//The queries of this slot are reused, collect the frame that used them before
+		collectGpuTimes(frameIndex - GPU_LATENCY);
+
+		FrameRecord& frame = frames[frameIndex % NUM_FRAMES];
+		frame.index = frameIndex;
+		frame.start = now();
+		frame.duration = 0.0;
+		frame.events.clear();
+		frame.numGpuScopes = 0;
+		frame.gpuReady = false;
+		frame.physicsSteps = 0;
+		frame.physicsStepTime = 0.0;
+		for (int i = 0; i < PhysicsProfilerV2::NUM_PHASES; i++)
+			frame.physicsPhaseTimes[i] = 0.0;
+		frame.glCalls = 0;
+		frame.glDrawCalls = 0;
+		openScopes.clear();
+		GLCallCounterV2::reset();
+	}
+
+	void endFrame()
+	{
+		if (!recording)
+			return;
+		FrameRecord& frame = frames[frameIndex % NUM_FRAMES];
+		frame.duration = now() - frame.start;
+		frame.glCalls = GLCallCounterV2::getCalls();
+		frame.glDrawCalls = GLCallCounterV2::getDrawCalls();
+		frameIndex++;
+	}
+
+	void beginScope(const char* name)
+	{
+		if (!recording)
+			return;
+		FrameRecord& frame = frames[frameIndex % NUM_FRAMES];
+		ScopeEvent event = { name, (int)openScopes.size(), now(), 0.0 };
+		openScopes.push_back(frame.events.size());
+		frame.events.push_back(event);
+		addName(scopeNames, name);
+	}
+
+	void endScope()
+	{
+		if (!recording || openScopes.empty())
+			return;
+		ScopeEvent& event = frames[frameIndex % NUM_FRAMES].events[openScopes.back()];
+		event.duration = now() - event.start;
+		openScopes.pop_back();
+	}
+
+	void beginGpuScope(const char* name)
+	{
+		FrameRecord& frame = frames[frameIndex % NUM_FRAMES];
+		if (!recording || gpuScopeOpen || frame.numGpuScopes == MAX_GPU_SCOPES || !queries[0][0])
+			return;
+		glBeginQuery(GL_TIME_ELAPSED, queries[frameIndex % GPU_LATENCY][frame.numGpuScopes]);
+		frame.gpuNames[frame.numGpuScopes] = name;
+		gpuScopeOpen = true;
+		addName(gpuScopeNames, name);
+	}
+
+	void endGpuScope()
+	{
+		if (!recording || !gpuScopeOpen)
+			return;
+		glEndQuery(GL_TIME_ELAPSED);
+		frames[frameIndex % NUM_FRAMES].numGpuScopes++;
+		gpuScopeOpen = false;
+	}
+
+	//Time spent by the simulation thread since the statistics of the previous frame
+	void recordPhysics(const StepStatisticsV2& statistics)
+	{
+		if (!recording)
+			return;
+		FrameRecord& frame = frames[frameIndex % NUM_FRAMES];
+		frame.physicsSteps = (int)(statistics.totalSteps - lastPhysics.totalSteps);
+		frame.physicsStepTime = statistics.stepTime - lastPhysics.stepTime;
+		for (int i = 0; i < PhysicsProfilerV2::NUM_PHASES; i++)
+			frame.physicsPhaseTimes[i] = statistics.phaseTimes[i] - lastPhysics.phaseTimes[i];
+		lastPhysics = statistics;
+	}
+
+	//ImGui window with the frame times, their percentiles and the time of every scope
+	void drawOverlay()
+	{
+		ImGui::Begin("Frame profiler");
+
+		bool paused = pauseRequested;
+		if (ImGui::Checkbox("Pause", &paused))
+			pauseRequested = paused;
+		ImGui::SameLine();
+		if (ImGui::Button("Export Chrome trace"))
+			exportStatus = exportChromeTrace(TRACE_PATH) ? string("Saved ") + TRACE_PATH : string("Could not write ") + TRACE_PATH;
+		if (!exportStatus.empty())
+			ImGui::Text("%s", exportStatus.c_str());
+
+		//Frame times in order and sorted (the sorted plot is the percentile curve)
+		vector<double> values;
+		vector<float> plot;
+		for (long long i = firstFrame(); i < frameIndex; i++)
+		{
+			values.push_back(frames[i % NUM_FRAMES].duration);
+			plot.push_back((float)(values.back() * 1000.0));
+		}
+		if (!plot.empty())
+		{
+			ImGui::PlotLines("Frame (ms)", plot.data(), (int)plot.size(), 0, NULL, 0.0f, FLT_MAX, ImVec2(0.0f, 60.0f));
+			sort(plot.begin(), plot.end());
+			ImGui::PlotLines("Percentiles (ms)", plot.data(), (int)plot.size(), 0, NULL, 0.0f, FLT_MAX, ImVec2(0.0f, 60.0f));
+		}
+
+		if (ImGui::BeginTable("Scopes", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+		{
+			ImGui::TableSetupColumn("Scope (ms)");
+			ImGui::TableSetupColumn("mean");
+			ImGui::TableSetupColumn("p50");
+			ImGui::TableSetupColumn("p95");
+			ImGui::TableSetupColumn("p99");
+			ImGui::TableHeadersRow();
+
+			drawRow("Frame", values);
+			for (const char* name : scopeNames)
+			{
+				collectScope(name, values);
+				drawRow(name, values);
+			}
+			for (const char* name : gpuScopeNames)
+			{
+				collectGpuScope(name, values);
+				drawRow((string("GPU ") + name).c_str(), values);
+			}
+			collectPhysics(-1, values);
+			drawRow("Physics steps", values, 1.0);
+			collectPhysics(PhysicsProfilerV2::NUM_PHASES, values);
+			drawRow("Physics step", values);
+			for (int i = 0; i < PhysicsProfilerV2::NUM_PHASES; i++)
+			{
+				collectPhysics(i, values);
+				drawRow((string("Physics ") + PhysicsProfilerV2::getPhaseName(i)).c_str(), values);
+			}
+			collectGlCalls(false, values);
+			drawRow("GL calls", values, 1.0);
+			collectGlCalls(true, values);
+			drawRow("GL calls per draw", values, 1.0);
+
+			ImGui::EndTable();
+		}
+
+		ImGui::End();
+	}
+
+	//Write the recorded frames in the Chrome trace event format (chrome://tracing, Perfetto)
+	//GPU scopes are placed one after the other from the start of their frame and the
+	//physics time of every frame is written as a counter
+	bool exportChromeTrace(const string& path)
+	{
+		ofstream out(path);
+		if (!out)
+			return false;
+
+		out << "{\"traceEvents\":[" << endl;
+		out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}}," << endl;
+		out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+		for (long long i = firstFrame(); i < frameIndex; i++)
+		{
+			const FrameRecord& frame = frames[i % NUM_FRAMES];
+			writeEvent(out, "Frame", 1, frame.start, frame.duration);
+			for (const ScopeEvent& event : frame.events)
+				writeEvent(out, event.name, 1, event.start, event.duration);
+
+			double gpuStart = frame.start;
+			for (int j = 0; frame.gpuReady && j < frame.numGpuScopes; j++)
+			{
+				writeEvent(out, frame.gpuNames[j], 2, gpuStart, frame.gpuTimes[j]);
+				gpuStart += frame.gpuTimes[j];
+			}
+
+			out << "," << endl << "{\"name\":\"Physics (ms)\",\"ph\":\"C\",\"pid\":1,\"ts\":" << (long long)(frame.start * 1e6) << ",\"args\":{";
+			for (int j = 0; j < PhysicsProfilerV2::NUM_PHASES; j++)
+				out << (j > 0 ? "," : "") << "\"" << PhysicsProfilerV2::getPhaseName(j) << "\":" << frame.physicsPhaseTimes[j] * 1000.0;
+			out << "}}";
+		}
+		out << endl << "]}" << endl;
+
+		return out.good();
+	}
+
+private:
+
+	static constexpr const char* TRACE_PATH = "frame_trace.json";
+
+	chrono::steady_clock::time_point origin;
+
+	FrameRecord frames[NUM_FRAMES];
+	//Index of the frame being recorded, all the previous ones are complete
+	long long frameIndex = 0;
+	vector<size_t> openScopes;
+
+	GLuint queries[GPU_LATENCY][MAX_GPU_SCOPES] = {};
+	bool gpuScopeOpen = false;
+
+	StepStatisticsV2 lastPhysics;
+
+	//Names in order of first appearance, for the overlay rows
+	vector<const char*> scopeNames;
+	vector<const char*> gpuScopeNames;
+
+	bool recording = true;
+	bool pauseRequested = false;
+	string exportStatus;
+
+	double now()
+	{
+		return chrono::duration<double>(chrono::steady_clock::now() - origin).count();
+	}
+
+	long long firstFrame()
+	{
+		return max(0LL, frameIndex - NUM_FRAMES + 1);
+	}
+
+	static void addName(vector<const char*>& names, const char* name)
+	{
+		for (const char* existing : names)
+			if (strcmp(existing, name) == 0)
+				return;
+		names.push_back(name);
+	}
+
+	//Read the timer queries of a frame if the GPU is done with them
+	void collectGpuTimes(long long index)
+	{
+		if (index < 0 || index < firstFrame())
+			return;
+		FrameRecord& frame = frames[index % NUM_FRAMES];
+		bool ready = true;
+		for (int i = 0; i < frame.numGpuScopes && ready; i++)
+		{
+			GLuint query = queries[index % GPU_LATENCY][i];
+			GLint available = 0;
+			glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available)
+			{
+				ready = false;
+				break;
+			}
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+			frame.gpuTimes[i] = elapsed * 1e-9;
+		}
+		//Results still pending are dropped, the queries are reused anyway
+		frame.gpuReady = ready;
+	}
+
+	//Total time of a CPU scope in every recorded frame
+	void collectScope(const char* name, vector<double>& values)
+	{
+		values.clear();
+		for (long long i = firstFrame(); i < frameIndex; i++)
+		{
+			double total = 0.0;
+			for (const ScopeEvent& event : frames[i % NUM_FRAMES].events)
+				if (strcmp(event.name, name) == 0)
+					total += event.duration;
+			values.push_back(total);
+		}
+	}
+
+	void collectGpuScope(const char* name, vector<double>& values)
+	{
+		values.clear();
+		for (long long i = firstFrame(); i < frameIndex; i++)
+		{
+			const FrameRecord& frame = frames[i % NUM_FRAMES];
+			if (!frame.gpuReady)
+				continue;
+			double total = 0.0;
+			for (int j = 0; j < frame.numGpuScopes; j++)
+				if (strcmp(frame.gpuNames[j], name) == 0)
+					total += frame.gpuTimes[j];
+			values.push_back(total);
+		}
+	}
+
+	//Physics phase time of every recorded frame
+	//Phase -1 gives the number of steps and NUM_PHASES the time of the whole steps
+	void collectPhysics(int phase, vector<double>& values)
+	{
+		values.clear();
+		for (long long i = firstFrame(); i < frameIndex; i++)
+		{
+			const FrameRecord& frame = frames[i % NUM_FRAMES];
+			if (phase < 0)
+				values.push_back(frame.physicsSteps);
+			else if (phase == PhysicsProfilerV2::NUM_PHASES)
+				values.push_back(frame.physicsStepTime);
+			else
+				values.push_back(frame.physicsPhaseTimes[phase]);
+		}
+	}
+
+	//GL calls of every recorded frame, in total or per draw call
+	void collectGlCalls(bool perDraw, vector<double>& values)
+	{
+		values.clear();
+		for (long long i = firstFrame(); i < frameIndex; i++)
+		{
+			const FrameRecord& frame = frames[i % NUM_FRAMES];
+			if (!perDraw)
+				values.push_back((double)frame.glCalls);
+			else if (frame.glDrawCalls > 0)
+				values.push_back((double)frame.glCalls / frame.glDrawCalls);
+		}
+	}
+
+	//Nearest rank percentile of sorted values
+	static double percentile(const vector<double>& sorted, double p)
+	{
+		if (sorted.empty())
+			return 0.0;
+		size_t rank = (size_t)ceil(p / 100.0 * sorted.size());
+		return sorted[rank > 0 ? rank - 1 : 0];
+	}
+
+	//Times are shown in milliseconds, other values with scale 1
+	static void drawRow(const char* name, vector<double>& values, double scale = 1000.0)
+	{
+		sort(values.begin(), values.end());
+		double mean = 0.0;
+		for (double value : values)
+			mean += value;
+		mean = values.empty() ? 0.0 : mean / values.size();
+
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn();
+		ImGui::TextUnformatted(name);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", mean * scale);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", percentile(values, 50.0) * scale);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", percentile(values, 95.0) * scale);
+		ImGui::TableNextColumn();
+		ImGui::Text("%.3f", percentile(values, 99.0) * scale);
+	}
+
+	static void writeEvent(ofstream& out, const char* name, int thread, double start, double duration)
+	{
+		out << "," << endl << "{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread
+			<< ",\"ts\":" << (long long)(start * 1e6) << ",\"dur\":" << (long long)(duration * 1e6) << "}";
+	}
+
+};
@@ -0,0 +1,109 @@
+#pragma once
+using namespace std;
+
+#include <iterator>
+#include <map>
+
+//Allocator of ranges inside a buffer of a given capacity (in elements, not bytes)
+//Free ranges are kept sorted by offset, allocations take the first range large enough
+//and freed ranges are merged with their neighbours so the space does not fragment
+class FreeListAllocatorV2
+{
+public:
+
+	enum { INVALID_OFFSET = -1 };
+
+	FreeListAllocatorV2(long long capacity = 0)
+	{
+		grow(capacity);
+	}
+
+	//Offset of a free range of the given size, INVALID_OFFSET if there is none
+	long long allocate(long long size)
+	{
+		if (size <= 0)
+			return 0;
+		for (auto range = freeRanges.begin(); range != freeRanges.end(); ++range)
+		{
+			if (range->second < size)
+				continue;
+			long long offset = range->first;
+			long long remaining = range->second - size;
+			freeRanges.erase(range);
+			if (remaining > 0)
+				freeRanges[offset + size] = remaining;
+			used += size;
+			return offset;
+		}
+		return INVALID_OFFSET;
+	}
+
+	//Give back a range returned by allocate
+	void free(long long offset, long long size)
+	{
+		if (size <= 0 || offset == INVALID_OFFSET)
+			return;
+		used -= size;
+
+		auto next = freeRanges.lower_bound(offset);
+		//Merge with the previous range if it ends where this one starts
+		if (next != freeRanges.begin())
+		{
+			auto previous = prev(next);
+			if (previous->first + previous->second == offset)
+			{
+				offset = previous->first;
+				size += previous->second;
+				freeRanges.erase(previous);
+			}
+		}
+		//Merge with the next range if it starts where this one ends
+		if (next != freeRanges.end() && offset + size == next->first)
+		{
+			size += next->second;
+			freeRanges.erase(next);
+		}
+		freeRanges[offset] = size;
+	}
+
+	//Extend the capacity, the ranges already allocated keep their offsets
+	void grow(long long newCapacity)
+	{
+		if (newCapacity <= capacity)
+			return;
+		free(capacity, newCapacity - capacity);
+		used += newCapacity - capacity;
+		capacity = newCapacity;
+	}
+
+	void clear()
+	{
+		freeRanges.clear();
+		capacity = 0;
+		used = 0;
+	}
+
+	long long getCapacity() const
+	{
+		return capacity;
+	}
+
+	long long getUsed() const
+	{
+		return used;
+	}
+
+	//Number of free ranges, 1 (or 0 when full) if the space is not fragmented
+	int getNumFreeRanges() const
+	{
+		return (int)freeRanges.size();
+	}
+
+private:
+
+	//Offset and size of the free ranges
+	map<long long, long long> freeRanges;
+	long long capacity = 0;
+	long long used = 0;
+
+};
@@ -0,0 +1,140 @@
+#pragma once
+using namespace std;
+
+#include <glad/glad.h>
+
+//Counter of the OpenGL calls made by the application
+//glad calls every GL function through a function pointer, so after loading the pointers of
+//the calls made while rendering are replaced with wrappers that count the call and forward it
+//ImGui loads its own pointers, so its calls are not counted
+class GLCallCounterV2
+{
+public:
+
+	//Wrap the GL functions, after gladLoadGL
+	static void install();
+
+	//Clear the counters, usually at the start of every frame
+	static void reset()
+	{
+		calls() = 0;
+		drawCalls() = 0;
+	}
+
+	//GL calls since the last reset, draw calls included
+	static long long getCalls()
+	{
+		return calls();
+	}
+
+	static long long getDrawCalls()
+	{
+		return drawCalls();
+	}
+
+	static void count(bool draw)
+	{
+		calls()++;
+		if (draw)
+			drawCalls()++;
+	}
+
+private:
+
+	static long long& calls()
+	{
+		static long long counter = 0;
+		return counter;
+	}
+
+	static long long& drawCalls()
+	{
+		static long long counter = 0;
+		return counter;
+	}
+
+};
+
+//Wrapper of the glad pointer of a GL function, Draw tells if the function is a draw call
+template <typename Function, Function* Pointer, bool Draw>
+struct GLCountedCallV2;
+
+template <typename R, typename... Args, R (APIENTRY** Pointer)(Args...), bool Draw>
+struct GLCountedCallV2<R (APIENTRY*)(Args...), Pointer, Draw>
+{
+	typedef R (APIENTRY* Function)(Args...);
+
+	static Function& original()
+	{
+		static Function function = 0;
+		return function;
+	}
+
+	static R APIENTRY call(Args... args)
+	{
+		GLCallCounterV2::count(Draw);
+		return original()(args...);
+	}
+
+	static void install()
+	{
+		//Functions not loaded by the context are left alone, as the ones already wrapped
+		if (!*Pointer || *Pointer == &call)
+			return;
+		original() = *Pointer;
+		*Pointer = &call;
+	}
+};
+
+#define GL_COUNT_CALLS(function, draw) GLCountedCallV2<decltype(glad_##function), &glad_##function, draw>::install()
+
+inline void GLCallCounterV2::install()
+{
+	//State and uniforms
+	GL_COUNT_CALLS(glUseProgram, false);
+	GL_COUNT_CALLS(glBindVertexArray, false);
+	GL_COUNT_CALLS(glBindBuffer, false);
+	GL_COUNT_CALLS(glBindBufferBase, false);
+	GL_COUNT_CALLS(glGetUniformLocation, false);
+	GL_COUNT_CALLS(glUniform1i, false);
+	GL_COUNT_CALLS(glUniform1f, false);
+	GL_COUNT_CALLS(glUniform3f, false);
+	GL_COUNT_CALLS(glUniform3fv, false);
+	GL_COUNT_CALLS(glUniform4fv, false);
+	GL_COUNT_CALLS(glUniformMatrix4fv, false);
+	GL_COUNT_CALLS(glUniformBlockBinding, false);
+
+	//Vertex attributes
+	GL_COUNT_CALLS(glVertexAttribPointer, false);
+	GL_COUNT_CALLS(glVertexAttribDivisor, false);
+	GL_COUNT_CALLS(glVertexAttrib3f, false);
+	GL_COUNT_CALLS(glEnableVertexAttribArray, false);
+	GL_COUNT_CALLS(glDisableVertexAttribArray, false);
+
+	//Buffer uploads and synchronization
+	GL_COUNT_CALLS(glBufferData, false);
+	GL_COUNT_CALLS(glBufferSubData, false);
+	GL_COUNT_CALLS(glMapBufferRange, false);
+	GL_COUNT_CALLS(glUnmapBuffer, false);
+	GL_COUNT_CALLS(glFenceSync, false);
+	GL_COUNT_CALLS(glClientWaitSync, false);
+	GL_COUNT_CALLS(glDeleteSync, false);
+
+	//Frame
+	GL_COUNT_CALLS(glClear, false);
+	GL_COUNT_CALLS(glClearColor, false);
+	GL_COUNT_CALLS(glBeginQuery, false);
+	GL_COUNT_CALLS(glEndQuery, false);
+	GL_COUNT_CALLS(glGetQueryObjectiv, false);
+	GL_COUNT_CALLS(glGetQueryObjectui64v, false);
+
+	//Draws
+	GL_COUNT_CALLS(glDrawArrays, true);
+	GL_COUNT_CALLS(glDrawElements, true);
+	GL_COUNT_CALLS(glDrawElementsBaseVertex, true);
+	GL_COUNT_CALLS(glDrawElementsInstanced, true);
+	GL_COUNT_CALLS(glMultiDrawElements, true);
+	GL_COUNT_CALLS(glMultiDrawElementsBaseVertex, true);
+}
+
+#undef GL_COUNT_CALLS
@@ -0,0 +1,142 @@
+#pragma once
+using namespace std;
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include "MeshV2.h"
+
+//Per instance attributes read by Shaders/instanced.vert
+struct InstanceData
+{
+	glm::vec3 Color;
+	glm::mat4 Model;
+};
+
+//Instanced renderer for meshes drawn many times per frame (rigid and static bodies)
+//Instances are collected during the frame, then all of them are uploaded into a single
+//instance buffer and every distinct mesh is drawn with one instanced draw call
+//GL 4.1 has no base instance, so each mesh points its instance attributes at its own range
+class InstanceRendererV2
+{
+public:
+
+	//Instance buffer shared by all the meshes, respecified every frame
+	VBO vbo;
+
+	InstanceRendererV2() {}
+
+	InstanceRendererV2(const InstanceRendererV2&) = delete;
+	InstanceRendererV2& operator=(const InstanceRendererV2&) = delete;
+
+	//Queue an instance of the mesh for the next draw
+	void add(MeshV2& mesh, const glm::mat4& model, const glm::vec3& color)
+	{
+		Batch* batch = 0;
+		for (size_t i = 0; i < numBatches && !batch; i++)
+			if (batches[i].mesh == &mesh)
+				batch = &batches[i];
+		if (!batch)
+		{
+			//Batches are reused between frames to keep the instance vectors capacity
+			if (numBatches == batches.size())
+				batches.emplace_back();
+			batch = &batches[numBatches++];
+			batch->mesh = &mesh;
+			batch->instances.clear();
+		}
+		batch->instances.push_back({ color, model });
+	}
+
+	//Upload the queued instances and draw them, one draw call per mesh
+	//The camera comes from the Camera uniform buffer
+	void draw(Shader& shader)
+	{
+		size_t numInstances = 0;
+		for (size_t i = 0; i < numBatches; i++)
+			numInstances += batches[i].instances.size();
+		if (numInstances == 0)
+		{
+			numBatches = 0;
+			return;
+		}
+
+		//Orphan the buffer so the draws of the last frame are not waited for
+		vbo.Bind();
+		GLsizeiptr size = numInstances * sizeof(InstanceData);
+		if (size > capacity)
+			capacity = size * 2;
+		glBufferData(GL_ARRAY_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+		unsigned char* data = (unsigned char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, size,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if (!data)
+		{
+			vbo.Unbind();
+			numBatches = 0;
+			return;
+		}
+		GLsizeiptr offset = 0;
+		for (size_t i = 0; i < numBatches; i++)
+		{
+			const vector<InstanceData>& instances = batches[i].instances;
+			memcpy(data + offset, instances.data(), instances.size() * sizeof(InstanceData));
+			offset += instances.size() * sizeof(InstanceData);
+		}
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		vbo.Unbind();
+
+		shader.Use();
+
+		offset = 0;
+		for (size_t i = 0; i < numBatches; i++)
+		{
+			MeshV2& mesh = *batches[i].mesh;
+			GLsizei count = batches[i].instances.size();
+
+			mesh.vao.Bind();
+			linkInstanceAttributes(mesh.vao, offset);
+			glDrawElementsInstanced(GL_TRIANGLES, mesh.indices.size(), GL_UNSIGNED_INT, 0, count);
+			mesh.vao.Unbind();
+
+			offset += count * sizeof(InstanceData);
+		}
+
+		numBatches = 0;
+	}
+
+	void Delete()
+	{
+		vbo.Delete();
+		batches.clear();
+		numBatches = 0;
+		capacity = 0;
+	}
+
+private:
+
+	struct Batch
+	{
+		MeshV2* mesh = 0;
+		vector<InstanceData> instances;
+	};
+
+	vector<Batch> batches;
+	size_t numBatches = 0;
+	GLsizeiptr capacity = 0;
+
+	//Colour at location 3 and the model matrix columns at locations 4 to 7, advancing once per instance
+	void linkInstanceAttributes(VAO& vao, GLsizeiptr offset)
+	{
+		const GLsizeiptr stride = sizeof(InstanceData);
+		vao.LinkAttribute(vbo, 3, 3, GL_FLOAT, stride, (void*)(offset + offsetof(InstanceData, Color)));
+		glVertexAttribDivisor(3, 1);
+		for (GLuint column = 0; column < 4; column++)
+		{
+			vao.LinkAttribute(vbo, 4 + column, 4, GL_FLOAT, stride,
+				(void*)(offset + offsetof(InstanceData, Model) + column * sizeof(glm::vec4)));
+			glVertexAttribDivisor(4 + column, 1);
+		}
+	}
+
+};
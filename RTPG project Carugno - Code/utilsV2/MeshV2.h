@@ -7,6 +7,13 @@ using namespace std;
 #include "EBO.h"
 #include "CamV2.h"
 
+//Mesh data on the CPU side only, before (or without) creating its GPU buffers
+struct MeshDataV2
+{
+	vector<Vertex> vertices;
+	vector<GLuint> indices;
+};
+
 class MeshV2
 {
 public:
@@ -14,117 +21,50 @@ public:
 	vector<Vertex> vertices;
 	vector<GLuint> indices;
 
-    VAO VAO;
-
-    //VBO VBO;
-    //EBO EBO;
+    //GPU buffers are owned by the mesh, so a mesh can be moved but not copied
+    VAO vao;
+    VBO vbo;
+    EBO ebo;
 
     //////////////////////////////////////////////////////////////
     //V1
 
     //Mesh constructor
-    MeshV2(vector<Vertex>& vertices, vector<GLuint>& indices) //: VBO(vertices), EBO(indices)
+    //Pass the vectors with std::move to avoid copying them
+    MeshV2(vector<Vertex> vertices, vector<GLuint> indices) :
+        vertices(std::move(vertices)), indices(std::move(indices)), vbo(this->vertices)
     {
 
-        this->vertices = vertices;
-        this->indices = indices;
-
-        VAO.Bind();
+        vao.Bind();
 
-        VBO VBO(vertices);
-        EBO EBO(indices);
+        //Filled while the VAO is bound so the VAO keeps it as element buffer
+        ebo.Data(this->indices);
 
-        VAO.LinkAttribute(VBO, 0, 3, GL_FLOAT, sizeof(Vertex), (void*)0);
-        VAO.LinkAttribute(VBO, 1, 3, GL_FLOAT, sizeof(Vertex), (void*)(3 * sizeof(float)));
-        VAO.LinkAttribute(VBO, 2, 3, GL_FLOAT, sizeof(Vertex), (void*)(6 * sizeof(float)));
+        vao.LinkAttribute(vbo, 0, 3, GL_FLOAT, sizeof(Vertex), (void*)0);
+        vao.LinkAttribute(vbo, 1, 3, GL_FLOAT, sizeof(Vertex), (void*)(3 * sizeof(float)));
+        vao.LinkAttribute(vbo, 2, 3, GL_FLOAT, sizeof(Vertex), (void*)(6 * sizeof(float)));
 
-        VAO.Unbind();
+        vao.Unbind();
         //
-        VBO.Unbind();
-        EBO.Unbind();
+        vbo.Unbind();
+        ebo.Unbind();
 
     }
+
+    MeshV2(const MeshV2&) = delete;
+    MeshV2& operator=(const MeshV2&) = delete;
+    MeshV2(MeshV2&&) = default;
+    MeshV2& operator=(MeshV2&&) = default;
     
-    //Mesh rendering
-    void Draw(Shader& shader, CamV2& camera, 
+    //Mesh rendering, the camera comes from the Camera uniform buffer
+    void Draw(Shader& shader, 
         glm::mat4 matrix = glm::mat4(1.0f),
         glm::vec3 translation = glm::vec3(0.0f, 0.0f, 0.0f), 
         glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), 
         glm::vec3 scale = glm::vec3(1.0f, 1.0f, 1.0f))
     {
         shader.Use();
-        VAO.Bind();
-
-        glUniform3f(glGetUniformLocation(shader.Program, "camPos"),
-            camera.Position.x, camera.Position.y, camera.Position.z);
-        camera.Matrix(shader, "camMatrix");
-
-        glm::mat4 trans = glm::mat4(1.0f);
-        glm::mat4 rot = glm::mat4(1.0f);
-        glm::mat4 sca = glm::mat4(1.0f);
-
-        trans = glm::translate(trans, translation);
-        rot = glm::mat4_cast(rotation);
-        sca = glm::scale(sca, scale);
-
-        glUniformMatrix4fv(glGetUniformLocation(shader.Program, "translation"), 
-            1, GL_FALSE, glm::value_ptr(trans));
-        glUniformMatrix4fv(glGetUniformLocation(shader.Program, "rotation"), 
-            1, GL_FALSE, glm::value_ptr(rot));
-        glUniformMatrix4fv(glGetUniformLocation(shader.Program, "scale"), 
-            1, GL_FALSE, glm::value_ptr(sca));
-        glUniformMatrix4fv(glGetUniformLocation(shader.Program, "model"), 
-            1, GL_FALSE, glm::value_ptr(matrix));
-
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-
-    }
-
-    //////////////////////////////////////////////////////////////////////////////////////////////
-    //Updated, improved and optimized version
-    
-    //V2
-    MeshV2(vector<Vertex>& vertices, vector<GLuint>& indices, int dummy)
-    {
-        this->vertices = vertices;
-        this->indices = indices;
-    }
-
-    void drawV2(Shader& shader, CamV2& camera,
-        glm::mat4 matrix = glm::mat4(1.0f),
-        glm::vec3 translation = glm::vec3(0.0f, 0.0f, 0.0f),
-        glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
-        glm::vec3 scale = glm::vec3(1.0f, 1.0f, 1.0f))
-    {
-        //Create a VAO and bind it
-        VAO;
-        VAO.Bind();
-
-        //Create a VBO and bind it
-        VBO vbo(vertices);
-        vbo.Bind();
-
-        //Create an EBO and bind it
-        EBO ebo(indices);
-        ebo.Bind();
-
-        //Set the vertex attribute pointers for the VBO
-        VAO.LinkAttribute(vbo, 0, 3, GL_FLOAT, sizeof(Vertex), (void*)0);
-        VAO.LinkAttribute(vbo, 1, 3, GL_FLOAT, sizeof(Vertex), (void*)(3 * sizeof(float)));
-        VAO.LinkAttribute(vbo, 2, 3, GL_FLOAT, sizeof(Vertex), (void*)(6 * sizeof(float)));
-
-        //Unbind the VAO, VBO, and EBO
-        VAO.Unbind();
-        vbo.Unbind();
-        ebo.Unbind();
-
-        //Use the shader program and bind the VAO
-        shader.Use();
-        VAO.Bind();
-
-        glUniform3f(glGetUniformLocation(shader.Program, "camPos"),
-            camera.Position.x, camera.Position.y, camera.Position.z);
-        camera.Matrix(shader, "camMatrix");
+        vao.Bind();
 
         glm::mat4 trans = glm::mat4(1.0f);
         glm::mat4 rot = glm::mat4(1.0f);
@@ -134,26 +74,12 @@ public:
         rot = glm::mat4_cast(rotation);
         sca = glm::scale(sca, scale);
 
-        glUniformMatrix4fv(glGetUniformLocation(shader.Program, "translation"),
-            1, GL_FALSE, glm::value_ptr(trans));
-        glUniformMatrix4fv(glGetUniformLocation(shader.Program, "rotation"),
-            1, GL_FALSE, glm::value_ptr(rot));
-        glUniformMatrix4fv(glGetUniformLocation(shader.Program, "scale"),
-            1, GL_FALSE, glm::value_ptr(sca));
-        glUniformMatrix4fv(glGetUniformLocation(shader.Program, "model"),
-            1, GL_FALSE, glm::value_ptr(matrix));
+        //The shader takes a single model matrix, combined here once per draw
+        glm::mat4 model = matrix * trans * rot * sca;
+        shader.setMat4("model", model);
 
-        //Draw the mesh using the indices stored in the EBO
         glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
 
-        //Unbind the VAO
-        VAO.Unbind();
-
-        //Delete the VAO, VBO, and EBO to clean up resources
-        VAO.Delete();
-        vbo.Delete();
-        ebo.Delete();
-
     }
 
 };
\ No newline at end of file
@@ -0,0 +1,339 @@
+#pragma once
+using namespace std;
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <btBulletDynamicsCommon.h>
+
+#include "MeshV2.h"
+
+//Read-only memory mapping of a whole file
+//Other handles can still write the file while it is mapped, the writes are seen through the mapping
+class MappedFileV2
+{
+public:
+
+	const unsigned char* data = 0;
+	size_t size = 0;
+
+	MappedFileV2() {}
+
+	MappedFileV2(const MappedFileV2&) = delete;
+	MappedFileV2& operator=(const MappedFileV2&) = delete;
+
+	~MappedFileV2()
+	{
+		close();
+	}
+
+	bool open(const string& path)
+	{
+		close();
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		{
+			close();
+			return false;
+		}
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (!mapping)
+		{
+			close();
+			return false;
+		}
+		data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		size = (size_t)fileSize.QuadPart;
+#else
+		file = ::open(path.c_str(), O_RDONLY);
+		if (file < 0)
+			return false;
+		struct stat info;
+		if (fstat(file, &info) != 0 || info.st_size == 0)
+		{
+			close();
+			return false;
+		}
+		void* view = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		data = view == MAP_FAILED ? 0 : (const unsigned char*)view;
+		size = info.st_size;
+#endif
+		if (!data)
+		{
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close()
+	{
+#ifdef _WIN32
+		if (data)
+			UnmapViewOfFile(data);
+		if (mapping)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+		mapping = NULL;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (data)
+			munmap((void*)data, size);
+		if (file >= 0)
+			::close(file);
+		file = -1;
+#endif
+		data = 0;
+		size = 0;
+	}
+
+private:
+
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+#else
+	int file = -1;
+#endif
+
+};
+
+//Binary cache of an imported model, stored next to the source file (path + ".cache")
+//It keeps the merged vertices and indices and the vertices and indices of every mesh,
+//so neither Assimp nor the weld have to run again while the source file is unchanged
+//
+//Layout (little endian, 4 bytes aligned):
+//Header | per mesh {vertices count, indices count} | merged vertices (x, y, z floats)
+//| merged indices | for every mesh {Vertex array, indices}
+class ModelCacheV2
+{
+public:
+
+	//Bump when the layout or the import pipeline changes
+	static const uint32_t VERSION = 2;
+
+	static string cachePath(const string& path)
+	{
+		return path + ".cache";
+	}
+
+	//Map the cache of the model, false if it is missing, corrupted or outdated
+	bool open(const string& path, float weldEpsilon)
+	{
+		SourceStamp stamp;
+		if (!getStamp(path, stamp))
+			return false;
+
+		if (!file.open(cachePath(path)) || file.size < sizeof(Header))
+			return false;
+
+		memcpy(&header, file.data, sizeof(Header));
+		if (memcmp(header.magic, MAGIC, sizeof(header.magic)) != 0 ||
+			header.version != VERSION ||
+			header.vertexSize != sizeof(Vertex) ||
+			header.weldEpsilon != weldEpsilon ||
+			header.sourceSize != stamp.size)
+		{
+			file.close();
+			return false;
+		}
+
+		//Same size but different modification time: the content decides
+		if (header.sourceMtime != stamp.mtime)
+		{
+			if (hashFile(path) != header.sourceHash)
+			{
+				file.close();
+				return false;
+			}
+			//Content unchanged, refresh the time so the hash is not computed again next time
+			int64_t mtime = stamp.mtime;
+			fstream out(cachePath(path), ios::in | ios::out | ios::binary);
+			if (out)
+			{
+				out.seekp(offsetof(Header, sourceMtime));
+				out.write((const char*)&mtime, sizeof(mtime));
+				out.flush();
+			}
+			//The cache is still valid, only the hash is computed again at the next start
+			if (!out)
+				cout << "WARNING::MODEL_CACHE::could not refresh the source time in " << cachePath(path) << endl;
+		}
+
+		//Locate every section and check that the file is not truncated
+		size_t offset = sizeof(Header);
+		meshCounts = offset;
+		offset += header.numMeshes * 2 * sizeof(uint32_t);
+		if (offset > file.size)
+		{
+			file.close();
+			return false;
+		}
+		mergedVertices = offset;
+		offset += header.numVertices * 3 * sizeof(float);
+		mergedIndices = offset;
+		offset += header.numIndices * sizeof(uint32_t);
+		meshOffsets.clear();
+		for (uint32_t i = 0; i < header.numMeshes; i++)
+		{
+			meshOffsets.push_back(offset);
+			offset += getNumMeshVertices(i) * sizeof(Vertex) + getNumMeshIndices(i) * sizeof(uint32_t);
+		}
+		if (offset != file.size)
+		{
+			file.close();
+			return false;
+		}
+
+		return true;
+	}
+
+	size_t getNumVertices() { return header.numVertices; }
+	size_t getNumIndices() { return header.numIndices; }
+	size_t getNumMeshes() { return header.numMeshes; }
+
+	//Merged vertices as x, y, z triples
+	const float* getVertices() { return (const float*)(file.data + mergedVertices); }
+	const GLuint* getIndices() { return (const GLuint*)(file.data + mergedIndices); }
+
+	size_t getNumMeshVertices(size_t mesh) { return ((const uint32_t*)(file.data + meshCounts))[mesh * 2]; }
+	size_t getNumMeshIndices(size_t mesh) { return ((const uint32_t*)(file.data + meshCounts))[mesh * 2 + 1]; }
+	const Vertex* getMeshVertices(size_t mesh) { return (const Vertex*)(file.data + meshOffsets[mesh]); }
+	const GLuint* getMeshIndices(size_t mesh) { return (const GLuint*)(file.data + meshOffsets[mesh] + getNumMeshVertices(mesh) * sizeof(Vertex)); }
+
+	//Write the cache of the model, false if it could not be written
+	static bool write(const string& path, float weldEpsilon, const vector<MeshDataV2>& meshes,
+		const vector<btVector3>& vertices, const vector<GLuint>& indices)
+	{
+		SourceStamp stamp;
+		if (!getStamp(path, stamp))
+			return false;
+
+		Header header{};
+		memcpy(header.magic, MAGIC, sizeof(header.magic));
+		header.version = VERSION;
+		header.vertexSize = sizeof(Vertex);
+		header.weldEpsilon = weldEpsilon;
+		header.sourceSize = stamp.size;
+		header.sourceMtime = stamp.mtime;
+		header.sourceHash = hashFile(path);
+		header.numVertices = vertices.size();
+		header.numIndices = indices.size();
+		header.numMeshes = meshes.size();
+
+		ofstream out(cachePath(path), ios::binary | ios::trunc);
+		if (!out)
+			return false;
+
+		out.write((const char*)&header, sizeof(header));
+		for (const MeshDataV2& mesh : meshes)
+		{
+			uint32_t counts[2] = { (uint32_t)mesh.vertices.size(), (uint32_t)mesh.indices.size() };
+			out.write((const char*)counts, sizeof(counts));
+		}
+		for (const btVector3& vertex : vertices)
+		{
+			float xyz[3] = { (float)vertex.x(), (float)vertex.y(), (float)vertex.z() };
+			out.write((const char*)xyz, sizeof(xyz));
+		}
+		out.write((const char*)indices.data(), indices.size() * sizeof(GLuint));
+		for (const MeshDataV2& mesh : meshes)
+		{
+			out.write((const char*)mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+			out.write((const char*)mesh.indices.data(), mesh.indices.size() * sizeof(GLuint));
+		}
+
+		return out.good();
+	}
+
+private:
+
+	static constexpr const char* MAGIC = "RTPGMDL";
+
+	struct Header
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t vertexSize;
+		float weldEpsilon;
+		uint32_t numMeshes;
+		uint64_t sourceSize;
+		int64_t sourceMtime;
+		uint64_t sourceHash;
+		uint32_t numVertices;
+		uint32_t numIndices;
+	};
+
+	struct SourceStamp
+	{
+		uint64_t size;
+		int64_t mtime;
+	};
+
+	MappedFileV2 file;
+	Header header{};
+	size_t meshCounts = 0;
+	size_t mergedVertices = 0;
+	size_t mergedIndices = 0;
+	vector<size_t> meshOffsets;
+
+	static bool getStamp(const string& path, SourceStamp& stamp)
+	{
+#ifdef _WIN32
+		struct _stat64 info;
+		if (_stat64(path.c_str(), &info) != 0)
+			return false;
+#else
+		struct stat info;
+		if (stat(path.c_str(), &info) != 0)
+			return false;
+#endif
+		stamp.size = info.st_size;
+		stamp.mtime = info.st_mtime;
+		return true;
+	}
+
+	//FNV-1a hash of the file content
+	static uint64_t hashFile(const string& path)
+	{
+		uint64_t hash = 14695981039346656037ULL;
+		ifstream in(path, ios::binary);
+		char buffer[65536];
+		while (in.read(buffer, sizeof(buffer)) || in.gcount() > 0)
+		{
+			streamsize count = in.gcount();
+			for (streamsize i = 0; i < count; i++)
+			{
+				hash ^= (unsigned char)buffer[i];
+				hash *= 1099511628211ULL;
+			}
+		}
+		return hash;
+	}
+
+};
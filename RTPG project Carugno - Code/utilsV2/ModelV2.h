@@ -1,6 +1,14 @@
 #pragma once
 using namespace std;
 
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <unordered_map>
+
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -9,6 +17,7 @@ using namespace std;
 #include <BulletSoftBody/btSoftBody.h>
 
 #include "../utilsV2/MeshV2.h"
+#include "../utilsV2/ModelCacheV2.h"
 
 
 class ModelV2
@@ -23,24 +32,107 @@ public:
 	vector<btVector3> vertices;
 	vector<GLuint> indices;
 
-	ModelV2(const string& path)
+	//Vertices closer than this on every axis are welded together (0 means exact match)
+	//Without createMeshes only the merged vertices and indices are loaded and no GPU buffer
+	//is created, so the model can be used without an OpenGL context (e.g. headless tools)
+	ModelV2(const string& path, float weldEpsilon = 0.0f, bool createMeshes = true)
+	{
+		auto startTime = chrono::high_resolution_clock::now();
+
+		//Use the pre-baked cache when the source file has not changed
+		ModelCacheV2 cache;
+		if (cache.open(path, weldEpsilon))
+		{
+			loadCache(cache, createMeshes);
+		}
+		else
+		{
+			//Load model from .obj file
+			vector<MeshDataV2> meshesData;
+			loadModel(path, meshesData);
+
+			////////////////////////////////////////////////////////
+			//Merge the meshes into one unique mesh to improve performance at runtime
+			//Doing it here exactly when loading the model saves computing time later
+			//Complexity O(n)
+			mergeMeshes(meshesData, &vertices, &indices, weldEpsilon);
+
+			//Bake the result for the next start (unless the import failed)
+			if (!meshesData.empty() && !ModelCacheV2::write(path, weldEpsilon, meshesData, vertices, indices))
+				cout << "WARNING::MODEL_CACHE::could not write " << ModelCacheV2::cachePath(path) << endl;
+
+			//GPU buffers are created last, the data is moved into the meshes
+			if (createMeshes)
+				for (MeshDataV2& meshData : meshesData)
+					meshes.emplace_back(std::move(meshData.vertices), std::move(meshData.indices));
+		}
+
+		auto loadTime = chrono::duration_cast<chrono::duration<double, milli>>(chrono::high_resolution_clock::now() - startTime);
+		cout << "Loaded " << path << ": " << vertices.size() << " merged vertices, " << indices.size()
+			<< " merged indices in " << loadTime.count() << " ms" << endl;
+	}
+
+	//Meshes own GPU buffers, pass models by reference
+	ModelV2(const ModelV2&) = delete;
+	ModelV2& operator=(const ModelV2&) = delete;
+	ModelV2(ModelV2&&) = default;
+	ModelV2& operator=(ModelV2&&) = default;
+
+	//Free the GPU buffers of the meshes, the merged vertices and indices are kept
+	//Must be called while the OpenGL context is still current
+	void Delete()
 	{
-		//Load model from .obj file
-		loadModel(path);
-
-		////////////////////////////////////////////////////////
-		//Merge the meshes into one unique mesh to improve performance at runtime
-		//Doing it here exactly when loading the model saves computing time later
-		//Complexity O(n^2)
-		mergeMeshes(meshes, &vertices, &indices);
-		//Complexity O(n)
-		//mergeMeshes2(meshes, &vertices, &indices);
+		meshes.clear();
+	}
+
+	//Loading stages without the cache and the GPU buffers, timed one by one by the load benchmark
+	static void importMeshes(const string& path, vector<MeshDataV2>& meshesData)
+	{
+		loadModel(path, meshesData);
+	}
+
+	static void weldMeshes(const vector<MeshDataV2>& meshes, vector<btVector3>* verts, vector<GLuint>* indxs, float epsilon)
+	{
+		mergeMeshes(meshes, verts, indxs, epsilon);
+	}
+
+	//Reference weld of all the indices one after the other on a single thread, mergeMeshes gives the same result
+	static void weldMeshesSerial(const vector<MeshDataV2>& meshes, vector<btVector3>* verts, vector<GLuint>* indxs, float epsilon)
+	{
+		VertexWelder welder(epsilon);
+		indxs->clear();
+		for (const MeshDataV2& mesh : meshes)
+			for (GLuint index : mesh.indices)
+				indxs->push_back(welder.insert(mesh.vertices[index].Position));
+		verts->clear();
+		for (const glm::vec3& point : welder.points)
+			verts->push_back(btVector3(point.x, point.y, point.z));
 	}
 
 private:
 
+	//Model loading from the binary cache
+	void loadCache(ModelCacheV2& cache, bool createMeshes)
+	{
+		const float* cachedVertices = cache.getVertices();
+		vertices.reserve(cache.getNumVertices());
+		for (size_t i = 0; i < cache.getNumVertices(); i++)
+			vertices.push_back(btVector3(cachedVertices[i * 3], cachedVertices[i * 3 + 1], cachedVertices[i * 3 + 2]));
+		indices.assign(cache.getIndices(), cache.getIndices() + cache.getNumIndices());
+
+		if (!createMeshes)
+			return;
+
+		for (size_t i = 0; i < cache.getNumMeshes(); i++)
+		{
+			vector<Vertex> meshVertices(cache.getMeshVertices(i), cache.getMeshVertices(i) + cache.getNumMeshVertices(i));
+			vector<GLuint> meshIndices(cache.getMeshIndices(i), cache.getMeshIndices(i) + cache.getNumMeshIndices(i));
+			meshes.emplace_back(std::move(meshVertices), std::move(meshIndices));
+		}
+	}
+
 	//Model loading using recursion
-	void loadModel(string path)
+	static void loadModel(string path, vector<MeshDataV2>& meshesData)
 	{
 		Assimp::Importer importer;
 		const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_GenSmoothNormals | aiProcess_FixInfacingNormals | aiProcess_FindDegenerates | aiProcess_FindInstances);
@@ -51,25 +143,25 @@ private:
 			return;
 		}
 
-		processNode(scene->mRootNode, scene);
+		processNode(scene->mRootNode, scene, meshesData);
 
 	}
 
-	void processNode(aiNode* node, const aiScene* scene) {
+	static void processNode(aiNode* node, const aiScene* scene, vector<MeshDataV2>& meshesData) {
 		//Process all the node's meshes (if any)
 		for (GLuint i = 0; i < node->mNumMeshes; i++)
 		{
 			aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-			meshes.emplace_back(processMesh(mesh));
+			meshesData.emplace_back(processMesh(mesh));
 		}
 		//Then do the same for each of its children
 		for (GLuint i = 0; i < node->mNumChildren; i++)
 		{
-			processNode(node->mChildren[i], scene);
+			processNode(node->mChildren[i], scene, meshesData);
 		}
 	}
 	
-	MeshV2 processMesh(aiMesh* mesh) {
+	static MeshDataV2 processMesh(aiMesh* mesh) {
 		vector<Vertex> vertices;
 		vector<GLuint> indices;
 
@@ -103,69 +195,209 @@ private:
 				indices.emplace_back(face.mIndices[j]);
 		}
 
-		//We return an instance of the Mesh class created using the vertices and faces data structures we have created above.
-		return MeshV2(vertices, indices);
+		//We return the mesh data created using the vertices and faces data structures we have created above.
+		return MeshDataV2{ std::move(vertices), std::move(indices) };
 
 	}
 
 	///////////////////////////////////////////////////////////////
-	//Function to merge meshes into a unique one
-	//Complexity is O(n^2)
-	void mergeMeshes(vector<MeshV2> meshes, vector<btVector3>* verts, vector<GLuint>* indxs)
+	//Vertex welding
+
+	//Number of indices welded by a single task
+	static const size_t WELD_CHUNK_SIZE = 16384;
+
+	//Spatial hash of welded positions
+	//With epsilon 0 a cell is the exact bit pattern of a position, otherwise the
+	//space is split into cubes of side epsilon and the neighbouring cells are searched too
+	class VertexWelder
 	{
+	public:
 
-		//For a cube 8 vertices and 36 indices!
-		vector<btVector3> vertices;
+		//Welded positions in order of first insertion
+		vector<glm::vec3> points;
+
+		VertexWelder(float epsilon) : epsilon(epsilon) {}
+
+		//Return the index of the welded position, adding it if no position is close enough
+		GLuint insert(const glm::vec3& position)
+		{
+			Cell cell = toCell(position);
+			int found = -1;
+
+			if (epsilon > 0.0f)
+			{
+				for (int dx = -1; dx <= 1; dx++)
+					for (int dy = -1; dy <= 1; dy++)
+						for (int dz = -1; dz <= 1; dz++)
+							found = findInCell({ cell.x + dx, cell.y + dy, cell.z + dz }, position, found);
+			}
+			else
+			{
+				found = findInCell(cell, position, found);
+			}
+
+			if (found != -1)
+				return found;
+
+			//New position, push it at the head of its cell chain
+			GLuint index = points.size();
+			points.push_back(position);
+			auto head = heads.find(cell);
+			if (head == heads.end())
+			{
+				next.push_back(NONE);
+				heads.emplace(cell, index);
+			}
+			else
+			{
+				next.push_back(head->second);
+				head->second = index;
+			}
+			return index;
+		}
+
+	private:
+
+		struct Cell
+		{
+			long long x, y, z;
+			bool operator==(const Cell& cell) const { return x == cell.x && y == cell.y && z == cell.z; }
+		};
+
+		struct CellHash
+		{
+			size_t operator()(const Cell& cell) const
+			{
+				return (size_t)(cell.x * 73856093LL ^ cell.y * 19349663LL ^ cell.z * 83492791LL);
+			}
+		};
+
+		enum : GLuint { NONE = 0xFFFFFFFF };
+
+		float epsilon;
+		unordered_map<Cell, GLuint, CellHash> heads;
+		vector<GLuint> next;
+
+		Cell toCell(const glm::vec3& position)
+		{
+			if (epsilon > 0.0f)
+				return { (long long)floor(position.x / epsilon), (long long)floor(position.y / epsilon), (long long)floor(position.z / epsilon) };
+			return { floatBits(position.x), floatBits(position.y), floatBits(position.z) };
+		}
+
+		//-0.0f and 0.0f compare equal so they must fall in the same cell
+		static long long floatBits(float value)
+		{
+			if (value == 0.0f)
+				value = 0.0f;
+			uint32_t bits;
+			memcpy(&bits, &value, sizeof(bits));
+			return bits;
+		}
+
+		//Lowest index of a matching position in the cell (keeps the result of a linear search)
+		int findInCell(const Cell& cell, const glm::vec3& position, int found)
+		{
+			auto head = heads.find(cell);
+			if (head == heads.end())
+				return found;
+			for (GLuint k = head->second; k != NONE; k = next[k])
+			{
+				const glm::vec3& point = points[k];
+				bool match = epsilon > 0.0f ?
+					(fabs(point.x - position.x) <= epsilon && fabs(point.y - position.y) <= epsilon && fabs(point.z - position.z) <= epsilon) :
+					(point.x == position.x && point.y == position.y && point.z == position.z);
+				if (match && (found == -1 || (int)k < found))
+					found = k;
+			}
+			return found;
+		}
+	};
+
+	//Range of indices of a mesh welded on its own
+	//Only the exact duplicates are merged inside a chunk: a position within epsilon of another one of the chunk
+	//may be closer to a position of an earlier chunk, so the epsilon is applied when the chunks are merged
+	struct WeldChunk
+	{
+		unsigned int mesh;
+		size_t begin;
+		size_t end;
+
+		//Distinct positions of the chunk in order of first use and indices referring to them
+		vector<glm::vec3> points;
 		vector<GLuint> indices;
 
-		//Mapping between the indices of the old vertices vector and the indices of the new vertices vector
+		void weld(const MeshDataV2& source)
+		{
+			VertexWelder welder(0.0f);
+			indices.reserve(end - begin);
+			for (size_t j = begin; j < end; j++)
+				indices.push_back(welder.insert(source.vertices[source.indices[j]].Position));
+			points = move(welder.points);
+		}
+	};
+
+	///////////////////////////////////////////////////////////////
+	//Function to merge meshes into a unique one
+	//Complexity is O(n) thanks to the spatial hash
+	//Exact duplicates are removed from chunks of indices in parallel, then the distinct positions of the chunks
+	//are welded with epsilon in order. Equal positions always get the same index when welding all the indices
+	//one after the other, so the result is the same as weldMeshesSerial, with any epsilon
+	static void mergeMeshes(const vector<MeshDataV2>& meshes, vector<btVector3>* verts, vector<GLuint>* indxs, float epsilon)
+	{
+		//Split every mesh into chunks
+		vector<WeldChunk> chunks;
+		size_t numIndices = 0;
 		for (unsigned int i = 0; i < meshes.size(); i++)
 		{
-			// Loop through the indices of the current mesh
-			for (unsigned int j = 0; j < meshes[i].indices.size(); j++)
+			for (size_t begin = 0; begin < meshes[i].indices.size(); begin += WELD_CHUNK_SIZE)
 			{
-				// Find the index of the vertex in the combined vertices array
-				int index = -1;
-				for (int k = 0; k < vertices.size(); k++)
-				{
-					if (vertices[k].x() == meshes[i].vertices[meshes[i].indices[j]].Position.x &&
-						vertices[k].y() == meshes[i].vertices[meshes[i].indices[j]].Position.y &&
-						vertices[k].z() == meshes[i].vertices[meshes[i].indices[j]].Position.z
-						)
-					{
-						index = k;
-						break;
-					}
-				}
-				//If the vertex was not found in the combined vertices array, add it
-				if (index == -1)
-				{
-					btVector3 vertex(
-						meshes[i].vertices[meshes[i].indices[j]].Position.x,
-						meshes[i].vertices[meshes[i].indices[j]].Position.y,
-						meshes[i].vertices[meshes[i].indices[j]].Position.z
-					);
-					vertices.push_back(vertex);
-					index = vertices.size() - 1;
-				}
-
-				//Add the index of the vertex to the combined indices array
-				indices.push_back(index);
-
-				cout << "Merging index " << j << " of mesh " << i << endl;
-
+				WeldChunk chunk;
+				chunk.mesh = i;
+				chunk.begin = begin;
+				chunk.end = min(begin + WELD_CHUNK_SIZE, meshes[i].indices.size());
+				chunks.push_back(chunk);
 			}
+			numIndices += meshes[i].indices.size();
 		}
 
-		*verts = vertices;
-		*indxs = indices;
+		//Weld the chunks in parallel
+		atomic<size_t> nextChunk(0);
+		auto worker = [&]()
+		{
+			for (size_t c = nextChunk++; c < chunks.size(); c = nextChunk++)
+				chunks[c].weld(meshes[chunks[c].mesh]);
+		};
+		unsigned int numThreads = min<size_t>(max(thread::hardware_concurrency(), 1u), chunks.size());
+		vector<thread> threads;
+		for (unsigned int t = 1; t < numThreads; t++)
+			threads.emplace_back(worker);
+		worker();
+		for (thread& t : threads)
+			t.join();
+
+		//Merge the chunks in order
+		VertexWelder welder(epsilon);
+		vector<GLuint> indices;
+		indices.reserve(numIndices);
+		vector<GLuint> remap;
+		for (WeldChunk& chunk : chunks)
+		{
+			remap.resize(chunk.points.size());
+			for (size_t k = 0; k < chunk.points.size(); k++)
+				remap[k] = welder.insert(chunk.points[k]);
+			for (GLuint index : chunk.indices)
+				indices.push_back(remap[index]);
+		}
 
-		cout << vertices.size() << "merged Vertices" << endl;
-		cout << indices.size() << "merged Indices" << endl;
+		//For a cube 8 vertices and 36 indices!
+		vector<btVector3> vertices;
+		vertices.reserve(welder.points.size());
+		for (const glm::vec3& point : welder.points)
+			vertices.push_back(btVector3(point.x, point.y, point.z));
 
+		*verts = move(vertices);
+		*indxs = move(indices);
 	}
 
-	/////////////////////////////////////////////////////////////////////
-	//To achieve complexity O(n) an unorderep map must be used!
-
 };
@@ -0,0 +1,170 @@
+#pragma once
+using namespace std;
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include <LinearMath/btQuickprof.h>
+
+//Time spent by Bullet in the phases of a simulation step
+//Bullet marks its internal functions with BT_PROFILE zones, they are collected here
+//through the custom enter and leave hooks of btQuickprof and summed by phase
+//Only the zones of the thread that installed the profiler are timed
+class PhysicsProfilerV2
+{
+public:
+
+	enum Phase
+	{
+		PREDICT_MOTION,
+		COLLISION,
+		SOLVE_CONSTRAINTS,
+		INTEGRATE,
+		NUM_PHASES
+	};
+
+	PhysicsProfilerV2() {}
+
+	PhysicsProfilerV2(const PhysicsProfilerV2&) = delete;
+	PhysicsProfilerV2& operator=(const PhysicsProfilerV2&) = delete;
+
+	~PhysicsProfilerV2()
+	{
+		uninstall();
+	}
+
+	static const char* getPhaseName(int phase)
+	{
+		static const char* names[NUM_PHASES] = { "predictMotion", "collision", "solveConstraints", "integrate" };
+		return names[phase];
+	}
+
+	//Start collecting the zones of the calling thread (one profiler at a time)
+	void install()
+	{
+		if (active() == this)
+			return;
+		uninstall();
+		owner = this_thread::get_id();
+		previousEnter = btGetCurrentEnterProfileZoneFunc();
+		previousLeave = btGetCurrentLeaveProfileZoneFunc();
+		active() = this;
+		btSetCustomEnterProfileZoneFunc(enterZone);
+		btSetCustomLeaveProfileZoneFunc(leaveZone);
+	}
+
+	void uninstall()
+	{
+		if (active() != this)
+			return;
+		btSetCustomEnterProfileZoneFunc(previousEnter);
+		btSetCustomLeaveProfileZoneFunc(previousLeave);
+		active() = 0;
+	}
+
+	//Clear the phase times, usually before every step
+	void reset()
+	{
+		for (int i = 0; i < NUM_PHASES; i++)
+			phaseTimes[i] = 0.0;
+	}
+
+	//Seconds spent in the phase since the last reset
+	double getPhaseTime(int phase) const
+	{
+		return phaseTimes[phase];
+	}
+
+private:
+
+	enum { MAX_DEPTH = 64 };
+
+	struct Zone
+	{
+		//Phase of the zone, -1 if it is not a phase or it is inside another phase
+		int phase;
+		chrono::steady_clock::time_point start;
+	};
+
+	thread::id owner;
+	btEnterProfileZoneFunc* previousEnter = 0;
+	btLeaveProfileZoneFunc* previousLeave = 0;
+
+	Zone zones[MAX_DEPTH];
+	int depth = 0;
+	//Number of open zones that belong to a phase (nested phases are counted once)
+	int phaseDepth = 0;
+	double phaseTimes[NUM_PHASES] = {};
+
+	static PhysicsProfilerV2*& active()
+	{
+		static PhysicsProfilerV2* profiler = 0;
+		return profiler;
+	}
+
+	//Phase of the Bullet zones that make up a step of btSoftRigidDynamicsWorld
+	static int findPhase(const char* name)
+	{
+		static const struct { const char* name; int phase; } phases[] =
+		{
+			{ "predictUnconstraintMotion", PREDICT_MOTION },
+			{ "predictUnconstraintMotionSoftBody", PREDICT_MOTION },
+			{ "createPredictiveContacts", PREDICT_MOTION },
+			{ "performDiscreteCollisionDetection", COLLISION },
+			{ "softBodySelfCollision", COLLISION },
+			{ "calculateSimulationIslands", SOLVE_CONSTRAINTS },
+			{ "solveConstraints", SOLVE_CONSTRAINTS },
+			{ "solveSoftConstraints", SOLVE_CONSTRAINTS },
+			{ "integrateTransforms", INTEGRATE },
+			{ "updateSoftBodies", INTEGRATE },
+		};
+		for (const auto& entry : phases)
+			if (strcmp(entry.name, name) == 0)
+				return entry.phase;
+		return -1;
+	}
+
+	static void enterZone(const char* name)
+	{
+		PhysicsProfilerV2* profiler = active();
+		if (profiler->previousEnter)
+			profiler->previousEnter(name);
+		if (this_thread::get_id() != profiler->owner)
+			return;
+
+		//Zones deeper than the stack are still counted so leaves stay balanced
+		if (profiler->depth < MAX_DEPTH)
+		{
+			Zone& zone = profiler->zones[profiler->depth];
+			zone.phase = profiler->phaseDepth == 0 ? findPhase(name) : -1;
+			if (zone.phase != -1)
+			{
+				profiler->phaseDepth++;
+				zone.start = chrono::steady_clock::now();
+			}
+		}
+		profiler->depth++;
+	}
+
+	static void leaveZone()
+	{
+		PhysicsProfilerV2* profiler = active();
+		if (profiler->previousLeave)
+			profiler->previousLeave();
+		if (this_thread::get_id() != profiler->owner || profiler->depth == 0)
+			return;
+
+		profiler->depth--;
+		if (profiler->depth < MAX_DEPTH)
+		{
+			Zone& zone = profiler->zones[profiler->depth];
+			if (zone.phase != -1)
+			{
+				profiler->phaseTimes[zone.phase] += chrono::duration<double>(chrono::steady_clock::now() - zone.start).count();
+				profiler->phaseDepth--;
+			}
+		}
+	}
+
+};
@@ -0,0 +1,111 @@
+#pragma once
+using namespace std;
+
+#include <atomic>
+#include <vector>
+
+#include <glad/glad.h>
+#include <btBulletDynamicsCommon.h>
+
+#include "VBO.h"
+#include "PhysicsProfilerV2.h"
+
+//State of a soft body as seen by the renderer
+struct SoftBodySnapshotV2
+{
+	//Given in order of generation and never reused, the position in the array changes when bodies are removed
+	int id = -1;
+
+	//Node positions and normals already in the layout of the vertex buffer,
+	//written by the soft body solver so the renderer only has to copy them
+	vector<SoftVertex> vertices;
+	//Vertices before the last step, empty if the body did not exist yet
+	vector<SoftVertex> previousVertices;
+
+	//Triangle indices, copied only when the topology version changes
+	//Versions are unique across bodies, so a slot taken by another body is never mistaken for the old one
+	vector<GLuint> indices;
+	int topologyVersion = -1;
+};
+
+//Fixed step statistics of the simulation
+struct StepStatisticsV2
+{
+	long long totalSteps = 0;
+	//Steps done in the last frame
+	int lastSubSteps = 0;
+	//Simulated time thrown away because the substep budget was exceeded
+	double droppedTime = 0.0;
+	long long framesOverBudget = 0;
+	//Soft bodies deactivated after the last step
+	int sleepingSoftBodies = 0;
+	//Signed distance cache of the soft-rigid contacts: cells in use, lookups since the start,
+	//lookups that had to build their cell, cells evicted by the budgets and cells built ahead of the contacts
+	int sdfCells = 0;
+	long long sdfQueries = 0;
+	long long sdfMisses = 0;
+	long long sdfEvictions = 0;
+	int sdfPrecomputed = 0;
+
+	//Seconds spent stepping the world and in each phase of the steps, since the start
+	//Only measured on the simulation thread
+	double stepTime = 0.0;
+	double phaseTimes[PhysicsProfilerV2::NUM_PHASES] = {};
+};
+
+//Everything the renderer needs from a simulation step
+struct PhysicsSnapshotV2
+{
+	//Same order of the soft bodies array of the world
+	vector<SoftBodySnapshotV2> softBodies;
+	//Same order in which rigid bodies were added to PhysicsV2
+	btAlignedObjectArray<btTransform> rigidTransforms;
+	//Transforms before the last step (the current one for bodies added after it)
+	btAlignedObjectArray<btTransform> previousRigidTransforms;
+
+	StepStatisticsV2 statistics;
+	btScalar fixedTimeStep = 0.0f;
+	//Fraction of step not simulated yet when the snapshot was published
+	btScalar alpha = 1.0f;
+	//Publishing time in seconds
+	double time = 0.0;
+};
+
+//Lock-free triple buffer with a single writer and a single reader
+//The writer fills its back buffer and publishes it, the reader takes the most recent
+//published buffer; neither ever waits for the other
+template <typename T>
+class TripleBufferV2
+{
+public:
+
+	//Buffer owned by the writer
+	T& back()
+	{
+		return buffers[backIndex];
+	}
+
+	//Make the back buffer the most recent one
+	void publish()
+	{
+		backIndex = ready.exchange(backIndex | FRESH) & INDEX;
+	}
+
+	//Take the most recent buffer (the same as before if nothing new was published)
+	const T& acquire()
+	{
+		if (ready.load() & FRESH)
+			frontIndex = ready.exchange(frontIndex) & INDEX;
+		return buffers[frontIndex];
+	}
+
+private:
+
+	enum { INDEX = 3, FRESH = 4 };
+
+	T buffers[3];
+	int backIndex = 0;
+	atomic<int> ready{ 1 };
+	int frontIndex = 2;
+
+};
@@ -2,7 +2,24 @@
 #include <BulletSoftBody/btSoftRigidDynamicsWorld.h>
 #include <BulletSoftBody/btSoftBodyRigidBodyCollisionConfiguration.h>
 #include <BulletSoftBody/btDefaultSoftBodySolver.h>
+#include <BulletSoftBody/btDefaultSoftBodySolverMt.h>
+#include <BulletSoftBody/btSoftRigidDynamicsWorldMt.h>
+#include <BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h>
 #include <BulletSoftBody/btSoftBodyHelpers.h>
+#include <LinearMath/btThreads.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "SoftBodyPrototypeV2.h"
+#include "SoftTopologyV2.h"
+#include "PhysicsSnapshotV2.h"
 
 class PhysicsV2
 {
@@ -13,27 +30,156 @@ public:
 	btCollisionDispatcher* collisionDispatcher;
 	btBroadphaseInterface* broadphaseInterface;
 	btConstraintSolver* constraintSolver;
-
-	btSoftBodySolver* softBodySolver;
+	//Solver of the large islands of the multithreaded world, null otherwise
+	btConstraintSolver* constraintSolverMt = 0;
+
+	btDefaultSoftBodySolver* softBodySolver;
+
+	//Task scheduler of the parallel loops of Bullet, null when Bullet is built without BT_THREADSAFE
+	btITaskScheduler* taskScheduler = 0;
+	//Threads used by the task scheduler, set before setupPhysics
+	//0 uses all the cores but one, left to the render thread
+	int numThreads = 0;
+	//Step the soft bodies in parallel with btDefaultSoftBodySolverMt, set before setupPhysics
+	//Bodies that touch each other are still solved in order, the results do not change
+	bool parallelSoftBodySolver = true;
+	//Use btSoftRigidDynamicsWorldMt, set before setupPhysics
+	//Rigid pairs, islands and rigid bodies are processed by the task scheduler threads
+	bool multithreadedWorld = true;
+	//Soft bodies at rest fall asleep with the bodies they touch and stop being simulated
+	//until something wakes them up, set before setupPhysics
+	bool softBodySleeping = true;
 
 	btSoftRigidDynamicsWorld* world;
 
+	//Soft body templates, one for each model used to generate soft bodies
+	map<const ModelV2*, unique_ptr<SoftBodyPrototypeV2>> softBodyPrototypes;
+	//Collision shapes shared by the rigid bodies of the same model
+	map<const ModelV2*, unique_ptr<btConvexHullShape>> rigidBodyShapes;
+
+	//Fixed step scheduler
+	//The simulation always advances by fixedTimeStep, frame times are accumulated
+	//and rendering interpolates between the last two steps
+	btScalar fixedTimeStep = 1.0f / 60.0f;
+	//Maximum number of steps in a single frame, time beyond it is dropped
+	int maxSubSteps = 10;
+
+	//Soft bodies generated from now on solve positions and update normals on dense copies
+	//of the node positions, previous positions and inverse masses (btSoftBody::NodeSoA)
+	bool useNodeSoA = true;
+	//Their links are colored into independent batches, large batches are solved in parallel
+	bool batchLinks = true;
+	//Their nodes, bounds and collision tree leaves are integrated in one pass,
+	//the trees are refit in bulk when most leaves moved
+	bool fusedIntegrate = true;
+	//Their refit trees are rebuilt with a surface area heuristic when their cost grows by this ratio, 0 never
+	btScalar treeRebuildRatio = 1.5f;
+	//Their node and face trees are copied to flat arrays after each update, the collisions and ray tests
+	//traverse the copies without a stack
+	bool linearTrees = true;
+	//Their node and face trees are also copied to 4-ary trees for the soft-soft collisions,
+	//tested four boxes at a time with SSE or AVX
+	bool wideTrees = true;
+	//Moving objects keep their place in the broadphase tree, which is refit once per step and rebuilt
+	//when its cost grows by this ratio, 0 updates the objects one by one, set before setupPhysics
+	btScalar broadphaseRefitRatio = 0.0f;
+	//Signed distance cells of the soft-rigid contacts, set before setupPhysics
+	//Buckets of the cache and cells kept for each rigid shape, the least recently used ones are evicted, 0 no limit
+	int sdfHashSize = 24593;
+	int sdfShapeBudget = 16384;
+	//The cells along the top of the world plane are built by genWorldPlane instead of during the first contacts
+	bool precomputePlaneSdf = false;
+
+	StepStatisticsV2 stepStatistics;
+
+	//Time not simulated yet
+	btScalar accumulator = 0.0f;
+	//Position of the frame between the last two steps [0,1]
+	btScalar interpolationAlpha = 1.0f;
+	//Soft bodies vertices before the last step (same order of the soft bodies array)
+	vector<vector<SoftVertex>> previousVertices;
+	//Rigid bodies transforms before the last step (same order of rigidBodies)
+	btAlignedObjectArray<btTransform> previousRigidTransforms;
+
+	//Rigid bodies in the order used by the snapshots
+	btAlignedObjectArray<btRigidBody*> rigidBodies;
+
+private:
+
+	//Simulation thread
+	//When it runs, the world must only be touched through enqueue
+	thread simulationThread;
+	atomic<bool> simulationRunning{ false };
+
+	//Bullet phase times of the simulation thread
+	PhysicsProfilerV2 profiler;
+
+	//Commands for the simulation thread
+	mutex commandsMutex;
+	vector<function<void()>> commands;
+	vector<function<void()>> runningCommands;
+
+	//Render state published after the simulation steps
+	TripleBufferV2<PhysicsSnapshotV2> snapshots;
+	//Cached indices of the soft bodies and their versions (same order of the soft bodies array)
+	vector<SoftTopologyV2> topologies;
+	vector<int> topologyVersions;
+	int nextTopologyVersion = 0;
+
+	//Ids of the soft bodies (same order of the soft bodies array)
+	vector<int> softBodyIds;
+	int nextSoftBodyId = 0;
+
 public:
 
 	void setupPhysics()
 	{
+		taskScheduler = btCreateDefaultTaskScheduler();
+		if (taskScheduler)
+		{
+			int threads = numThreads;
+			if (threads <= 0)
+				threads = max((int)thread::hardware_concurrency() - 1, 1);
+			taskScheduler->setNumThreads(threads);
+			btSetTaskScheduler(taskScheduler);
+		}
+
 		collisionConfiguration = new btSoftBodyRigidBodyCollisionConfiguration();
-		collisionDispatcher = new btCollisionDispatcher(collisionConfiguration);
+		btDbvtBroadphase* broadphase = new btDbvtBroadphase();
+		broadphase->m_refitratio = broadphaseRefitRatio;
+		broadphaseInterface = broadphase;
 
-		broadphaseInterface = new btDbvtBroadphase();
-		constraintSolver = new btSequentialImpulseConstraintSolver();
+		if (parallelSoftBodySolver)
+			softBodySolver = new btDefaultSoftBodySolverMt();
+		else
+			softBodySolver = new btDefaultSoftBodySolver();
 
-		softBodySolver = new btDefaultSoftBodySolver();
+		//The multithreaded world needs the task scheduler, it does not exist without BT_THREADSAFE
+		if (multithreadedWorld && taskScheduler)
+		{
+			collisionDispatcher = new btSoftRigidCollisionDispatcherMt(collisionConfiguration);
+			//One solver for each thread that can solve an island at the same time
+			btConstraintSolverPoolMt* solverPool = new btConstraintSolverPoolMt(taskScheduler->getNumThreads());
+			constraintSolver = solverPool;
+			constraintSolverMt = new btSequentialImpulseConstraintSolverMt();
+
+			world = new btSoftRigidDynamicsWorldMt(collisionDispatcher, broadphaseInterface,
+				solverPool, constraintSolverMt, collisionConfiguration, softBodySolver);
+		}
+		else
+		{
+			collisionDispatcher = new btCollisionDispatcher(collisionConfiguration);
+			constraintSolver = new btSequentialImpulseConstraintSolver();
 
-		world = new btSoftRigidDynamicsWorld(collisionDispatcher, broadphaseInterface,
-			constraintSolver, collisionConfiguration, softBodySolver);
+			world = new btSoftRigidDynamicsWorld(collisionDispatcher, broadphaseInterface,
+				constraintSolver, collisionConfiguration, softBodySolver);
+		}
 
 		world->setGravity(btVector3(0, -10, 0));
+		world->setSoftBodyDeactivation(softBodySleeping);
+		btSparseSdf<3>& sparseSdf = world->getWorldInfo().m_sparsesdf;
+		sparseSdf.Initialize(sdfHashSize);
+		sparseSdf.setDefaultBudget(sdfShapeBudget);
 
 		//this->world = world;
 
@@ -43,6 +189,22 @@ public:
 	{
 		int i;
 
+		//The world can be released only when it is not stepped anymore
+		stopSimulationThread();
+
+		//Remove and delete soft bodies
+		//Removing a soft body changes the array, so go from the end
+		for (i = world->getSoftBodyArray().size() - 1; i >= 0; i--)
+		{
+			btSoftBody* softBody = world->getSoftBodyArray()[i];
+			world->removeSoftBody(softBody);
+			delete softBody;
+		}
+		softBodyIds.clear();
+		topologies.clear();
+		topologyVersions.clear();
+		previousVertices.clear();
+
 		//Remove and delete rigid bodies
 		for (i = world->getNumCollisionObjects() - 1; i >= 0; i--)
 		{
@@ -52,33 +214,222 @@ public:
 
 			//Delete the rigig body linked to the collision object
 			btRigidBody* rigidBody = btRigidBody::upcast(collisionObject);
+			if (!rigidBody)
+			{
+				delete collisionObject;
+				continue;
+			}
 
 			btMotionState* motionState = rigidBody->getMotionState();
 			delete motionState;
 
+			//Shapes shared by the bodies of a model are deleted with their cache
 			btCollisionShape* collisionShape = rigidBody->getCollisionShape();
-			delete collisionShape;
+			if (!isSharedShape(collisionShape))
+				delete collisionShape;
 
 			delete rigidBody;
 
 		}
+		rigidBodies.clear();
+		rigidBodyShapes.clear();
 
-		//Remove and delete soft bodies
-		for (i = 0; i < world->getSoftBodyArray().size(); i++)
-		{
-			world->removeSoftBody(world->getSoftBodyArray()[i]);
-			delete world->getSoftBodyArray()[i];
-		}
+		//Delete soft bodies templates
+		softBodyPrototypes.clear();
 
 		//Delete world
 		delete collisionConfiguration;
 		delete collisionDispatcher;
 		delete broadphaseInterface;
 		delete constraintSolver;
+		delete constraintSolverMt;
+		constraintSolverMt = 0;
 		//delete softBodySolver;
 
 		delete world;
 
+		if (taskScheduler)
+		{
+			btSetTaskScheduler(btGetSequentialTaskScheduler());
+			delete taskScheduler;
+			taskScheduler = 0;
+		}
+
+	}
+
+	//Advance the simulation by the time elapsed since the last frame using fixed steps
+	void stepFixed(btScalar frameTime)
+	{
+		accumulator += frameTime;
+
+		int steps = (int)(accumulator / fixedTimeStep);
+		if (steps > maxSubSteps)
+		{
+			//Do not fall behind forever, the exceeding time is dropped and reported
+			btScalar dropped = (steps - maxSubSteps) * fixedTimeStep;
+			accumulator -= dropped;
+			stepStatistics.droppedTime += dropped;
+			stepStatistics.framesOverBudget++;
+			steps = maxSubSteps;
+		}
+
+		auto startTime = chrono::steady_clock::now();
+		for (int i = 0; i < steps; i++)
+		{
+			//Only the state before the last step of the frame is needed to interpolate
+			if (i == steps - 1)
+				savePreviousVertices();
+			world->stepSimulation(fixedTimeStep, 0, fixedTimeStep);
+			accumulator -= fixedTimeStep;
+		}
+		if (steps > 0)
+			stepStatistics.stepTime += chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+		for (int i = 0; i < PhysicsProfilerV2::NUM_PHASES; i++)
+			stepStatistics.phaseTimes[i] = profiler.getPhaseTime(i);
+
+		stepStatistics.totalSteps += steps;
+		stepStatistics.lastSubSteps = steps;
+		stepStatistics.sleepingSoftBodies = 0;
+		btSoftBodyArray& softBodies = world->getSoftBodyArray();
+		for (int i = 0; i < softBodies.size(); i++)
+			if (!softBodies[i]->isActive())
+				stepStatistics.sleepingSoftBodies++;
+		const btSparseSdf<3>& sparseSdf = world->getWorldInfo().m_sparsesdf;
+		stepStatistics.sdfCells = sparseSdf.ncells;
+		stepStatistics.sdfQueries = sparseSdf.m_queries;
+		stepStatistics.sdfMisses = sparseSdf.m_misses;
+		stepStatistics.sdfEvictions = sparseSdf.m_evictions;
+		interpolationAlpha = accumulator / fixedTimeStep;
+	}
+
+	//Vertices of a soft body before the last step, null if not available
+	//(e.g. the body was generated after the last step)
+	const vector<SoftVertex>* getPreviousVertices(int softBodyIndex)
+	{
+		btSoftBody* softBody = world->getSoftBodyArray()[softBodyIndex];
+		if (softBodyIndex >= (int)previousVertices.size() ||
+			(int)previousVertices[softBodyIndex].size() != softBody->m_nodes.size() ||
+			softBody->m_nodes.size() == 0)
+			return 0;
+		return &previousVertices[softBodyIndex];
+	}
+
+	//Write the node positions and normals of a soft body in the layout of the vertex buffer
+	//The solver converts them in a single pass through a vertex buffer descriptor
+	void exportVertices(const btSoftBody& softBody, vector<SoftVertex>& vertices)
+	{
+		vertices.resize(softBody.m_nodes.size());
+		if (vertices.empty())
+			return;
+		const int stride = sizeof(SoftVertex) / sizeof(float);
+		btCPUVertexBufferDescriptor descriptor((float*)vertices.data(),
+			offsetof(SoftVertex, Position) / sizeof(float), stride,
+			offsetof(SoftVertex, Normal) / sizeof(float), stride);
+		softBodySolver->copySoftBodyToVertexBuffer(&softBody, &descriptor);
+	}
+
+	//////////////////////////////////////////////////////////////
+	//Simulation thread
+
+	//Step the world on its own thread so physics and rendering run in parallel
+	void startSimulationThread()
+	{
+		if (simulationRunning)
+			return;
+		publishSnapshot();
+		simulationRunning = true;
+		simulationThread = thread(&PhysicsV2::simulationLoop, this);
+	}
+
+	void stopSimulationThread()
+	{
+		if (!simulationRunning)
+			return;
+		simulationRunning = false;
+		simulationThread.join();
+		//Commands left behind are executed here so nothing is lost
+		runCommands();
+	}
+
+	//Run a command on the simulation thread before its next step
+	//Without the simulation thread it runs immediately
+	void enqueue(function<void()> command)
+	{
+		if (!simulationRunning)
+		{
+			command();
+			publishSnapshot();
+			return;
+		}
+		lock_guard<mutex> lock(commandsMutex);
+		commands.push_back(move(command));
+	}
+
+	//Most recent render state, to be called only by the render thread
+	//The returned snapshot stays valid until the next call
+	const PhysicsSnapshotV2& acquireSnapshot()
+	{
+		return snapshots.acquire();
+	}
+
+	//Copy the render state of the world into the back snapshot and publish it
+	void publishSnapshot()
+	{
+		PhysicsSnapshotV2& snapshot = snapshots.back();
+
+		btSoftBodyArray& softBodies = world->getSoftBodyArray();
+		snapshot.softBodies.resize(softBodies.size());
+		topologies.resize(softBodies.size());
+		topologyVersions.resize(softBodies.size(), -1);
+		for (int i = 0; i < softBodies.size(); i++)
+		{
+			btSoftBody& softBody = *softBodies[i];
+			SoftBodySnapshotV2& softBodySnapshot = snapshot.softBodies[i];
+
+			//Indices are computed again only after a topology change
+			if (!topologies[i].isValid(softBody))
+			{
+				topologies[i].build(softBody);
+				topologyVersions[i] = nextTopologyVersion++;
+			}
+			softBodySnapshot.id = softBodyIds[i];
+			if (softBodySnapshot.topologyVersion != topologyVersions[i])
+			{
+				softBodySnapshot.indices = topologies[i].indices;
+				softBodySnapshot.topologyVersion = topologyVersions[i];
+			}
+
+			exportVertices(softBody, softBodySnapshot.vertices);
+
+			const vector<SoftVertex>* previous = getPreviousVertices(i);
+			if (previous)
+				softBodySnapshot.previousVertices = *previous;
+			else
+				softBodySnapshot.previousVertices.clear();
+		}
+
+		//Rigid bodies state comes from their motion states
+		snapshot.rigidTransforms.resize(rigidBodies.size());
+		snapshot.previousRigidTransforms.resize(rigidBodies.size());
+		for (int i = 0; i < rigidBodies.size(); i++)
+		{
+			rigidBodies[i]->getMotionState()->getWorldTransform(snapshot.rigidTransforms[i]);
+			snapshot.previousRigidTransforms[i] = i < previousRigidTransforms.size() ?
+				previousRigidTransforms[i] : snapshot.rigidTransforms[i];
+		}
+
+		snapshot.statistics = stepStatistics;
+		snapshot.fixedTimeStep = fixedTimeStep;
+		snapshot.alpha = interpolationAlpha;
+		snapshot.time = currentTime();
+
+		snapshots.publish();
+	}
+
+	//Seconds on the clock used to time snapshots
+	static double currentTime()
+	{
+		return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
 	}
 
 	//Create world plane aside from other bodies
@@ -94,6 +445,15 @@ public:
 		btCollisionShape* cShape = new btBoxShape(dim);
 		cShape->setMargin(0.1f);
 
+		//Cells of the band around the top face, where the soft bodies rest
+		//The distances are stored in shape space, so they stay valid if the plane is moved
+		if (precomputePlaneSdf)
+		{
+			btSparseSdf<3>& sparseSdf = world->getWorldInfo().m_sparsesdf;
+			stepStatistics.sdfPrecomputed += sparseSdf.Precompute(cShape,
+				btVector3(-dim.x(), dim.y() - 0.5f, -dim.z()), btVector3(dim.x(), dim.y() + 0.5f, dim.z()));
+		}
+
 		// We set the initial transformations
 		btTransform objTransform;
 		objTransform.setIdentity();
@@ -116,30 +476,61 @@ public:
 		btRigidBody* body = new btRigidBody(rbInfo);
 
 		this->world->addRigidBody(body);
+		rigidBodies.push_back(body);
 		return body;
 
 	}
 
 	//Final versions for rigid and soft bodies
-	void generateRigidBody(glm::vec3 position, glm::vec3 rotation)
+	//Rigid bodies of the same model share the convex hull of its merged vertices
+	//Null if the model has no vertices (e.g. its import failed), no body is added
+	btRigidBody* generateRigidBody(const ModelV2& model, float position[3], float rotation[3], float mass)
 	{
+		if (model.vertices.empty())
+		{
+			cout << "ERROR::PHYSICS::rigid body from a model without vertices" << endl;
+			return nullptr;
+		}
+
+		unique_ptr<btConvexHullShape>& shape = rigidBodyShapes[&model];
+		if (!shape)
+		{
+			shape.reset(new btConvexHullShape(&model.vertices[0].x(), model.vertices.size(), sizeof(btVector3)));
+			//Drop the points inside the hull, big models have thousands of them
+			shape->optimizeConvexHull();
+		}
+
 		//Initialize body transform
 		btTransform transform;
 		transform.setIdentity();
 		//Set body position
-		btVector3 pos(position.x, position.y, position.z);
+		btVector3 pos(position[0], position[1], position[2]);
 		transform.setOrigin(pos);
 		//Set body rotation
 		btQuaternion rot;
-		rot.setEuler(rotation.x, rotation.y, rotation.z);
+		rot.setEuler(rotation[0], rotation[1], rotation[2]);
 		transform.setRotation(rot);
 
+		btVector3 localInertia(0.0f, 0.0f, 0.0f);
+		if (mass != 0.0f)
+			shape->calculateLocalInertia(mass, localInertia);
+
+		btDefaultMotionState* motionState = new btDefaultMotionState(transform);
 
+		btRigidBody::btRigidBodyConstructionInfo rbInfo(mass, motionState, shape.get(), localInertia);
+		rbInfo.m_friction = 0.3f;
+		rbInfo.m_restitution = 0.3f;
+
+		btRigidBody* body = new btRigidBody(rbInfo);
+
+		this->world->addRigidBody(body);
+		rigidBodies.push_back(body);
+		return body;
 	}
 
 	//Handle the correct spawning of the soft body
 	btSoftBody* generateSoftBodyTest(
-		ModelV2 model,
+		const ModelV2& model,
 		float position[3],
 		float rotation[3],
 		float scale[3],
@@ -148,9 +539,6 @@ public:
 	)
 	{
 
-		//Generate the soft body
-		btSoftBody* softBody = generateSoftBodyFromModel(model);
-
 		//Initialize body transform
 		btTransform transform;
 		transform.setIdentity();
@@ -161,8 +549,9 @@ public:
 		btQuaternion quat;
 		quat.setEuler(rotation[0], rotation[1], rotation[2]);
 		transform.setRotation(quat);
-		//Set the transform
-		softBody->transform(transform);
+
+		//Generate the soft body already in place
+		btSoftBody* softBody = generateSoftBodyFromModel(model, transform);
 
 
 		//Set the soft body scale
@@ -183,16 +572,143 @@ public:
 
 
 	//Given a model generate its corresponding soft body
-	btSoftBody* generateSoftBodyFromModel(ModelV2 model)
+	//The first soft body of a model builds its template, the next ones are copies of it
+	btSoftBody* generateSoftBodyFromModel(const ModelV2& model, const btTransform& transform)
+	{
+		unique_ptr<SoftBodyPrototypeV2>& prototype = softBodyPrototypes[&model];
+		if (!prototype)
+			prototype.reset(new SoftBodyPrototypeV2(buildSoftBody(model)));
+
+		btSoftBody* body = prototype->instantiate(&world->getWorldInfo(), transform);
+		body->m_cfg.m_useNodeSoA = useNodeSoA;
+		body->m_cfg.m_batchLinks = batchLinks;
+		body->m_cfg.m_fusedIntegrate = fusedIntegrate;
+		body->m_cfg.m_treeRebuildRatio = treeRebuildRatio;
+		body->m_cfg.m_linearTrees = linearTrees;
+		body->m_cfg.m_wideTrees = wideTrees;
+
+		// Add the soft body to the world
+		this->world->addSoftBody(body);
+		softBodyIds.push_back(nextSoftBodyId++);
+
+		return body;
+
+	}
+
+	//Remove a soft body from the world and delete it, false if there is no body with the id
+	//Bullet moves the last soft body in place of the removed one, the arrays that follow
+	//the order of the soft bodies are updated in the same way
+	bool removeSoftBody(int id)
+	{
+		btSoftBodyArray& softBodies = world->getSoftBodyArray();
+		int count = softBodies.size();
+		int index = 0;
+		while (index < count && softBodyIds[index] != id)
+			index++;
+		if (index == count)
+			return false;
+
+		btSoftBody* softBody = softBodies[index];
+		world->removeSoftBody(softBody);
+		delete softBody;
+
+		removeSwapped(softBodyIds, index, count);
+		removeSwapped(topologies, index, count);
+		removeSwapped(topologyVersions, index, count);
+		removeSwapped(previousVertices, index, count);
+		return true;
+	}
+
+private:
+
+	void simulationLoop()
 	{
+		//Bullet profile zones are collected only for this thread
+		profiler.install();
+
+		double lastTime = currentTime();
+		while (simulationRunning)
+		{
+			bool changed = runCommands();
+
+			double now = currentTime();
+			stepFixed((btScalar)(now - lastTime));
+			lastTime = now;
 
-		vector<btVector3> vertices = model.vertices;
-		vector<GLuint> indices = model.indices;
+			if (changed || stepStatistics.lastSubSteps > 0)
+				publishSnapshot();
+
+			//Sleep until the next step is due
+			btScalar remaining = fixedTimeStep - accumulator;
+			if (remaining > 0.0f)
+				this_thread::sleep_for(chrono::duration<double>(remaining));
+		}
+
+		profiler.uninstall();
+	}
+
+	//Execute the queued commands, true if there were any
+	bool runCommands()
+	{
+		{
+			lock_guard<mutex> lock(commandsMutex);
+			runningCommands.swap(commands);
+		}
+		for (function<void()>& command : runningCommands)
+			command();
+		bool executed = !runningCommands.empty();
+		runningCommands.clear();
+		return executed;
+	}
+
+	void savePreviousVertices()
+	{
+		btSoftBodyArray& softBodies = world->getSoftBodyArray();
+		previousVertices.resize(softBodies.size());
+		for (int i = 0; i < softBodies.size(); i++)
+			exportVertices(*softBodies[i], previousVertices[i]);
+
+		previousRigidTransforms.resize(rigidBodies.size());
+		for (int i = 0; i < rigidBodies.size(); i++)
+			rigidBodies[i]->getMotionState()->getWorldTransform(previousRigidTransforms[i]);
+	}
+
+	//Remove the element of a body as Bullet does (the last one takes its place)
+	//Arrays filled lazily can be shorter than the bodies, then the elements from index on are dropped
+	template <typename T>
+	static void removeSwapped(vector<T>& values, int index, int count)
+	{
+		if ((int)values.size() == count)
+		{
+			swap(values[index], values.back());
+			values.pop_back();
+		}
+		else if (index < (int)values.size())
+		{
+			values.resize(index);
+		}
+	}
+
+	bool isSharedShape(const btCollisionShape* collisionShape)
+	{
+		for (const auto& shape : rigidBodyShapes)
+			if (shape.second.get() == collisionShape)
+				return true;
+		return false;
+	}
+
+	//Build a soft body from a model with the soft bodies material configuration
+	//The model is only read, its vertices are copied straight into the soft body nodes
+	btSoftBody* buildSoftBody(const ModelV2& model)
+	{
+
+		const vector<btVector3>& vertices = model.vertices;
+		const vector<GLuint>& indices = model.indices;
 
 		btSoftBody* body = new btSoftBody(
 			&world->getWorldInfo(),
 			vertices.size(),
-			&vertices[0],
+			vertices.data(),
 			0
 		);
 
@@ -228,9 +744,6 @@ public:
 		body->randomizeConstraints();
 		body->getCollisionShape()->setMargin(0.075f);
 
-		// Add the soft body to the world
-		this->world->addSoftBody(body);
-
 		return body;
 
 	}
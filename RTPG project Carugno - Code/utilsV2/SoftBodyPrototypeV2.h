@@ -0,0 +1,88 @@
+#pragma once
+using namespace std;
+
+#include <btBulletDynamicsCommon.h>
+#include <BulletSoftBody/btSoftBody.h>
+
+//Template of a soft body built once per model and material configuration
+//The expensive part of the setup (face and link creation, bending constraints
+//and constraints randomization) is done only on the prototype, new soft bodies
+//copy its links and faces in bulk and only fix their node and material pointers
+class SoftBodyPrototypeV2
+{
+public:
+
+	//Takes ownership of a fully configured soft body that is never added to a world
+	SoftBodyPrototypeV2(btSoftBody* prototype)
+	{
+		this->prototype = prototype;
+	}
+
+	SoftBodyPrototypeV2(const SoftBodyPrototypeV2&) = delete;
+	SoftBodyPrototypeV2& operator=(const SoftBodyPrototypeV2&) = delete;
+
+	~SoftBodyPrototypeV2()
+	{
+		delete prototype;
+	}
+
+	//Create a copy of the prototype placed with the given transform
+	btSoftBody* instantiate(btSoftBodyWorldInfo* worldInfo, const btTransform& transform)
+	{
+		const int numNodes = prototype->m_nodes.size();
+
+		//Nodes are created already transformed
+		btAlignedObjectArray<btVector3> positions;
+		positions.resize(numNodes);
+		for (int i = 0; i < numNodes; i++)
+			positions[i] = transform * prototype->m_nodes[i].m_x;
+
+		btSoftBody* body = new btSoftBody(worldInfo, numNodes, numNodes > 0 ? &positions[0] : 0, 0);
+
+		//Same configuration and material
+		body->m_cfg = prototype->m_cfg;
+		*body->m_materials[0] = *prototype->m_materials[0];
+		body->getCollisionShape()->setMargin(prototype->getCollisionShape()->getMargin());
+
+		//Links and faces are copied in bulk, then their pointers are moved to the new nodes
+		//Rest lengths and rest areas do not change under a rigid transform
+		body->m_links = prototype->m_links;
+		body->m_faces = prototype->m_faces;
+
+		const btSoftBody::Node* sourceNodes = numNodes > 0 ? &prototype->m_nodes[0] : 0;
+		btSoftBody::Node* nodes = numNodes > 0 ? &body->m_nodes[0] : 0;
+		btSoftBody::Material* material = body->m_materials[0];
+
+		for (int i = 0; i < body->m_links.size(); i++)
+		{
+			btSoftBody::Link& link = body->m_links[i];
+			link.m_n[0] = nodes + (link.m_n[0] - sourceNodes);
+			link.m_n[1] = nodes + (link.m_n[1] - sourceNodes);
+			link.m_material = material;
+		}
+
+		for (int i = 0; i < body->m_faces.size(); i++)
+		{
+			btSoftBody::Face& face = body->m_faces[i];
+			face.m_n[0] = nodes + (face.m_n[0] - sourceNodes);
+			face.m_n[1] = nodes + (face.m_n[1] - sourceNodes);
+			face.m_n[2] = nodes + (face.m_n[2] - sourceNodes);
+			face.m_material = material;
+			//The faces tree is rebuilt by the new body on its first step
+			face.m_leaf = 0;
+		}
+
+		//Runtime constants, normals and bounds for the new position
+		body->m_bUpdateRtCst = true;
+		body->updateNormals();
+		body->updateBounds();
+		body->updateConstants();
+
+		return body;
+	}
+
+private:
+
+	btSoftBody* prototype;
+
+};
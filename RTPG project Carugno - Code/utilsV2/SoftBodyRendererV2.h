@@ -0,0 +1,385 @@
+#pragma once
+using namespace std;
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#endif
+
+#include "VAO.h"
+#include "EBO.h"
+#include "../utils/shader.h"
+#include "FreeListAllocatorV2.h"
+#include "PhysicsSnapshotV2.h"
+
+//Renderer of all the soft bodies with shared buffers and a single draw call
+//Every body gets a range of vertices and a range of indices inside the same megabuffers,
+//allocated from free lists when the body shows up in a snapshot and given back when it leaves
+//Positions and normals are streamed every frame into a ring of regions of the vertex buffer
+//(every body keeps the same range in all the regions), colours and indices are written once
+//GL 4.1 has no indirect draws, all the bodies are drawn by one glMultiDrawElementsBaseVertex
+class SoftBodyRendererV2
+{
+public:
+
+	enum
+	{
+		//Regions of the streaming vertex buffer, while the GPU reads one region the CPU writes the next one
+		NUM_REGIONS = 3,
+		//Capacity of the megabuffers when the first body is added
+		MIN_VERTICES = 4096,
+		MIN_INDICES = 3 * 8192
+	};
+
+	VAO vao;
+	VBO vbo;
+	//Colour of every vertex, one copy per region so the base vertex of a draw applies to it too
+	VBO colorVBO;
+	EBO ebo;
+
+	SoftBodyRendererV2()
+	{
+		vao.Bind();
+		vao.LinkAttribute(vbo, 0, 3, GL_FLOAT, sizeof(SoftVertex), (void*)offsetof(SoftVertex, Position));
+		vao.LinkAttribute(vbo, 1, 3, GL_FLOAT, sizeof(SoftVertex), (void*)offsetof(SoftVertex, Normal));
+		vao.LinkAttribute(colorVBO, 2, 3, GL_FLOAT, sizeof(glm::vec3), (void*)0);
+		ebo.Bind();
+		vao.Unbind();
+	}
+
+	SoftBodyRendererV2(const SoftBodyRendererV2&) = delete;
+	SoftBodyRendererV2& operator=(const SoftBodyRendererV2&) = delete;
+
+	~SoftBodyRendererV2()
+	{
+		Delete();
+	}
+
+	//Match the bodies with the snapshot and stream their nodes into the next region
+	//Colours are indexed by the body id, with the previous positions the nodes are placed
+	//at alpha between the two states
+	void update(const PhysicsSnapshotV2& snapshot, const vector<glm::vec3>& colors, btScalar alpha = 1.0f)
+	{
+		//Bodies removed from the world give their ranges back first, so new bodies can take them
+		for (Body& body : bodies)
+			body.source = 0;
+		for (const SoftBodySnapshotV2& softBody : snapshot.softBodies)
+		{
+			auto found = bodyIndices.find(softBody.id);
+			if (found != bodyIndices.end())
+				bodies[found->second].source = &softBody;
+		}
+		for (size_t i = 0; i < bodies.size();)
+		{
+			if (bodies[i].source)
+			{
+				i++;
+				continue;
+			}
+			release(bodies[i]);
+			bodyIndices.erase(bodies[i].id);
+			if (i + 1 < bodies.size())
+			{
+				bodies[i] = move(bodies.back());
+				bodyIndices[bodies[i].id] = i;
+			}
+			bodies.pop_back();
+		}
+
+		//New bodies and bodies with a new topology get their ranges
+		for (const SoftBodySnapshotV2& softBody : snapshot.softBodies)
+		{
+			auto found = bodyIndices.find(softBody.id);
+			if (found == bodyIndices.end())
+			{
+				found = bodyIndices.emplace(softBody.id, bodies.size()).first;
+				bodies.emplace_back();
+				bodies.back().id = softBody.id;
+				bodies.back().source = &softBody;
+			}
+			Body& body = bodies[found->second];
+			if (body.topologyVersion != softBody.topologyVersion)
+			{
+				release(body);
+				body.topologyVersion = softBody.topologyVersion;
+				body.numVertices = softBody.vertices.size();
+				body.indices = softBody.indices;
+				body.color = softBody.id >= 0 && softBody.id < (int)colors.size() ?
+					colors[softBody.id] : glm::vec3(1.0f, 1.0f, 1.0f);
+				allocate(body);
+			}
+		}
+
+		if (respecify)
+			respecifyBuffers();
+		uploadStaticData();
+		streamNodes(alpha);
+	}
+
+	//Draw all the bodies of the last update with one call
+	//The camera comes from the Camera uniform buffer
+	void draw(Shader& shader)
+	{
+		if (counts.empty())
+			return;
+
+		shader.Use();
+		//Soft body nodes are already in world space
+		shader.setMat4("model", glm::mat4(1.0f));
+
+		vao.Bind();
+		glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT,
+			offsets.data(), (GLsizei)counts.size(), baseVertices.data());
+		fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		vao.Unbind();
+	}
+
+	void Delete()
+	{
+		deleteFences();
+		vao.Delete();
+		vbo.Delete();
+		colorVBO.Delete();
+		ebo.Delete();
+		bodies.clear();
+		bodyIndices.clear();
+		vertexRanges.clear();
+		indexRanges.clear();
+		counts.clear();
+		offsets.clear();
+		baseVertices.clear();
+	}
+
+	int getNumBodies() const
+	{
+		return (int)bodies.size();
+	}
+
+	//Vertices of a region and indices in use, their capacity and fragmentation
+	const FreeListAllocatorV2& getVertexRanges() const
+	{
+		return vertexRanges;
+	}
+
+	const FreeListAllocatorV2& getIndexRanges() const
+	{
+		return indexRanges;
+	}
+
+private:
+
+	struct Body
+	{
+		int id = -1;
+		int topologyVersion = -1;
+		//Snapshot of the body in the current update, null if it is not in the snapshot
+		const SoftBodySnapshotV2* source = 0;
+
+		long long firstVertex = FreeListAllocatorV2::INVALID_OFFSET;
+		long long numVertices = 0;
+		long long firstIndex = FreeListAllocatorV2::INVALID_OFFSET;
+		vector<GLuint> indices;
+		glm::vec3 color;
+
+		//Indices and colours still to be written into the buffers
+		bool pending = false;
+	};
+
+	vector<Body> bodies;
+	//Position of every body in bodies, by id
+	unordered_map<int, size_t> bodyIndices;
+
+	FreeListAllocatorV2 vertexRanges;
+	FreeListAllocatorV2 indexRanges;
+	//The capacity grew, the buffers must be allocated again
+	bool respecify = false;
+
+	int region = 0;
+	GLsync fences[NUM_REGIONS] = {};
+
+	//Arguments of the multi draw, one entry per body
+	vector<GLsizei> counts;
+	vector<void*> offsets;
+	vector<GLint> baseVertices;
+
+	vector<glm::vec3> colorScratch;
+
+	void allocate(Body& body)
+	{
+		body.firstVertex = allocateRange(vertexRanges, body.numVertices, MIN_VERTICES);
+		body.firstIndex = allocateRange(indexRanges, body.indices.size(), MIN_INDICES);
+		body.pending = true;
+	}
+
+	//Range of the allocator, growing it when no free range is large enough
+	long long allocateRange(FreeListAllocatorV2& ranges, long long size, long long minimum)
+	{
+		long long offset = ranges.allocate(size);
+		if (offset != FreeListAllocatorV2::INVALID_OFFSET)
+			return offset;
+		ranges.grow(max(max(2 * ranges.getCapacity(), ranges.getCapacity() + size), minimum));
+		respecify = true;
+		return ranges.allocate(size);
+	}
+
+	void release(Body& body)
+	{
+		vertexRanges.free(body.firstVertex, body.numVertices);
+		indexRanges.free(body.firstIndex, body.indices.size());
+		body.firstVertex = FreeListAllocatorV2::INVALID_OFFSET;
+		body.firstIndex = FreeListAllocatorV2::INVALID_OFFSET;
+	}
+
+	void deleteFences()
+	{
+		for (int i = 0; i < NUM_REGIONS; i++)
+		{
+			if (fences[i])
+				glDeleteSync(fences[i]);
+			fences[i] = 0;
+		}
+	}
+
+	//Allocate the buffers with the new capacity, their content is lost so every body is uploaded again
+	void respecifyBuffers()
+	{
+		respecify = false;
+		deleteFences();
+
+		vbo.Bind();
+		glBufferData(GL_ARRAY_BUFFER, NUM_REGIONS * vertexRanges.getCapacity() * sizeof(SoftVertex), NULL, GL_STREAM_DRAW);
+		colorVBO.Bind();
+		glBufferData(GL_ARRAY_BUFFER, NUM_REGIONS * vertexRanges.getCapacity() * sizeof(glm::vec3), NULL, GL_STATIC_DRAW);
+		colorVBO.Unbind();
+
+		vao.Bind();
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexRanges.getCapacity() * sizeof(GLuint), NULL, GL_STATIC_DRAW);
+		vao.Unbind();
+
+		for (Body& body : bodies)
+			body.pending = true;
+	}
+
+	//Write the indices and colours of the bodies added since the last update
+	void uploadStaticData()
+	{
+		bool any = false;
+		for (const Body& body : bodies)
+			any = any || body.pending;
+		if (!any)
+			return;
+
+		vao.Bind();
+		for (const Body& body : bodies)
+			if (body.pending && !body.indices.empty())
+				glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, body.firstIndex * sizeof(GLuint),
+					body.indices.size() * sizeof(GLuint), body.indices.data());
+		vao.Unbind();
+
+		colorVBO.Bind();
+		for (Body& body : bodies)
+		{
+			if (!body.pending)
+				continue;
+			body.pending = false;
+			if (body.numVertices == 0)
+				continue;
+			colorScratch.assign(body.numVertices, body.color);
+			for (int i = 0; i < NUM_REGIONS; i++)
+				glBufferSubData(GL_ARRAY_BUFFER, (i * vertexRanges.getCapacity() + body.firstVertex) * sizeof(glm::vec3),
+					body.numVertices * sizeof(glm::vec3), colorScratch.data());
+		}
+		colorVBO.Unbind();
+	}
+
+	//from + (to - from) * alpha for all the floats of the vertices, 8 or 4 at a time with AVX or SSE
+	//Stores go straight to the mapped buffer, in order
+	static void lerpVertices(SoftVertex* out, const SoftVertex* from, const SoftVertex* to, long long count, float alpha)
+	{
+		float* result = (float*)out;
+		const float* a = (const float*)from;
+		const float* b = (const float*)to;
+		const long long numFloats = count * (long long)(sizeof(SoftVertex) / sizeof(float));
+		long long i = 0;
+#if defined(__AVX__)
+		const __m256 alpha8 = _mm256_set1_ps(alpha);
+		for (; i + 8 <= numFloats; i += 8)
+		{
+			__m256 va = _mm256_loadu_ps(a + i);
+			__m256 vb = _mm256_loadu_ps(b + i);
+			_mm256_storeu_ps(result + i, _mm256_add_ps(va, _mm256_mul_ps(_mm256_sub_ps(vb, va), alpha8)));
+		}
+#endif
+#if defined(__AVX__) || defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+		const __m128 alpha4 = _mm_set1_ps(alpha);
+		for (; i + 4 <= numFloats; i += 4)
+		{
+			__m128 va = _mm_loadu_ps(a + i);
+			__m128 vb = _mm_loadu_ps(b + i);
+			_mm_storeu_ps(result + i, _mm_add_ps(va, _mm_mul_ps(_mm_sub_ps(vb, va), alpha4)));
+		}
+#endif
+		for (; i < numFloats; i++)
+			result[i] = a[i] + (b[i] - a[i]) * alpha;
+	}
+
+	//Write the nodes of every body into the next region and prepare the draw arguments
+	void streamNodes(btScalar alpha)
+	{
+		counts.clear();
+		offsets.clear();
+		baseVertices.clear();
+		if (bodies.empty())
+			return;
+
+		region = (region + 1) % NUM_REGIONS;
+
+		//Wait until the GPU is done with the draw that last used this region
+		if (fences[region])
+		{
+			glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+			glDeleteSync(fences[region]);
+			fences[region] = 0;
+		}
+
+		const GLsizeiptr regionSize = vertexRanges.getCapacity() * sizeof(SoftVertex);
+		vbo.Bind();
+		//The region is known to be free so the driver does not have to synchronize
+		SoftVertex* vertices = (SoftVertex*)glMapBufferRange(GL_ARRAY_BUFFER, region * regionSize, regionSize,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if (!vertices)
+		{
+			vbo.Unbind();
+			return;
+		}
+
+		for (const Body& body : bodies)
+		{
+			//The snapshot vertices are already in the buffer layout, so every body is a single
+			//sequential write into the mapped region (interpolated only between two steps)
+			const SoftBodySnapshotV2& softBody = *body.source;
+			SoftVertex* bodyVertices = vertices + body.firstVertex;
+			if (alpha < 1.0f && softBody.previousVertices.size() == softBody.vertices.size())
+				lerpVertices(bodyVertices, softBody.previousVertices.data(), softBody.vertices.data(), body.numVertices, alpha);
+			else if (body.numVertices > 0)
+				memcpy(bodyVertices, softBody.vertices.data(), body.numVertices * sizeof(SoftVertex));
+
+			if (body.indices.empty())
+				continue;
+			counts.push_back((GLsizei)body.indices.size());
+			offsets.push_back((void*)(body.firstIndex * sizeof(GLuint)));
+			baseVertices.push_back((GLint)(region * vertexRanges.getCapacity() + body.firstVertex));
+		}
+
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		vbo.Unbind();
+	}
+
+};
@@ -0,0 +1,59 @@
+#pragma once
+using namespace std;
+
+#include <vector>
+
+#include <glad/glad.h>
+#include <BulletSoftBody/btSoftBody.h>
+
+//Cached triangle indices of a soft body
+//Bullet faces only store pointers to nodes, converting them to indices is done
+//once here instead of every frame
+class SoftTopologyV2
+{
+public:
+
+	vector<GLuint> indices;
+
+	//Rebuild the indices from the faces of the soft body
+	//Complexity O(faces) using pointer arithmetic against the nodes array
+	void build(const btSoftBody& softBody)
+	{
+		indices.clear();
+		indices.reserve(softBody.m_faces.size() * 3);
+
+		const btSoftBody::Node* firstNode = softBody.m_nodes.size() > 0 ? &softBody.m_nodes[0] : 0;
+		for (int i = 0; i < softBody.m_faces.size(); i++)
+		{
+			const btSoftBody::Face& face = softBody.m_faces[i];
+			for (int j = 0; j < 3; j++)
+				indices.push_back(static_cast<GLuint>(face.m_n[j] - firstNode));
+		}
+
+		numNodes = softBody.m_nodes.size();
+		numFaces = softBody.m_faces.size();
+		numLinks = softBody.m_links.size();
+		nodesAddress = firstNode;
+	}
+
+	//refine and cutLink append nodes, links and faces (and may reallocate the nodes array)
+	//so any topology change shows up in these counters or in the nodes address
+	bool isValid(const btSoftBody& softBody) const
+	{
+		const btSoftBody::Node* firstNode = softBody.m_nodes.size() > 0 ? &softBody.m_nodes[0] : 0;
+		return numNodes == softBody.m_nodes.size() &&
+			numFaces == softBody.m_faces.size() &&
+			numLinks == softBody.m_links.size() &&
+			nodesAddress == firstNode;
+	}
+
+	int getNumNodes() const { return numNodes; }
+
+private:
+
+	int numNodes = -1;
+	int numFaces = -1;
+	int numLinks = -1;
+	const btSoftBody::Node* nodesAddress = 0;
+
+};
@@ -7,13 +7,38 @@
 class VAO
 {
 public:
-	GLuint ID;
+	GLuint ID = 0;
 
 	VAO() 
 	{
 		glGenVertexArrays(1, &ID);
 	};
 
+	//The vertex array is owned by a single object, so it can be moved but not copied
+	VAO(const VAO&) = delete;
+	VAO& operator=(const VAO&) = delete;
+
+	VAO(VAO&& other) noexcept : ID(other.ID)
+	{
+		other.ID = 0;
+	}
+
+	VAO& operator=(VAO&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Delete();
+			ID = other.ID;
+			other.ID = 0;
+		}
+		return *this;
+	}
+
+	~VAO()
+	{
+		Delete();
+	}
+
 	void LinkAttribute(VBO& VBO, GLuint layout, GLuint numComponents,
 		GLenum type, GLsizeiptr stride, void* offset)
 	{
@@ -35,7 +60,9 @@ public:
 
 	void Delete()
 	{
-		glDeleteVertexArrays(1, &ID);
+		if (ID)
+			glDeleteVertexArrays(1, &ID);
+		ID = 0;
 	}
 
 };
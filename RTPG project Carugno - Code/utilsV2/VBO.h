@@ -27,12 +27,26 @@ struct Vertex
 	}
 };
 
+//Vertex layout streamed every frame for soft bodies
+//Colour is constant per body so it is not part of the stream
+struct SoftVertex
+{
+	glm::vec3 Position;
+	glm::vec3 Normal;
+};
+
 class VBO
 {
 public:
-	GLuint ID;
+	GLuint ID = 0;
 
-	VBO(vector<Vertex>& vertices)
+	//Empty buffer, data is uploaded later
+	VBO()
+	{
+		glGenBuffers(1, &ID);
+	}
+
+	VBO(const vector<Vertex>& vertices)
 	{
 		glGenBuffers(1, &ID);
 		glBindBuffer(GL_ARRAY_BUFFER, ID);
@@ -40,6 +54,31 @@ public:
 			vertices.data(), GL_STATIC_DRAW);
 	}
 
+	//The buffer is owned by a single object, so it can be moved but not copied
+	VBO(const VBO&) = delete;
+	VBO& operator=(const VBO&) = delete;
+
+	VBO(VBO&& other) noexcept : ID(other.ID)
+	{
+		other.ID = 0;
+	}
+
+	VBO& operator=(VBO&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Delete();
+			ID = other.ID;
+			other.ID = 0;
+		}
+		return *this;
+	}
+
+	~VBO()
+	{
+		Delete();
+	}
+
 	void Bind()
 	{
 		glBindBuffer(GL_ARRAY_BUFFER, ID);
@@ -52,7 +91,9 @@ public:
 
 	void Delete()
 	{
-		glDeleteBuffers(1, &ID);
+		if (ID)
+			glDeleteBuffers(1, &ID);
+		ID = 0;
 	};
 
 };